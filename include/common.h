@@ -2,10 +2,13 @@
 #include <algorithm>
 #include <fstream>
 #include <chrono>
+#include <limits>
 #include <vector>
+#include <map>
 #include <queue>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <Eigen/Dense>
 
 #include <ros/ros.h>
@@ -47,6 +50,15 @@
 // JSON library
 #include "Thirdparty/nlohmann/json.hpp"
 
+// Lock-free sensor queues
+#include "sensor_queue.h"
+
+// Time-indexed marker buffer
+#include "marker_buffer.h"
+
+// IMU-rate odometry
+#include "imu_propagator.h"
+
 // Semantics
 #include "Semantic/Door.h"
 #include "Semantic/Room.h"
@@ -63,7 +75,7 @@ extern bool publish_static_transform; // If true, it should use transformed calc
 extern std::string world_frame_id, cam_frame_id, imu_frame_id, map_frame_id, wall_frame_id, room_frame_id;
 
 // List of visited Fiducial Markers in different timestamps
-extern std::vector<std::vector<ORB_SLAM3::Marker *>> markers_buff;
+extern MarkerBuffer markers_buff;
 
 // List of semantic entities available in the real environment
 extern std::vector<ORB_SLAM3::Room *> env_rooms;
@@ -71,10 +83,17 @@ extern std::vector<ORB_SLAM3::Door *> env_doors;
 
 extern image_transport::Publisher tracking_img_pub;
 extern ros::Publisher pose_pub, odom_pub, kf_markers_pub;
-extern ros::Publisher tracked_mappoints_pub, all_mappoints_pub;
+extern ros::Publisher tracked_mappoints_pub, all_mappoints_pub, all_mappoints_delta_pub;
+
+// Incremental publishing of the map points (delta + low rate full snapshot)
+extern bool publish_all_points_delta;
+extern double all_points_snapshot_rate;
 
 extern rviz_visual_tools::RvizVisualToolsPtr wall_visual_tools;
 
+// Wakes up the IMU/image synchronization thread of the inertial nodes
+extern SensorEvent sensor_event;
+
 struct MapPointStruct
 {
     Eigen::Vector3f coordinates;
@@ -83,21 +102,67 @@ struct MapPointStruct
     MapPointStruct(Eigen::Vector3f coords) : coordinates(coords), cluster_id(-1) {}
 };
 
+// Data taken on the tracking thread and published later by the publisher thread. The messages built
+// from state that other SLAM threads modify without locks (tracked points, semantic entities) are
+// already complete, the rest is read through the locked getters of the system
+struct PublishSnapshot
+{
+    ros::Time msg_time;
+    bool has_tracked_points = false;
+    sensor_msgs::PointCloud2 tracked_points;
+    bool has_semantics = false;
+    visualization_msgs::MarkerArray doors, walls, rooms, fiducial_markers;
+};
+
+// IMU sample handed over from the IMU callback to the synchronization thread
+struct ImuSample
+{
+    double t;
+    Eigen::Vector3f acc, gyr;
+};
+
+// Image message handed over from the image callbacks with the time it was received
+struct ImageSample
+{
+    sensor_msgs::ImageConstPtr msg;
+    std::chrono::steady_clock::time_point arrival;
+};
+
+// Limits the publishing rate of a family of topics (rate <= 0 publishes every frame)
+struct TopicRateLimiter
+{
+    double rate;
+    ros::Time last_time;
+
+    TopicRateLimiter() : rate(0.0) {}
+
+    bool ready(ros::Time msg_time)
+    {
+        if (rate > 0 && msg_time >= last_time && (msg_time - last_time).toSec() < 1.0 / rate)
+            return false;
+        last_time = msg_time;
+        return true;
+    }
+};
+
 void setup_services(ros::NodeHandle &, std::string);
 void publish_topics(ros::Time, Eigen::Vector3f = Eigen::Vector3f::Zero());
 void setup_publishers(ros::NodeHandle &, image_transport::ImageTransport &, std::string);
+void shutdown_publishers();
+void setup_sensor_sync(ros::NodeHandle &, std::string);
+void setup_tracking_pipeline(ros::NodeHandle &, std::string);
+void setup_imu_propagation(ros::NodeHandle &, std::string);
+
+void publisher_thread_loop();
+void publish_snapshot(const PublishSnapshot &);
 
 void publish_tracking_img(cv::Mat, ros::Time);
 void publish_camera_pose(Sophus::SE3f, ros::Time);
 void publish_static_tf_transform(string, string, ros::Time);
 void publish_kf_markers(std::vector<Sophus::SE3f>, ros::Time);
-void publish_doors(std::vector<ORB_SLAM3::Door *>, ros::Time);
-void publish_walls(std::vector<ORB_SLAM3::Wall *>, ros::Time);
-void publish_rooms(std::vector<ORB_SLAM3::Room *>, ros::Time);
 void publish_tf_transform(Sophus::SE3f, string, string, ros::Time);
 void publish_all_points(std::vector<ORB_SLAM3::MapPoint *>, ros::Time);
-void publish_tracked_points(std::vector<ORB_SLAM3::MapPoint *>, ros::Time);
-void publish_fiducial_markers(std::vector<ORB_SLAM3::Marker *>, ros::Time);
+void publish_all_points_changes(ros::Time);
 void publish_body_odom(Sophus::SE3f, Eigen::Vector3f, Eigen::Vector3f, ros::Time);
 
 bool save_map_srv(orb_slam3_ros::SaveMap::Request &, orb_slam3_ros::SaveMap::Response &);
@@ -105,9 +170,26 @@ bool save_traj_srv(orb_slam3_ros::SaveMap::Request &, orb_slam3_ros::SaveMap::Re
 
 cv::Mat SE3f_to_cvMat(Sophus::SE3f);
 tf::Transform SE3f_to_tfTransform(Sophus::SE3f);
+bool lookup_world_transform(const std::string &, tf::StampedTransform &);
 sensor_msgs::PointCloud2 mappoint_to_pointcloud(std::vector<ORB_SLAM3::MapPoint *>, ros::Time);
+visualization_msgs::MarkerArray doors_to_marker_array(std::vector<ORB_SLAM3::Door *>, ros::Time);
+visualization_msgs::MarkerArray walls_to_marker_array(std::vector<ORB_SLAM3::Wall *>, ros::Time);
+visualization_msgs::MarkerArray rooms_to_marker_array(std::vector<ORB_SLAM3::Room *>, ros::Time);
+visualization_msgs::MarkerArray fiducial_markers_to_marker_array(std::vector<ORB_SLAM3::Marker *>, ros::Time);
+sensor_msgs::PointCloud2 mappoint_delta_to_pointcloud(std::vector<ORB_SLAM3::MapPoint *>, std::vector<long unsigned int>, ros::Time);
+
+// IMU/image synchronization
+void pop_imu_measurements(GrowingSPSCQueue<ImuSample> &, double, std::vector<ORB_SLAM3::IMU::Point> &, Eigen::Vector3f &);
+void trim_imu_buffer(GrowingSPSCQueue<ImuSample> &, size_t);
+void add_sync_latency(std::chrono::steady_clock::time_point);
+void add_tracking_latency(std::chrono::steady_clock::time_point);
+
+// IMU-rate odometry
+void propagate_body_odom(const ImuSample &);
+void anchor_body_odom();
 
 // Markers
+void setup_marker_buffer(ros::NodeHandle &, std::string);
 void add_markers_to_buffer(const aruco_msgs::MarkerArray &marker_array);
 std::pair<double, std::vector<ORB_SLAM3::Marker *>> find_nearest_marker(double frame_timestamp);
 
@@ -0,0 +1,162 @@
+/**
+ *
+ * IMU-rate forward propagation of the body state of the last tracked frame
+ *
+ */
+
+#ifndef IMU_PROPAGATOR_H
+#define IMU_PROPAGATOR_H
+
+#include <deque>
+#include <mutex>
+
+#include <Eigen/Core>
+#include <sophus/se3.hpp>
+
+#include "ImuTypes.h"
+
+/**
+ * Integrates every IMU sample on top of the body pose, velocity and bias of the last tracked frame,
+ * so the odometry is available at IMU rate one sample after it is received. When a new frame is
+ * tracked, the state is re-anchored to it and the samples received after its timestamp (kept for
+ * `retention` seconds) are integrated again. Each interval is integrated with the mean of the samples
+ * at its ends, in a gravity-aligned world frame (valid after the IMU initialization).
+ * The methods may be called from different threads (IMU callback and tracking).
+ */
+class ImuPropagator
+{
+public:
+    struct State
+    {
+        double t;
+        Sophus::SE3f Twb;
+        Eigen::Vector3f Vwb; // Linear velocity in world frame
+        Eigen::Vector3f Wwb; // Angular velocity in world frame
+    };
+
+    explicit ImuPropagator(double retention = 1.0) : retention(retention), anchored(false) {}
+
+    void setRetention(double retention_window)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        retention = retention_window;
+    }
+
+    // Stops the propagation until the next anchor (tracking lost or not initialized)
+    void reset()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        anchored = false;
+    }
+
+    /**
+     * Adds a sample and returns the state propagated up to it. Returns false if there is no anchor
+     * or the sample is not newer than the current state.
+     */
+    bool addSample(double t, const Eigen::Vector3f &acc, const Eigen::Vector3f &gyr, State &out)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if (!samples.empty() && t <= samples.back().t)
+            return false;
+
+        Sample sample;
+        sample.t = t;
+        sample.acc = acc;
+        sample.gyr = gyr;
+        samples.push_back(sample);
+        while (samples.front().t < t - retention)
+            samples.pop_front();
+
+        if (!anchored || t <= state_t)
+            return false;
+
+        integrate(samples.size() - 1);
+        output(samples.back().gyr, out);
+        return true;
+    }
+
+    /**
+     * Moves the state to the one of a tracked frame at time t and integrates the samples received
+     * after it. Returns the propagated state (at t if no sample is newer). An anchor older than the
+     * current one is ignored.
+     */
+    bool anchor(double t, const Sophus::SE3f &Twb, const Eigen::Vector3f &Vwb, const ORB_SLAM3::IMU::Bias &bias, State &out)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if (anchored && t < anchor_t)
+            return false;
+
+        anchored = true;
+        anchor_t = t;
+        state_t = t;
+        Rwb = Twb.so3();
+        twb = Twb.translation();
+        vwb = Vwb;
+        bg << bias.bwx, bias.bwy, bias.bwz;
+        ba << bias.bax, bias.bay, bias.baz;
+
+        // First sample after the anchor
+        size_t i = 0;
+        while (i < samples.size() && samples[i].t <= t)
+            i++;
+
+        for (size_t j = i; j < samples.size(); j++)
+            integrate(j);
+
+        output(samples.empty() ? Eigen::Vector3f::Zero() : samples.back().gyr, out);
+        return true;
+    }
+
+private:
+    struct Sample
+    {
+        double t;
+        Eigen::Vector3f acc, gyr;
+    };
+
+    // Integrates from state_t up to the time of samples[i]
+    void integrate(size_t i)
+    {
+        const Sample &sample = samples[i];
+        const float dt = static_cast<float>(sample.t - state_t);
+
+        Eigen::Vector3f acc = sample.acc, gyr = sample.gyr;
+        if (i > 0)
+        {
+            acc = 0.5f * (acc + samples[i - 1].acc);
+            gyr = 0.5f * (gyr + samples[i - 1].gyr);
+        }
+        acc -= ba;
+        gyr -= bg;
+
+        const Eigen::Vector3f Gz(0, 0, -ORB_SLAM3::IMU::GRAVITY_VALUE);
+        const Eigen::Vector3f accW = Rwb * acc + Gz;
+
+        twb += vwb * dt + 0.5f * dt * dt * accW;
+        vwb += dt * accW;
+        Rwb = Rwb * Sophus::SO3f::exp(gyr * dt);
+        state_t = sample.t;
+    }
+
+    void output(const Eigen::Vector3f &gyr, State &out) const
+    {
+        out.t = state_t;
+        out.Twb = Sophus::SE3f(Rwb, twb);
+        out.Vwb = vwb;
+        out.Wwb = Rwb * (gyr - bg);
+    }
+
+    std::deque<Sample> samples;
+    double retention;
+
+    bool anchored;
+    double anchor_t, state_t;
+    Sophus::SO3f Rwb;
+    Eigen::Vector3f twb, vwb, bg, ba;
+
+    std::mutex mutex;
+};
+
+#endif // IMU_PROPAGATOR_H
@@ -0,0 +1,135 @@
+/**
+ *
+ * Time-indexed buffer of the fiducial markers received between two frames
+ *
+ */
+
+#ifndef MARKER_BUFFER_H
+#define MARKER_BUFFER_H
+
+#include <cmath>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "Semantic/Marker.h"
+
+/**
+ * Bounded ring buffer of marker observations ordered by timestamp. Entries older than the
+ * retention window (relative to the newest entry) or beyond the capacity are overwritten.
+ * The Marker objects are owned by the buffer and reused by later entries, so the pointers
+ * handed out are only valid until the next push().
+ */
+class MarkerBuffer
+{
+public:
+    MarkerBuffer(size_t capacity = 64, double retention = 2.0)
+        : slots(std::max<size_t>(capacity, 1)), retention(retention), first(0), count(0) {}
+
+    // Resizes the buffer and drops all its entries
+    void configure(size_t capacity, double retention_window)
+    {
+        slots.clear();
+        slots.resize(std::max<size_t>(capacity, 1));
+        retention = retention_window;
+        clear();
+    }
+
+    void clear()
+    {
+        first = 0;
+        count = 0;
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    /**
+     * Appends an entry of `num_markers` markers observed at `stamp` and returns them to be filled
+     * by the caller. Returns nullptr if the stamp is older than the newest entry.
+     */
+    std::vector<ORB_SLAM3::Marker *> *push(double stamp, size_t num_markers)
+    {
+        if (count > 0 && stamp < at(count - 1).stamp)
+            return nullptr;
+
+        // Drop the entries that left the retention window and the oldest one if full
+        while (count > 0 && (stamp - at(0).stamp > retention || count == slots.size()))
+            popFront();
+
+        Slot &slot = at(count);
+        count++;
+
+        slot.stamp = stamp;
+        while (slot.pool.size() < num_markers)
+            slot.pool.emplace_back(new ORB_SLAM3::Marker());
+
+        slot.markers.clear();
+        for (size_t i = 0; i < num_markers; i++)
+            slot.markers.push_back(slot.pool[i].get());
+
+        return &slot.markers;
+    }
+
+    /**
+     * Finds the entry with the timestamp closest to `stamp`. Returns false if the buffer is empty,
+     * otherwise the absolute time difference and the markers of that entry.
+     */
+    bool nearest(double stamp, double &time_diff, std::vector<ORB_SLAM3::Marker *> &markers)
+    {
+        if (count == 0)
+            return false;
+
+        // First entry not older than the stamp
+        size_t lo = 0, hi = count;
+        while (lo < hi)
+        {
+            size_t mid = (lo + hi) / 2;
+            if (at(mid).stamp < stamp)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        size_t best = lo;
+        if (lo == count || (lo > 0 && stamp - at(lo - 1).stamp < at(lo).stamp - stamp))
+            best = lo - 1;
+
+        time_diff = std::fabs(at(best).stamp - stamp);
+        markers = at(best).markers;
+        return true;
+    }
+
+private:
+    struct Slot
+    {
+        double stamp = 0.0;
+        std::vector<std::unique_ptr<ORB_SLAM3::Marker>> pool; // Reused by the entries of this slot
+        std::vector<ORB_SLAM3::Marker *> markers;
+    };
+
+    Slot &at(size_t idx)
+    {
+        return slots[(first + idx) % slots.size()];
+    }
+
+    void popFront()
+    {
+        first = (first + 1) % slots.size();
+        count--;
+    }
+
+    std::vector<Slot> slots;
+    double retention;
+    size_t first;
+    size_t count;
+};
+
+#endif // MARKER_BUFFER_H
@@ -0,0 +1,257 @@
+/**
+ *
+ * Sensor hand-over between the ROS callbacks and the tracking threads of the nodes
+ *
+ */
+
+#ifndef SENSOR_QUEUE_H
+#define SENSOR_QUEUE_H
+
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <condition_variable>
+#include <deque>
+
+#include <ros/ros.h>
+
+/**
+ * Bounded lock-free ring buffer for exactly one producer thread and one consumer thread.
+ * push() is only called by the producer, front()/pop() only by the consumer.
+ */
+template <typename T>
+class SPSCQueue
+{
+public:
+    explicit SPSCQueue(size_t capacity) : buffer(capacity + 1), head(0), tail(0) {}
+
+    // Returns false (and drops the value) if the queue is full
+    bool push(const T &value)
+    {
+        const size_t h = head.load(std::memory_order_relaxed);
+        const size_t next = increment(h);
+        if (next == tail.load(std::memory_order_acquire))
+            return false;
+
+        buffer[h] = value;
+        head.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Oldest element, nullptr if the queue is empty. Valid until the next pop()
+    T *front()
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+            return nullptr;
+        return &buffer[t];
+    }
+
+    void pop()
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+            return;
+
+        buffer[t] = T();
+        tail.store(increment(t), std::memory_order_release);
+    }
+
+    bool empty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    size_t size() const
+    {
+        const size_t h = head.load(std::memory_order_acquire);
+        const size_t t = tail.load(std::memory_order_acquire);
+        return h >= t ? h - t : h + buffer.size() - t;
+    }
+
+private:
+    size_t increment(size_t idx) const
+    {
+        return (idx + 1) == buffer.size() ? 0 : idx + 1;
+    }
+
+    std::vector<T> buffer;
+    // Producer and consumer indices live in different cache lines
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+};
+
+/**
+ * Unbounded SPSCQueue for data that must not be dropped. Once the ring is full the producer appends
+ * to a mutex-protected overflow until the consumer drained it, so the lock-free path is only left
+ * while the consumer is behind. The ring elements are always older than the overflow ones.
+ */
+template <typename T>
+class GrowingSPSCQueue
+{
+public:
+    explicit GrowingSPSCQueue(size_t capacity) : ring(capacity), overflow_size(0) {}
+
+    void push(const T &value)
+    {
+        // Only the producer makes the overflow non-empty, so the ring is only used when it is empty
+        if (overflow_size.load(std::memory_order_acquire) == 0 && ring.push(value))
+            return;
+
+        std::unique_lock<std::mutex> lock(overflow_mutex);
+        overflow.push_back(value);
+        overflow_size.store(overflow.size(), std::memory_order_release);
+    }
+
+    // Oldest element, nullptr if the queue is empty. Valid until the next pop()
+    T *front()
+    {
+        T *value = ring.front();
+        if (value || overflow_size.load(std::memory_order_acquire) == 0)
+            return value;
+
+        std::unique_lock<std::mutex> lock(overflow_mutex);
+        return &overflow.front();
+    }
+
+    void pop()
+    {
+        if (ring.front())
+        {
+            ring.pop();
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(overflow_mutex);
+        if (overflow.empty())
+            return;
+        overflow.pop_front();
+        overflow_size.store(overflow.size(), std::memory_order_release);
+    }
+
+    bool empty() const
+    {
+        return ring.empty() && overflow_size.load(std::memory_order_acquire) == 0;
+    }
+
+    size_t size() const
+    {
+        return ring.size() + overflow_size.load(std::memory_order_acquire);
+    }
+
+private:
+    SPSCQueue<T> ring;
+    // A deque keeps the references to its elements valid when appending
+    std::deque<T> overflow;
+    std::atomic<size_t> overflow_size;
+    std::mutex overflow_mutex;
+};
+
+/**
+ * Wakes up the synchronization thread when any producer pushed new data. The consumer
+ * reads the sequence before checking its queues, so a notification cannot be lost.
+ */
+class SensorEvent
+{
+public:
+    SensorEvent() : sequence(0) {}
+
+    unsigned long getSequence()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return sequence;
+    }
+
+    void notify()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            sequence++;
+        }
+        cv.notify_one();
+    }
+
+    // Blocks until notify() is called after the sequence `seen` was read
+    void wait(unsigned long seen)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]
+                { return sequence != seen; });
+    }
+
+private:
+    unsigned long sequence;
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+/**
+ * Histogram of latencies with logarithmic buckets (bucket i holds [2^i, 2^(i+1)) microseconds)
+ */
+class LatencyHistogram
+{
+public:
+    static const int NUM_BUCKETS = 24;
+
+    LatencyHistogram() : buckets(NUM_BUCKETS, 0), count(0), sum_us(0.0), max_us(0.0) {}
+
+    void add(std::chrono::steady_clock::time_point start)
+    {
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        double latency_us = elapsed.count();
+
+        int bucket = latency_us < 1.0 ? 0 : std::min(NUM_BUCKETS - 1, static_cast<int>(std::log2(latency_us)));
+        buckets[bucket]++;
+        count++;
+        sum_us += latency_us;
+        max_us = std::max(max_us, latency_us);
+    }
+
+    unsigned long size() const
+    {
+        return count;
+    }
+
+    // Upper bound (us) of the bucket containing the given percentile
+    double percentile(double p) const
+    {
+        unsigned long target = std::ceil(p * count);
+        unsigned long accumulated = 0;
+        for (int i = 0; i < NUM_BUCKETS; i++)
+        {
+            accumulated += buckets[i];
+            if (accumulated >= target && accumulated > 0)
+                return std::pow(2.0, i + 1);
+        }
+        return max_us;
+    }
+
+    void print(const std::string &name) const
+    {
+        if (count == 0)
+            return;
+
+        ROS_INFO("%s latency over %lu frames: mean %.1f us, p50 < %.0f us, p90 < %.0f us, p99 < %.0f us, max %.1f us",
+                 name.c_str(), count, sum_us / count, percentile(0.5), percentile(0.9), percentile(0.99), max_us);
+    }
+
+    void clear()
+    {
+        std::fill(buckets.begin(), buckets.end(), 0);
+        count = 0;
+        sum_us = 0.0;
+        max_us = 0.0;
+    }
+
+private:
+    std::vector<unsigned long> buckets;
+    unsigned long count;
+    double sum_us;
+    double max_us;
+};
+
+#endif // SENSOR_QUEUE_H
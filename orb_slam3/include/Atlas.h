@@ -121,10 +121,15 @@ namespace ORB_SLAM3
         std::vector<Door *> GetAllDoors();
         std::vector<Room *> GetAllRooms();
         std::vector<Marker *> GetAllMarkers();
+        Marker *GetMarkerById(int markerId);
         std::vector<KeyFrame *> GetAllKeyFrames();
         std::vector<MapPoint *> GetAllMapPoints();
         std::vector<MapPoint *> GetReferenceMapPoints();
 
+        // Spatial queries on the map points of the current map
+        std::vector<MapPoint *> GetMapPointsInRadius(const Eigen::Vector3f &center, const float radius);
+        std::vector<MapPoint *> GetMapPointsNearPlane(const Eigen::Vector4d &plane, const float maxDist);
+
         vector<Map *> GetAllMaps();
 
         int CountMaps();
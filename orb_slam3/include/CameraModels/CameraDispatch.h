@@ -0,0 +1,40 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CAMERAMODELS_CAMERADISPATCH_H
+#define CAMERAMODELS_CAMERADISPATCH_H
+
+#include "GeometricCamera.h"
+#include "Pinhole.h"
+#include "KannalaBrandt8.h"
+
+namespace ORB_SLAM3 {
+
+    //Calls f with the inline kernel of the camera model (Pinhole::Kernel or KannalaBrandt8::Kernel),
+    //so a loop written as a generic lambda is compiled once per model without virtual calls:
+    //  DispatchCamera(pCamera, [&](const auto &camera) { for(...) uv[i] = camera.project(P[i]); });
+    template<typename Function>
+    void DispatchCamera(GeometricCamera* pCamera, Function &&f) {
+        if(pCamera->GetType() == GeometricCamera::CAM_FISHEYE)
+            f(static_cast<KannalaBrandt8*>(pCamera)->GetKernel());
+        else
+            f(static_cast<Pinhole*>(pCamera)->GetKernel());
+    }
+}
+
+#endif //CAMERAMODELS_CAMERADISPATCH_H
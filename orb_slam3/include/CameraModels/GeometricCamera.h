@@ -70,6 +70,10 @@ namespace ORB_SLAM3 {
 
         virtual Eigen::Matrix<double,2,3> projectJac(const Eigen::Vector3d& v3D) = 0;
 
+        //Batch versions, one virtual call for all the points
+        virtual void projectPoints(const std::vector<Eigen::Vector3f> &vP3D, std::vector<Eigen::Vector2f> &vP2D) = 0;
+        virtual void unprojectPoints(const std::vector<cv::Point2f> &vP2D, std::vector<Eigen::Vector3f> &vRays) = 0;
+
         virtual bool ReconstructWithTwoViews(const std::vector<cv::KeyPoint>& vKeys1, const std::vector<cv::KeyPoint>& vKeys2, const std::vector<int> &vMatches12,
                                              Sophus::SE3f &T21, std::vector<cv::Point3f> &vP3D, std::vector<bool> &vbTriangulated) = 0;
 
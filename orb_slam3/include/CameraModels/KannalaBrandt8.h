@@ -21,6 +21,7 @@
 
 
 #include <assert.h>
+#include <cmath>
 
 #include "GeometricCamera.h"
 
@@ -39,6 +40,30 @@ namespace ORB_SLAM3 {
     }
 
     public:
+        //Inline projection over the model parameters, for callers that dispatch on the camera type
+        //once and then run their loop without virtual calls (see CameraDispatch.h)
+        struct Kernel {
+            float fx, fy, cx, cy, k0, k1, k2, k3;
+
+            explicit Kernel(const float* p) : fx(p[0]), fy(p[1]), cx(p[2]), cy(p[3]), k0(p[4]), k1(p[5]), k2(p[6]), k3(p[7]) {}
+
+            template<typename T>
+            Eigen::Matrix<T,2,1> project(const Eigen::Matrix<T,3,1> &v3D) const {
+                const T x2_plus_y2 = v3D[0] * v3D[0] + v3D[1] * v3D[1];
+                const T theta = std::atan2(std::sqrt(x2_plus_y2), v3D[2]);
+                const T psi = std::atan2(v3D[1], v3D[0]);
+
+                const T theta2 = theta * theta;
+                const T theta3 = theta * theta2;
+                const T theta5 = theta3 * theta2;
+                const T theta7 = theta5 * theta2;
+                const T theta9 = theta7 * theta2;
+                const T r = theta + T(k0) * theta3 + T(k1) * theta5 + T(k2) * theta7 + T(k3) * theta9;
+
+                return Eigen::Matrix<T,2,1>(T(fx) * r * std::cos(psi) + T(cx), T(fy) * r * std::sin(psi) + T(cy));
+            }
+        };
+
         KannalaBrandt8() : precision(1e-6) {
             mvParameters.resize(8);
             mnId=nNextId++;
@@ -48,6 +73,7 @@ namespace ORB_SLAM3 {
             assert(mvParameters.size() == 8);
             mnId=nNextId++;
             mnType = CAM_FISHEYE;
+            PrecomputeUnprojection();
         }
 
         KannalaBrandt8(const std::vector<float> _vParameters, const float _precision) : GeometricCamera(_vParameters),
@@ -55,11 +81,13 @@ namespace ORB_SLAM3 {
             assert(mvParameters.size() == 8);
             mnId=nNextId++;
             mnType = CAM_FISHEYE;
+            PrecomputeUnprojection();
         }
         KannalaBrandt8(KannalaBrandt8* pKannala) : GeometricCamera(pKannala->mvParameters), precision(pKannala->precision), mvLappingArea(2,0) ,tvr(nullptr) {
             assert(mvParameters.size() == 8);
             mnId=nNextId++;
             mnType = CAM_FISHEYE;
+            PrecomputeUnprojection();
         }
 
         cv::Point2f project(const cv::Point3f &p3D);
@@ -74,6 +102,16 @@ namespace ORB_SLAM3 {
 
         Eigen::Matrix<double,2,3> projectJac(const Eigen::Vector3d& v3D);
 
+        void projectPoints(const std::vector<Eigen::Vector3f> &vP3D, std::vector<Eigen::Vector2f> &vP2D);
+        void unprojectPoints(const std::vector<cv::Point2f> &vP2D, std::vector<Eigen::Vector3f> &vRays);
+
+        Kernel GetKernel() const { return Kernel(mvParameters.data()); }
+
+        //Tabulates the undistorted angle for the distortion coefficients, so unproject starts the Newton
+        //iteration next to the solution. Must be called again if the coefficients change (it is done
+        //by the constructors and after loading)
+        void PrecomputeUnprojection();
+
 
         bool ReconstructWithTwoViews(const std::vector<cv::KeyPoint>& vKeys1, const std::vector<cv::KeyPoint>& vKeys2, const std::vector<int> &vMatches12,
                                      Sophus::SE3f &T21, std::vector<cv::Point3f> &vP3D, std::vector<bool> &vbTriangulated);
@@ -106,6 +144,14 @@ namespace ORB_SLAM3 {
 
         TwoViewReconstruction* tvr;
 
+        //Undistorted angle theta for theta_d = i * mfThetaDStep, and the coefficients it was computed for
+        std::vector<float> mvThetaLUT;
+        float mfThetaDStep, mfInvThetaDStep;
+        float mvLUTCoefficients[4];
+
+        //Solves theta * (1 + k0 theta^2 + k1 theta^4 + k2 theta^6 + k3 theta^8) = theta_d from theta
+        float SolveTheta(const float theta_d, float theta) const;
+
         void Triangulate(const cv::Point2f &p1, const cv::Point2f &p2, const Eigen::Matrix<float,3,4> &Tcw1,
                          const Eigen::Matrix<float,3,4> &Tcw2, Eigen::Vector3f &x3D);
     };
@@ -37,6 +37,23 @@ namespace ORB_SLAM3 {
     }
 
     public:
+        //Inline projection over the model parameters, for callers that dispatch on the camera type
+        //once and then run their loop without virtual calls (see CameraDispatch.h)
+        struct Kernel {
+            float fx, fy, cx, cy;
+
+            explicit Kernel(const float* p) : fx(p[0]), fy(p[1]), cx(p[2]), cy(p[3]) {}
+
+            template<typename T>
+            Eigen::Matrix<T,2,1> project(const Eigen::Matrix<T,3,1> &v3D) const {
+                return Eigen::Matrix<T,2,1>(fx * v3D[0] / v3D[2] + cx, fy * v3D[1] / v3D[2] + cy);
+            }
+
+            Eigen::Vector3f unproject(const cv::Point2f &p2D) const {
+                return Eigen::Vector3f((p2D.x - cx) / fx, (p2D.y - cy) / fy, 1.f);
+            }
+        };
+
         Pinhole() {
             mvParameters.resize(4);
             mnId=nNextId++;
@@ -71,6 +88,11 @@ namespace ORB_SLAM3 {
 
         Eigen::Matrix<double,2,3> projectJac(const Eigen::Vector3d& v3D);
 
+        void projectPoints(const std::vector<Eigen::Vector3f> &vP3D, std::vector<Eigen::Vector2f> &vP2D);
+        void unprojectPoints(const std::vector<cv::Point2f> &vP2D, std::vector<Eigen::Vector3f> &vRays);
+
+        Kernel GetKernel() const { return Kernel(mvParameters.data()); }
+
 
         bool ReconstructWithTwoViews(const std::vector<cv::KeyPoint>& vKeys1, const std::vector<cv::KeyPoint>& vKeys2, const std::vector<int> &vMatches12,
                                              Sophus::SE3f &T21, std::vector<cv::Point3f> &vP3D, std::vector<bool> &vbTriangulated);
@@ -0,0 +1,87 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FEATUREGRID_H
+#define FEATUREGRID_H
+
+#include <vector>
+
+#include <boost/serialization/access.hpp>
+#include <boost/serialization/vector.hpp>
+
+namespace ORB_SLAM3
+{
+
+    /**
+     * Keypoint indices bucketed by image cell in compressed sparse row form: the indices of cell
+     * (ix, iy) are mvIndices[mvCellStart[c]] .. mvIndices[mvCellStart[c+1]-1] with c = ix*nRows + iy,
+     * in increasing order. Copying or serializing a grid moves two flat buffers.
+     */
+    class FeatureGrid
+    {
+        friend class boost::serialization::access;
+
+        template <class Archive>
+        void serialize(Archive &ar, const unsigned int version)
+        {
+            ar &mnCols;
+            ar &mnRows;
+            ar &mvCellStart;
+            ar &mvIndices;
+        }
+
+    public:
+        FeatureGrid() : mnCols(0), mnRows(0) {}
+
+        // Counting sort of the keypoints by cell. vCells[i] is the cell (ix*nRows + iy) of keypoint i, or -1 outside the grid
+        void Build(int nCols, int nRows, const std::vector<int> &vCells);
+
+        // Imports a grid stored as grid[ix][iy] = indices (atlases saved before the flat layout)
+        void Assign(const std::vector<std::vector<std::vector<size_t>>> &vvvGrid);
+
+        void clear();
+
+        bool empty() const
+        {
+            return mvCellStart.empty();
+        }
+
+        size_t capacity() const
+        {
+            return mvCellStart.capacity() + mvIndices.capacity();
+        }
+
+        const unsigned int *CellBegin(int ix, int iy) const
+        {
+            return empty() ? nullptr : mvIndices.data() + mvCellStart[ix * mnRows + iy];
+        }
+
+        const unsigned int *CellEnd(int ix, int iy) const
+        {
+            return empty() ? nullptr : mvIndices.data() + mvCellStart[ix * mnRows + iy + 1];
+        }
+
+    private:
+        int mnCols, mnRows;
+        std::vector<unsigned int> mvCellStart;
+        std::vector<unsigned int> mvIndices;
+    };
+
+} // namespace ORB_SLAM3
+
+#endif // FEATUREGRID_H
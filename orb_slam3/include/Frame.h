@@ -28,11 +28,13 @@
 
 #include "ImuTypes.h"
 #include "ORBVocabulary.h"
+#include "FeatureGrid.h"
 
 #include "Converter.h"
 #include "Settings.h"
 
 #include <mutex>
+#include <atomic>
 #include <opencv2/opencv.hpp>
 
 #include "Eigen/Core"
@@ -54,6 +56,48 @@ namespace ORB_SLAM3
     class Marker;
     class Wall;
 
+    // Geometry of a set of MapPoints in structure-of-arrays form, to test their visibility in one pass
+    struct MapPointGeometry
+    {
+        std::vector<float> vX, vY, vZ;          // Position in absolute coordinates
+        std::vector<float> vNx, vNy, vNz;       // Mean viewing direction
+        std::vector<float> vMinDist, vMaxDist;  // Scale invariance distances (mfMinDistance, mfMaxDistance)
+
+        size_t size() const { return vX.size(); }
+
+        void resize(const size_t n)
+        {
+            vX.resize(n);
+            vY.resize(n);
+            vZ.resize(n);
+            vNx.resize(n);
+            vNy.resize(n);
+            vNz.resize(n);
+            vMinDist.resize(n);
+            vMaxDist.resize(n);
+        }
+    };
+
+    // Result of the batched isInFrustum. The projection is valid where vbInImage is set, the rest where vbInView is
+    struct FrustumTest
+    {
+        std::vector<unsigned char> vbInImage, vbInView;
+        std::vector<float> vU, vV, vUr, vDepth, vViewCos;
+        std::vector<int> vLevel;
+
+        void resize(const size_t n)
+        {
+            vbInImage.resize(n);
+            vbInView.resize(n);
+            vU.resize(n);
+            vV.resize(n);
+            vUr.resize(n);
+            vDepth.resize(n);
+            vViewCos.resize(n);
+            vLevel.resize(n);
+        }
+    };
+
     class Frame
     {
     public:
@@ -62,6 +106,13 @@ namespace ORB_SLAM3
         // Copy constructor.
         Frame(const Frame &frame);
 
+        // Member-wise assignment. The descriptors are shared with frame, use Recycle to keep them apart.
+        Frame &operator=(const Frame &frame) = default;
+
+        // Freshly extracted frames are moved into the tracker instead of copied.
+        Frame(Frame &&frame) = default;
+        Frame &operator=(Frame &&frame) = default;
+
         // Constructor for stereo cameras (with or without IMU)
         Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor *extractorLeft,
               ORBextractor *extractorRight, ORBVocabulary *voc, cv::Mat &K, cv::Mat &distCoef, const float &bf,
@@ -96,6 +147,10 @@ namespace ORB_SLAM3
 
         Eigen::Vector3f GetVelocity() const;
 
+        // Link to the previous frame and take its velocity, as done by the constructors that receive it.
+        // Used for frames built before the previous one was tracked.
+        void SetPrevFrame(Frame *pPrevF);
+
         // Set IMU pose and velocity (implicitly changes camera pose)
         void SetImuPoseVelocity(const Eigen::Matrix3f &Rwb, const Eigen::Vector3f &twb, const Eigen::Vector3f &Vwb);
 
@@ -113,6 +168,9 @@ namespace ORB_SLAM3
         // Check if a MapPoint is in the frustum of the camera
         // and fill variables of the MapPoint to be used by the tracking
         bool isInFrustum(MapPoint *pMP, float viewingCosLimit);
+        // Same test for all the points of a geometry snapshot at once, without touching the MapPoints.
+        // Only for frames with a single camera (Nleft == -1)
+        void isInFrustum(const MapPointGeometry &geometry, float viewingCosLimit, FrustumTest &test);
 
         bool ProjectPointDistort(MapPoint *pMP, cv::Point2f &kp, float &u, float &v);
 
@@ -261,6 +319,9 @@ namespace ORB_SLAM3
         // ORB descriptor, each row associated to a keypoint.
         cv::Mat mDescriptors, mDescriptorsRight;
 
+        // Storage behind the descriptors of a recycled frame (see Recycle)
+        cv::Mat mDescriptorsBuffer, mDescriptorsRightBuffer;
+
         // MapPoints associated to keypoints, NULL pointer if no association.
         // Flag to identify outlier associations.
         std::vector<bool> mvbOutlier;
@@ -269,7 +330,7 @@ namespace ORB_SLAM3
         // Keypoints are assigned to cells in a grid to reduce matching complexity when projecting MapPoints.
         static float mfGridElementWidthInv;
         static float mfGridElementHeightInv;
-        std::vector<std::size_t> mGrid[FRAME_GRID_COLS][FRAME_GRID_ROWS];
+        FeatureGrid mGrid;
 
         IMU::Bias mPredBias;
 
@@ -289,6 +350,16 @@ namespace ORB_SLAM3
 
         // Current and Next Frame id.
         static long unsigned int nNextId;
+
+        // Number of frames built by the copy constructor since start-up.
+        static std::atomic<unsigned long> nNumCopies;
+
+        // Copies frame into this one reusing the buffers this frame already holds, so that once they have
+        // grown to the largest frame seen nothing is allocated. The descriptors are copied into rows of
+        // mDescriptorsBuffer instead of being shared with frame. The BoW vectors and the projection maps are
+        // node based and cannot be recycled, they are left empty (frame keeps its own). Returns true if
+        // any buffer had to be allocated.
+        bool Recycle(Frame &frame);
         long unsigned int mnId;
 
         // Reference Keyframe.
@@ -360,7 +431,7 @@ namespace ORB_SLAM3
         std::vector<Eigen::Vector3f> mvStereo3Dpoints;
 
         // Grid for the right image
-        std::vector<std::size_t> mGridRight[FRAME_GRID_COLS][FRAME_GRID_ROWS];
+        FeatureGrid mGridRight;
 
         Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, ORBextractor *extractorLeft, ORBextractor *extractorRight, ORBVocabulary *voc, cv::Mat &K, cv::Mat &distCoef, const float &bf, const float &thDepth, GeometricCamera *pCamera, GeometricCamera *pCamera2, Sophus::SE3f &Tlr, Frame *pPrevF = static_cast<Frame *>(NULL), const IMU::Calib &ImuCalib = IMU::Calib());
 
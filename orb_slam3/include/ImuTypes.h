@@ -41,6 +41,10 @@ namespace ORB_SLAM3
 
         const float GRAVITY_VALUE = 9.81;
 
+        // Largest rotation correction (rad) that Reintegrate applies to first order through the bias
+        // Jacobians. Beyond it the measurements are integrated again with the new bias
+        const float MAX_FIRST_ORDER_ROTATION = 0.005;
+
         // IMU measurement (gyro, accelerometer and timestamp)
         class Point
         {
@@ -169,7 +173,7 @@ namespace ORB_SLAM3
             EIGEN_MAKE_ALIGNED_OPERATOR_NEW
             Preintegrated(const Bias &b_, const Calib &calib);
             Preintegrated(Preintegrated *pImuPre);
-            Preintegrated() {}
+            Preintegrated() { dbgFirstOrder.setZero(); }
             ~Preintegrated() {}
             void CopyFrom(Preintegrated *pImuPre);
             void Initialize(const Bias &b_);
@@ -225,6 +229,8 @@ namespace ORB_SLAM3
             // Dif between original and updated bias
             // This is used to compute the updated values of the preintegration
             Eigen::Matrix<float, 6, 1> db;
+            // Gyro bias change applied to first order since the measurements were last integrated
+            Eigen::Vector3f dbgFirstOrder;
 
             struct integrable
             {
@@ -243,6 +249,9 @@ namespace ORB_SLAM3
                 float t;
             };
 
+            // Integrates one measurement with the original bias, without storing it
+            void Integrate(const Eigen::Vector3f &acceleration, const Eigen::Vector3f &angVel, const float &dt);
+
             std::vector<integrable> mvMeasurements;
 
             std::mutex mMutex;
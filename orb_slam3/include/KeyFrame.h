@@ -27,6 +27,7 @@
 #include "Frame.h"
 #include "KeyFrameDatabase.h"
 #include "ImuTypes.h"
+#include "FeatureGrid.h"
 #include "Semantic/Marker.h"
 #include "Semantic/Wall.h"
 #include "Semantic/Door.h"
@@ -34,11 +35,13 @@
 #include "GeometricCamera.h"
 #include "SerializationUtils.h"
 
+#include <atomic>
 #include <mutex>
 
 #include <boost/serialization/base_object.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/map.hpp>
+#include <boost/serialization/version.hpp>
 
 namespace ORB_SLAM3
 {
@@ -57,6 +60,21 @@ namespace ORB_SLAM3
     {
         friend class boost::serialization::access;
 
+        // Atlases saved before version 1 store the grids as nested vectors
+        template <class Archive>
+        static void serializeGrid(Archive &ar, FeatureGrid &grid, const unsigned int version)
+        {
+            if (version >= 1)
+            {
+                ar &grid;
+                return;
+            }
+
+            std::vector<std::vector<std::vector<size_t>>> vvvGrid;
+            ar &vvvGrid;
+            grid.Assign(vvvGrid);
+        }
+
         template <class Archive>
         void serialize(Archive &ar, const unsigned int version)
         {
@@ -153,7 +171,7 @@ namespace ORB_SLAM3
             // MapPointsId associated to keypoints
             ar &mvBackupMapPointsId;
             // Grid
-            ar &mGrid;
+            serializeGrid(ar, mGrid, version);
             // Connected KeyFrameWeight
             ar &mBackupConnectedKeyFrameIdWeights;
             // Spanning Tree and Loop Edges
@@ -182,7 +200,7 @@ namespace ORB_SLAM3
             ar &const_cast<int &>(NRight);
             serializeSophusSE3<Archive>(ar, mTlr, version);
             serializeVectorKeyPoints<Archive>(ar, mvKeysRight, version);
-            ar &mGridRight;
+            serializeGrid(ar, mGridRight, version);
 
             // Inertial variables
             ar &mImuBias;
@@ -258,6 +276,8 @@ namespace ORB_SLAM3
         void ReplaceMapPointMatch(const int &idx, MapPoint *pMP);
         std::set<MapPoint *> GetMapPoints();
         std::vector<MapPoint *> GetMapPointMatches();
+        // Changes every time a MapPoint match is added, erased or replaced
+        long unsigned int GetMapPointsVersion() const { return mnMapPointsVersion; }
         int TrackedMapPoints(const int &minObs);
         MapPoint *GetMapPoint(const size_t &idx);
 
@@ -338,6 +358,7 @@ namespace ORB_SLAM3
 
         // Variables used by the tracking
         long unsigned int mnTrackReferenceForFrame;
+        int mnTrackPointsSlot = -1; // Entry in the LocalMapCache of Tracking
         long unsigned int mnFuseTargetForKF;
 
         // Variables used by the local mapping
@@ -462,6 +483,7 @@ namespace ORB_SLAM3
 
         // MapPoints associated to keypoints
         std::vector<MapPoint *> mvpMapPoints;
+        std::atomic<long unsigned int> mnMapPointsVersion{0};
 
         // Markers available in each keyframe
         std::vector<Marker *> mvpMapMarkers;
@@ -480,7 +502,7 @@ namespace ORB_SLAM3
         ORBVocabulary *mpORBvocabulary;
 
         // Grid over the image to speed up feature matching
-        std::vector<std::vector<std::vector<size_t>>> mGrid;
+        FeatureGrid mGrid;
 
         std::map<KeyFrame *, int> mConnectedKeyFrameWeights;
         std::vector<KeyFrame *> mvpOrderedConnectedKeyFrames;
@@ -540,7 +562,7 @@ namespace ORB_SLAM3
 
         const int NLeft, NRight;
 
-        std::vector<std::vector<std::vector<size_t>>> mGridRight;
+        FeatureGrid mGridRight;
 
         Sophus::SE3<float> GetRightPose();
         Sophus::SE3<float> GetRightPoseInverse();
@@ -569,4 +591,6 @@ namespace ORB_SLAM3
 
 } // namespace ORB_SLAM
 
+BOOST_CLASS_VERSION(ORB_SLAM3::KeyFrame, 1)
+
 #endif // KEYFRAME_H
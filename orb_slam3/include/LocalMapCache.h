@@ -0,0 +1,108 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOCALMAPCACHE_H
+#define LOCALMAPCACHE_H
+
+#include <map>
+#include <vector>
+
+#include "Frame.h"
+
+namespace ORB_SLAM3
+{
+
+    class KeyFrame;
+    class MapPoint;
+
+    /**
+     * Incremental version of the local map of Tracking. Keeps, in flat arrays indexed from the
+     * MapPoints (mnTrackVotesSlot) and KeyFrames (mnTrackPointsSlot), what was read from them in
+     * the previous frame together with their observation/match versions, so only the points that
+     * entered or left the frame, or whose observations changed (keyframe insertion, culling,
+     * fusion) are re-read. Entries not refreshed in a pass are dropped without touching the
+     * object they refer to, which may have been deleted (temporal points).
+     * Clear() must be called whenever KeyFrames or MapPoints are deleted (map resets).
+     */
+    class LocalMapCache
+    {
+    public:
+        LocalMapCache();
+
+        void Clear();
+
+        // Keyframe covisibility votes of the tracked points (one vote per point and observing keyframe),
+        // as the counter UpdateLocalKeyFrames used to rebuild. Bad points are set to NULL in vpTrackedMPs
+        const std::map<KeyFrame *, int> &UpdateKeyFrameVotes(std::vector<MapPoint *> &vpTrackedMPs);
+
+        // MapPoints of the local keyframes, in reverse keyframe order and without repetitions. The
+        // list is only rebuilt (and the generation increased) when the keyframes or their matches changed
+        void UpdateLocalPoints(const std::vector<KeyFrame *> &vpLocalKFs, const long unsigned int nFrameId,
+                               std::vector<MapPoint *> &vpLocalMPs);
+
+        long unsigned int GetGeneration() const { return mnGeneration; }
+
+        // Contiguous snapshot of the position, normal and distance limits of vpLocalMPs (the list given
+        // by UpdateLocalPoints), for the batched frustum test. Only the points whose geometry changed
+        // since the last call are read again, unless the list was rebuilt
+        const MapPointGeometry &UpdateGeometry(const std::vector<MapPoint *> &vpLocalMPs);
+
+    protected:
+        struct TrackedPoint
+        {
+            MapPoint *pMP;
+            long unsigned int nId;
+            long unsigned int nVersion; // Observations version vpKFs was read at
+            long unsigned int nPass;    // Last pass the point was tracked in
+            int nCount;                 // Occurrences in the frame in the current pass
+            int nVotes;                 // Occurrences accounted in the votes
+            std::vector<KeyFrame *> vpKFs;
+        };
+
+        struct LocalKeyFrame
+        {
+            KeyFrame *pKF;
+            long unsigned int nId;
+            long unsigned int nVersion; // Matches version vpMPs was read at
+            long unsigned int nPass;
+            std::vector<MapPoint *> vpMPs;
+        };
+
+        void ReadObservations(TrackedPoint &tp);
+        void AddVotes(const TrackedPoint &tp, const int n);
+
+        std::vector<TrackedPoint> mvTrackedPoints;
+        std::map<KeyFrame *, int> mmKeyFrameVotes;
+        long unsigned int mnVotesPass;
+
+        std::vector<LocalKeyFrame> mvLocalKeyFrames;
+        std::vector<KeyFrame *> mvpLastLocalKFs;
+        long unsigned int mnPointsPass;
+        bool mbPointsValid;
+
+        long unsigned int mnGeneration;
+
+        MapPointGeometry mGeometry;
+        std::vector<long unsigned int> mvGeometryVersions; // Geometry version of each snapshot entry
+        long unsigned int mnGeometryGeneration;           // Generation the snapshot entries refer to
+        bool mbGeometryValid;
+    };
+
+} // namespace ORB_SLAM3
+
+#endif // LOCALMAPCACHE_H
@@ -27,10 +27,14 @@
 #include "Semantic/Marker.h"
 
 #include <set>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
 #include <pangolin/pangolin.h>
 #include <mutex>
 
 #include <boost/serialization/base_object.hpp>
+#include <boost/serialization/version.hpp>
 
 namespace ORB_SLAM3
 {
@@ -71,6 +75,18 @@ namespace ORB_SLAM3
             ar &mbIsInertial;
             ar &mbIMU_BA1;
             ar &mbIMU_BA2;
+
+            // Semantic entities, not present in maps saved before version 1
+            if (version >= 1)
+            {
+                ar &mvpBackupMarkers;
+                ar &mvpBackupWalls;
+                ar &mvpBackupDoors;
+                ar &mvpBackupRooms;
+                ar &mvBackupMarkersKFId;
+                ar &mvBackupWallsKFId;
+                ar &mvBackupDoorsKFId;
+            }
         }
 
     public:
@@ -97,10 +113,31 @@ namespace ORB_SLAM3
         void InformNewBigChange();
         int GetLastBigChangeIdx();
 
+        // Change feed of the map points (added, moved by BA/loop correction or erased).
+        // Every change gets a sequence number, so clients can request only the updates
+        // since the last sequence they have seen.
+        // Moves of points in the map are only marked, they are recorded in the feed and the voxel
+        // index in one batch by IndexMovedMapPoints (called after the optimizations, and before
+        // reading the feed or the index).
+        void InformMapPointMoved(MapPoint *pMP);
+        void IndexMovedMapPoints();
+        long unsigned int GetMapPointSeq();
+        // Returns false if the changes since nSeq are no longer available (feed trimmed or map cleared)
+        // and a full snapshot is required. nSeq is updated to the last sequence number of the feed.
+        bool GetMapPointChangesSince(long unsigned int &nSeq, std::vector<MapPoint *> &vpChangedMPs,
+                                     std::vector<long unsigned int> &vnErasedMPIds);
+
+        // Spatial queries on the voxel index of the map points (bad points are skipped)
+        std::vector<MapPoint *> GetMapPointsInRadius(const Eigen::Vector3f &center, const float radius);
+        // Points whose distance to the (normalized) plane is below maxDist
+        std::vector<MapPoint *> GetMapPointsNearPlane(const Eigen::Vector4d &plane, const float maxDist);
+
         std::vector<Wall *> GetAllWalls();
         std::vector<Door *> GetAllDoors();
         std::vector<Room *> GetAllRooms();
         std::vector<Marker *> GetAllMarkers();
+        // Marker of the map with the given ArUco id, NULL if it has not been mapped
+        Marker *GetMarkerById(int nMarkerId);
         std::vector<KeyFrame *> GetAllKeyFrames();
         std::vector<MapPoint *> GetAllMapPoints();
         std::vector<MapPoint *> GetReferenceMapPoints();
@@ -172,6 +209,12 @@ namespace ORB_SLAM3
 
         static long unsigned int nNextId;
 
+        // Maximum number of entries kept in the map point change feed
+        static const long unsigned int MAX_MAPPOINT_CHANGES = 1000000;
+
+        // Side (meters) of the voxels of the map point index
+        static constexpr float MAPPOINT_VOXEL_SIZE = 0.25f;
+
         // DEBUG: show KFs which are used in LBA
         std::set<long unsigned int> msOptKFs;
         std::set<long unsigned int> msFixedKFs;
@@ -183,12 +226,22 @@ namespace ORB_SLAM3
         std::set<Door *> mspDoors;
         std::set<Room *> mspRooms;
         std::set<Marker *> mspMarkers;
+        std::unordered_map<int, Marker *> mmMarkersById;
         std::set<MapPoint *> mspMapPoints;
         std::set<KeyFrame *> mspKeyFrames;
 
         // Save/load, the set structure is broken in libboost 1.58 for ubuntu 16.04, a vector is serializated
         std::vector<MapPoint *> mvpBackupMapPoints;
         std::vector<KeyFrame *> mvpBackupKeyFrames;
+        std::vector<Marker *> mvpBackupMarkers;
+        std::vector<Wall *> mvpBackupWalls;
+        std::vector<Door *> mvpBackupDoors;
+        std::vector<Room *> mvpBackupRooms;
+
+        // Id of the keyframe holding each marker, wall and door (-1 if none)
+        std::vector<long unsigned int> mvBackupMarkersKFId;
+        std::vector<long unsigned int> mvBackupWallsKFId;
+        std::vector<long unsigned int> mvBackupDoorsKFId;
 
         KeyFrame *mpKFinitial;
         KeyFrame *mpKFlowerID;
@@ -198,6 +251,34 @@ namespace ORB_SLAM3
 
         std::vector<MapPoint *> mvpReferenceMapPoints;
 
+        // Save/load of markers, walls, doors and rooms
+        void PreSaveSemantics();
+        void PostLoadSemantics(map<long unsigned int, KeyFrame *> &mpKeyFrameId, map<long unsigned int, MapPoint *> &mpMapPointId);
+
+        // Map point change feed
+        struct MapPointChange
+        {
+            long unsigned int mnSeq;
+            MapPoint *mpMP;
+            long unsigned int mnMPId;
+            bool mbErased;
+        };
+        std::deque<MapPointChange> mdMapPointChanges;
+        long unsigned int mnMapPointSeq;
+        long unsigned int mnMapPointSeqOldest;
+
+        // Voxel hash of the map points, updated when points are added, moved or erased
+        typedef long long int VoxelKey;
+        VoxelKey GetVoxelKey(const int x, const int y, const int z);
+        VoxelKey GetVoxelKey(const Eigen::Vector3f &pos);
+        Eigen::Vector3f GetVoxelCenter(const VoxelKey key);
+        void IndexMapPoint(MapPoint *pMP);
+        void UnindexMapPoint(MapPoint *pMP);
+        std::unordered_map<VoxelKey, std::vector<MapPoint *>> mmVoxelMapPoints;
+        std::unordered_map<MapPoint *, VoxelKey> mmMapPointVoxel;
+        // Indexed points moved since the last IndexMovedMapPoints
+        std::unordered_set<MapPoint *> mspMovedMapPoints;
+
         bool mbImuInitialized;
 
         int mnMapChange;
@@ -223,8 +304,16 @@ namespace ORB_SLAM3
 
         // Mutex
         std::mutex mMutexMap;
+        std::mutex mMutexMapPointChanges;
+        std::mutex mMutexVoxelIndex;
+
+        void RecordMapPointChange(MapPoint *pMP, const bool bErased);
+        void RecordMapPointMoves(const std::vector<MapPoint *> &vpMPs);
     };
 
 } // namespace ORB_SLAM3
 
+// Version 1: semantic entities (markers, walls, doors and rooms)
+BOOST_CLASS_VERSION(ORB_SLAM3::Map, 1)
+
 #endif // MAP_H
@@ -27,6 +27,7 @@
 #include "SerializationUtils.h"
 
 #include <opencv2/core/core.hpp>
+#include <atomic>
 #include <mutex>
 
 #include <boost/serialization/serialization.hpp>
@@ -114,14 +115,25 @@ namespace ORB_SLAM3
         Eigen::Vector3f GetNormal();
         void SetNormalVector(const Eigen::Vector3f &normal);
 
+        // Position, normal and (unscaled) min/max distances read under a single lock
+        void GetViewGeometry(Eigen::Vector3f &Pos, Eigen::Vector3f &Normal, float &minDistance, float &maxDistance);
+        // Changes every time the position, normal or distances are modified
+        long unsigned int GetGeometryVersion() const { return mnGeometryVersion; }
+
         KeyFrame *GetReferenceKeyFrame();
 
         std::map<KeyFrame *, std::tuple<int, int>> GetObservations();
         int Observations();
+        // Changes every time an observation is added or erased
+        long unsigned int GetObservationsVersion() const { return mnObservationsVersion; }
 
         void AddObservation(KeyFrame *pKF, int idx);
         void EraseObservation(KeyFrame *pKF);
 
+        // Number of keyframes, other than pKF, observing the point at a scale level up to maxLevel (the
+        // finest of its two keypoints in a camera rig). Read from counters kept with the observations
+        int ObservationsUpToLevel(KeyFrame *pKF, const int maxLevel);
+
         std::tuple<int, int> GetIndexInKeyFrame(KeyFrame *pKF);
         bool IsInKeyFrame(KeyFrame *pKF);
 
@@ -177,6 +189,7 @@ namespace ORB_SLAM3
         float mTrackViewCos, mTrackViewCosR;
         long unsigned int mnTrackReferenceForFrame;
         long unsigned int mnLastFrameSeen;
+        int mnTrackVotesSlot = -1; // Entry in the LocalMapCache of Tracking
 
         // Variables used by local mapping
         long unsigned int mnBALocalForKF;
@@ -207,9 +220,13 @@ namespace ORB_SLAM3
     protected:
         // Position in absolute coordinates
         Eigen::Vector3f mWorldPos;
+        std::atomic<long unsigned int> mnGeometryVersion{0};
 
         // Keyframes observing the point and associated index in keyframe
         std::map<KeyFrame *, std::tuple<int, int>> mObservations;
+        std::atomic<long unsigned int> mnObservationsVersion{0};
+        // Number of observing keyframes at each scale level
+        std::vector<int> mvnObservationsPerLevel;
         // For save relation without pointer, this is necessary for save/load function
         std::map<long unsigned int, int> mBackupObservationsId1;
         std::map<long unsigned int, int> mBackupObservationsId2;
@@ -244,6 +261,10 @@ namespace ORB_SLAM3
         std::mutex mMutexPos;
         std::mutex mMutexFeatures;
         std::mutex mMutexMap;
+
+        // Scale level of an observation and update of mvnObservationsPerLevel (with mMutexFeatures locked)
+        static int ObservationLevel(KeyFrame *pKF, const std::tuple<int, int> &indexes);
+        void CountObservationLevel(const int level, const int n);
     };
 
 } // namespace ORB_SLAM
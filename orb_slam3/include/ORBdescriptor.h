@@ -0,0 +1,64 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ORBDESCRIPTOR_H
+#define ORBDESCRIPTOR_H
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM3
+{
+
+    // Sampling pattern split into the first and second point of each of the 256 pairs, as floats
+    struct OrbPatternSoA
+    {
+        alignas(32) float x0[256];
+        alignas(32) float y0[256];
+        alignas(32) float x1[256];
+        alignas(32) float y1[256];
+
+        explicit OrbPatternSoA(const cv::Point* pattern)
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                x0[i] = (float)pattern[2*i].x;
+                y0[i] = (float)pattern[2*i].y;
+                x1[i] = (float)pattern[2*i+1].x;
+                y1[i] = (float)pattern[2*i+1].y;
+            }
+        }
+    };
+
+    // Computes the 32 byte descriptor of a keypoint from the 256 point pairs of the pattern
+    typedef void (*OrbDescriptorKernel)(const cv::KeyPoint& kpt, const cv::Mat& img, const cv::Point* pattern,
+                                        const OrbPatternSoA& soa, uchar* desc);
+
+    // Reference kernel, rotates every point of the pattern with the angle of the keypoint
+    void computeOrbDescriptorScalar(const cv::KeyPoint& kpt, const cv::Mat& img, const cv::Point* pattern,
+                                    const OrbPatternSoA& soa, uchar* desc);
+
+    // Vector kernels supported by the CPU, widest first
+    std::vector<OrbDescriptorKernel> supportedOrbDescriptorKernels();
+
+    // Widest kernel supported by the CPU, probed once. cv::setUseOptimized(false) forces the scalar one
+    OrbDescriptorKernel selectOrbDescriptorKernel();
+
+} //namespace ORB_SLAM
+
+#endif
@@ -39,6 +39,10 @@ namespace ORB_SLAM3
         // Computes the Hamming distance between two ORB descriptors
         static int DescriptorDistance(const cv::Mat &a, const cv::Mat &b);
 
+        // Computes the Hamming distances between one ORB descriptor and a batch of candidates (pointers to
+        // their 32 bytes), vDist[i] being the distance to vpCandidates[i]
+        static void DescriptorDistances(const cv::Mat &a, const std::vector<const uchar *> &vpCandidates, std::vector<int> &vDist);
+
         // Search matches between Frame keypoints and projected MapPoints. Returns number of matches
         // Used to track the local map (Tracking)
         int SearchByProjection(Frame &F, const std::vector<MapPoint *> &vpMapPoints, const float th = 3, const bool bFarPoints = false, const float thFarPoints = 50.0f);
@@ -80,6 +84,13 @@ namespace ORB_SLAM3
         // Project MapPoints into KeyFrame and search for duplicated MapPoints.
         int Fuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const float th = 3.0, const bool bRight = false);
 
+        // The two phases of Fuse. SearchForFuse only reads the map, so it can run concurrently for different
+        // keyframes, and returns the (keypoint, MapPoint) pairs to fuse. FuseMatches applies them in order,
+        // skipping the points replaced or already added to the keyframe since the search
+        int SearchForFuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, vector<pair<size_t, MapPoint *>> &vMatches,
+                          const float th = 3.0, const bool bRight = false);
+        int FuseMatches(KeyFrame *pKF, const vector<pair<size_t, MapPoint *>> &vMatches);
+
         // Project MapPoints into KeyFrame using a given Sim3 and search for duplicated MapPoints.
         int Fuse(KeyFrame *pKF, Sophus::Sim3f &Scw, const std::vector<MapPoint *> &vpPoints, float th, vector<MapPoint *> &vpReplacePoint);
 
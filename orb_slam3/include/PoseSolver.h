@@ -0,0 +1,120 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POSESOLVER_H
+#define POSESOLVER_H
+
+#include <vector>
+
+#include <Eigen/Core>
+#include <sophus/se3.hpp>
+
+#include "Thirdparty/g2o/g2o/types/se3quat.h"
+#include "CameraModels/GeometricCamera.h"
+
+namespace ORB_SLAM3
+{
+
+    /**
+     * Motion-only pose estimation of a single frame. It solves the same problem as the g2o graph that
+     * PoseOptimization used to build (one SE3 vertex, unary reprojection edges with Huber kernels,
+     * Levenberg-Marquardt with g2o's damping rules) but keeps the observations in flat arrays and the
+     * normal equations in a fixed 6x6 system, so no allocation or virtual call is done per edge.
+     * Pinhole cameras are projected inline, other models go through GeometricCamera.
+     */
+    class PoseSolver
+    {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        enum eObservationType
+        {
+            MONOCULAR = 0,   // Left camera (u,v)
+            MONOCULAR_RIGHT, // Second camera of a rig, projected through Trl (u,v)
+            STEREO           // Rectified stereo (u,v,ur)
+        };
+
+        PoseSolver(GeometricCamera *pCamera, GeometricCamera *pCamera2, const Sophus::SE3f &Trl,
+                   const float fx, const float fy, const float cx, const float cy, const float bf,
+                   const float deltaMono, const float deltaStereo);
+
+        void Reserve(const size_t n);
+
+        // Returns the index of the new observation. All observations start active and robust
+        int AddMonocular(const Eigen::Vector3f &Xw, const float u, const float v, const float invSigma2, const bool bRight = false);
+        int AddStereo(const Eigen::Vector3f &Xw, const float u, const float v, const float ur, const float invSigma2);
+
+        size_t Size() const { return mvType.size(); }
+        bool IsStereo(const size_t i) const { return mvType[i] == STEREO; }
+
+        void SetEstimate(const g2o::SE3Quat &Tcw) { mTcw = Tcw; }
+        const g2o::SE3Quat &GetEstimate() const { return mTcw; }
+
+        // Inactive observations are left out of the optimization (g2o level 1)
+        void SetActive(const size_t i, const bool bActive) { mvbActive[i] = bActive; }
+        void SetRobust(const bool bRobust) { mbRobust = bRobust; }
+
+        // Levenberg-Marquardt over the active observations starting from the current estimate
+        void Optimize(const int nIterations);
+
+        // Chi2 of the observation at the last estimate it was evaluated at (like g2o's edge->chi2())
+        double Chi2(const size_t i) const { return mvChi2[i]; }
+        // Re-evaluates the chi2 of the observation at the current estimate
+        double ComputeChi2(const size_t i);
+
+    protected:
+        typedef Eigen::Matrix<double, 6, 6> Matrix6d;
+        typedef Eigen::Matrix<double, 6, 1> Vector6d;
+
+        // Fills the residual (2 or 3 rows) of observation i at [Rcw|tcw] and, if pJ is given, its Jacobian
+        // with respect to the left-multiplied pose increment. Returns the chi2
+        double Evaluate(const size_t i, const Eigen::Matrix3d &Rcw, const Eigen::Vector3d &tcw,
+                        Eigen::Vector3d &e, Eigen::Matrix<double, 3, 6> *pJ) const;
+
+        // Sum of the (robustified) chi2 of the active observations at Tcw, storing each chi2
+        double ComputeActiveChi2(const g2o::SE3Quat &Tcw);
+
+        // Robust cost and weight of a chi2 value (Huber, as g2o::RobustKernelHuber)
+        void Robustify(const size_t i, const double chi2, double &cost, double &weight) const;
+
+        // Observations, one entry per index
+        std::vector<double> mvX, mvY, mvZ;
+        std::vector<double> mvU, mvV, mvUr;
+        std::vector<double> mvInvSigma2;
+        std::vector<unsigned char> mvType;
+        std::vector<bool> mvbActive;
+        std::vector<double> mvChi2;
+
+        // Active observations of the current optimization
+        std::vector<size_t> mvActive;
+
+        GeometricCamera *mpCamera, *mpCamera2;
+        bool mbPinhole, mbPinhole2;
+        double mK[4], mK2[4]; // fx, fy, cx, cy of the pinhole cameras
+        Eigen::Matrix3d mRrl;
+        Eigen::Vector3d mtrl;
+        double fx, fy, cx, cy, bf;
+        double mDeltaMono, mDeltaStereo;
+        bool mbRobust;
+
+        g2o::SE3Quat mTcw;
+    };
+
+} // namespace ORB_SLAM3
+
+#endif // POSESOLVER_H
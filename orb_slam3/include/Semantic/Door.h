@@ -10,6 +10,9 @@
 
 #include "Map.h"
 #include "Marker.h"
+#include "SerializationUtils.h"
+
+#include <boost/serialization/string.hpp>
 
 namespace ORB_SLAM3
 {
@@ -18,6 +21,23 @@ namespace ORB_SLAM3
 
     class Door
     {
+        friend class boost::serialization::access;
+
+        template <class Archive>
+        void serialize(Archive &ar, const unsigned int version)
+        {
+            ar &id;
+            ar &opId;
+            ar &opIdG;
+            ar &marker_id;
+            ar &name;
+            serializeSophusSE3(ar, local_pose, version);
+            serializeSophusSE3(ar, global_pose, version);
+
+            // The marker is saved by its index in the map
+            ar &mnBackupMarkerIdx;
+        }
+
     private:
         int id;                   // The door's identifier
         int opId;                 // The door's identifier in the local optimizer
@@ -59,9 +79,16 @@ namespace ORB_SLAM3
         Map *GetMap();
         void SetMap(Map *pMap);
 
+        void PreSave(const std::map<Marker *, int> &mMarkerIdx);
+        // Returns false if the door's marker was not saved with the map
+        bool PostLoad(const std::vector<Marker *> &vpMarkers, Map *pMap);
+
     protected:
         Map *mpMap;
         std::mutex mMutexMap;
+
+        // For save relation without pointer, this is necessary for save/load function
+        int mnBackupMarkerIdx;
     };
 
 }
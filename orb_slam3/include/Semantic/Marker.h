@@ -10,6 +10,9 @@
 
 #include "Map.h"
 #include "KeyFrame.h"
+#include "SerializationUtils.h"
+
+#include <boost/serialization/vector.hpp>
 
 namespace ORB_SLAM3
 {
@@ -18,6 +21,27 @@ namespace ORB_SLAM3
 
     class Marker
     {
+        friend class boost::serialization::access;
+
+        template <class Archive>
+        void serialize(Archive &ar, const unsigned int version)
+        {
+            ar &id;
+            ar &opId;
+            ar &opIdG;
+            ar &time;
+            ar &markerInGMap;
+            serializeSophusSE3(ar, local_pose, version);
+            serializeSophusSE3(ar, global_pose, version);
+
+            // Observations are saved by the id of the keyframes
+            ar &mvBackupObsKFIds;
+            if (Archive::is_loading::value)
+                mvBackupObsPoses.resize(mvBackupObsKFIds.size());
+            for (Sophus::SE3f &pose : mvBackupObsPoses)
+                serializeSophusSE3(ar, pose, version);
+        }
+
     private:
         int id;                                           // The marker's identifier
         int opId;                                         // The marker's identifier in the local optimizer
@@ -61,9 +85,16 @@ namespace ORB_SLAM3
         Map *GetMap();
         void SetMap(Map *pMap);
 
+        void PreSave(std::set<KeyFrame *> &spKF);
+        void PostLoad(std::map<long unsigned int, KeyFrame *> &mpKFid, Map *pMap);
+
     protected:
         Map *mpMap;
         std::mutex mMutexMap;
+
+        // For save relation without pointer, this is necessary for save/load function
+        std::vector<long unsigned int> mvBackupObsKFIds;
+        std::vector<Sophus::SE3f, Eigen::aligned_allocator<Sophus::SE3f>> mvBackupObsPoses;
     };
 
 }
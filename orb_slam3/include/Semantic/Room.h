@@ -10,8 +10,13 @@
 
 #include "Door.h"
 #include "Wall.h"
+#include "SerializationUtils.h"
 #include "Thirdparty/g2o/g2o/types/vertex_plane.h"
 
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/array.hpp>
+
 namespace ORB_SLAM3
 {
     class Door;
@@ -19,6 +24,25 @@ namespace ORB_SLAM3
 
     class Room
     {
+        friend class boost::serialization::access;
+
+        template <class Archive>
+        void serialize(Archive &ar, const unsigned int version)
+        {
+            ar &id;
+            ar &opId;
+            ar &opIdG;
+            ar &name;
+            ar &all_seen_markers;
+            ar &boost::serialization::make_array(room_center.data(), room_center.size());
+            ar &door_marker_ids;
+            ar &wall_marker_ids;
+
+            // Walls and doors are saved by their index in the map
+            ar &mvBackupWallsIdx;
+            ar &mvBackupDoorsIdx;
+        }
+
     private:
         int id;                                        // The room's identifier
         int opId;                                      // The room's identifier in the local optimizer
@@ -72,7 +96,14 @@ namespace ORB_SLAM3
         Map *GetMap();
         void SetMap(Map *pMap);
 
+        void PreSave(const std::map<Wall *, int> &mWallIdx, const std::map<Door *, int> &mDoorIdx);
+        void PostLoad(const std::vector<Wall *> &vpWalls, const std::vector<Door *> &vpDoors, Map *pMap);
+
     protected:
+        // For save relation without pointer, this is necessary for save/load function
+        std::vector<int> mvBackupWallsIdx;
+        std::vector<int> mvBackupDoorsIdx;
+
         Map *mpMap;
         std::mutex mMutexMap;
     };
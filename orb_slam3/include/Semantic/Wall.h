@@ -12,8 +12,12 @@
 #include "Map.h"
 #include "MapPoint.h"
 #include "Semantic/Marker.h"
+#include "SerializationUtils.h"
 #include "Thirdparty/g2o/g2o/types/plane3d.h"
 
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/array.hpp>
+
 namespace ORB_SLAM3
 {
     class Map;
@@ -22,6 +26,30 @@ namespace ORB_SLAM3
 
     class Wall
     {
+        friend class boost::serialization::access;
+
+        template <class Archive>
+        void serialize(Archive &ar, const unsigned int version)
+        {
+            ar &id;
+            ar &opId;
+            ar &opIdG;
+            ar &color;
+
+            Eigen::Vector4d coeffs;
+            if (Archive::is_saving::value)
+                coeffs = plane_equation.coeffs();
+            ar &boost::serialization::make_array(coeffs.data(), coeffs.size());
+            if (Archive::is_loading::value)
+                plane_equation.fromVector(coeffs);
+
+            ar &boost::serialization::make_array(centroid.data(), centroid.size());
+
+            // Markers are saved by their index in the map, map points by their id
+            ar &mvBackupMarkersIdx;
+            ar &mvBackupMapPointsId;
+        }
+
     private:
         int id;                          // The wall's identifier
         int opId;                        // The wall's identifier in the local optimizer
@@ -63,9 +91,16 @@ namespace ORB_SLAM3
         Map *GetMap();
         void SetMap(Map *pMap);
 
+        void PreSave(const std::map<Marker *, int> &mMarkerIdx, std::set<MapPoint *> &spMP);
+        void PostLoad(const std::vector<Marker *> &vpMarkers, std::map<long unsigned int, MapPoint *> &mpMPid, Map *pMap);
+
     protected:
         Map *mpMap;
         std::mutex mMutexMap, mMutexPoint;
+
+        // For save relation without pointer, this is necessary for save/load function
+        std::vector<int> mvBackupMarkersIdx;
+        std::vector<long unsigned int> mvBackupMapPointsId;
     };
 }
 
@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <string>
 #include <thread>
+#include <chrono>
 #include <opencv2/core/core.hpp>
 
 #include "Tracking.h"
@@ -134,6 +135,11 @@ namespace ORB_SLAM3
         // This resumes local mapping thread and performs SLAM again.
         void DeactivateLocalizationMode();
 
+        // Overlaps the frame construction of the next nDepth images with the tracking of the current one
+        // (0 disables it, the default). Track* then returns the pose of the image given nDepth calls before.
+        // Applied on the next Track* call.
+        void SetTrackingPipelineDepth(int nDepth);
+
         // Returns true if there have been a big map change (loop closure, global BA)
         // since last call to this function
         bool MapChanged();
@@ -182,6 +188,12 @@ namespace ORB_SLAM3
         // Information from most recent processed frame
         // You can call this right after TrackMonocular (or stereo or RGBD)
         int GetTrackingState();
+        // Timestamp of the frame tracked by the last Track* call and when its image was given to the
+        // system. Returns false if no frame was tracked yet.
+        bool GetTrackedFrameTime(double &timestamp, std::chrono::steady_clock::time_point &grabTime);
+        // Body pose, velocity and IMU bias of that frame. Returns false for non-inertial sensors, before the
+        // IMU initialization and if the frame was not tracked successfully.
+        bool GetTrackedImuState(double &timestamp, Sophus::SE3f &Twb, Eigen::Vector3f &Vwb, IMU::Bias &bias);
         cv::Mat GetCurrentFrame();
         std::vector<Door *> GetAllDoors();
         std::vector<Wall *> GetAllWalls();
@@ -192,6 +204,12 @@ namespace ORB_SLAM3
         std::vector<Sophus::SE3f> GetAllKeyframePoses();
         std::vector<cv::KeyPoint> GetTrackedKeyPointsUn();
 
+        // Map points added, moved or erased in the active map since the sequence number nSeq.
+        // Returns false if a full snapshot (GetAllMapPoints) is required instead: first request,
+        // the active map changed or the requested changes are no longer available.
+        bool GetMapPointChanges(long unsigned int &nMapId, long unsigned int &nSeq, std::vector<MapPoint *> &vpChangedMPs,
+                                std::vector<long unsigned int> &vnErasedMPIds);
+
         Sophus::SE3f GetCamTwc();
         Sophus::SE3f GetImuTwb();
         Eigen::Vector3f GetImuVwb();
@@ -264,6 +282,7 @@ namespace ORB_SLAM3
         std::mutex mMutexMode;
         bool mbActivateLocalizationMode;
         bool mbDeactivateLocalizationMode;
+        int mnPipelineDepthRequest;
 
         // Shutdown flag
         bool mbShutDown;
@@ -272,8 +291,17 @@ namespace ORB_SLAM3
         int mTrackingState;
         std::vector<MapPoint *> mTrackedMapPoints;
         std::vector<cv::KeyPoint> mTrackedKeyPointsUn;
+        double mTrackedTimestamp;
+        std::chrono::steady_clock::time_point mTrackedGrabTime;
+        bool mbTrackedImuValid;
+        Sophus::SE3f mTrackedTwb;
+        Eigen::Vector3f mTrackedVwb;
+        IMU::Bias mTrackedImuBias;
         std::mutex mMutexState;
 
+        // Copies the IMU state of the tracked frame (called with mMutexState locked)
+        void StoreTrackedImuState();
+
         //
         string mStrLoadAtlasFromFile;
         string mStrSaveAtlasToFile;
@@ -40,6 +40,7 @@
 #include "Semantic/Room.h"
 #include "Semantic/Marker.h"
 #include "GeometricCamera.h"
+#include "LocalMapCache.h"
 
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
@@ -47,6 +48,11 @@
 #include <pcl/filters/extract_indices.h>
 
 #include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <thread>
 #include <unordered_set>
 
 namespace ORB_SLAM3
@@ -85,6 +91,15 @@ namespace ORB_SLAM3
 
         void GrabImuData(const IMU::Point &imuMeasurement);
 
+        // Opt-in two-stage pipeline. With nDepth > 0 the frames (feature extraction, undistortion,
+        // stereo/depth association) are built on a dedicated thread while the previous one is tracked,
+        // and GrabImage* returns the pose of the frame submitted nDepth calls before. At most nDepth
+        // frames wait to be tracked. nDepth = 0 stops the pipeline and drops those frames.
+        void SetPipelineDepth(int nDepth);
+        int GetPipelineDepth();
+        // Stops the pipeline for good (shutdown), from any thread. Frames not tracked yet are dropped
+        void ClosePipeline();
+
         void SetLocalMapper(LocalMapping *pLocalMapper);
         void SetLoopClosing(LoopClosing *pLoopClosing);
         void SetViewer(Viewer *pViewer);
@@ -173,23 +188,6 @@ namespace ORB_SLAM3
          */
         bool getPlaneEquationFromPoints(const Marker *currentMarker, Eigen::Vector4d &planeEstimate);
 
-        /**
-         * @brief Get the points close to a given location
-         * @param points the set of map-points
-         * @param location the given location
-         * @param distanceThreshold the pre-defined threshold
-         */
-        std::vector<MapPoint *> findPointsCloseToLocation(const std::vector<MapPoint *> &points,
-                                                          const Eigen::Vector3f &location,
-                                                          double distanceThreshold);
-
-        /**
-         * @brief Calculate L2-norm between two given points
-         * @param point1 first point
-         * @param point2 second point
-         */
-        double calculateDistance(const Eigen::Vector3f &p1, const Eigen::Vector3f &p2);
-
         /**
          * @brief Perform PCL ransac to get the plane equation from the points         *
          * @param points the set of given map-points
@@ -297,8 +295,17 @@ namespace ORB_SLAM3
         Frame mCurrentFrame;
         Frame mLastFrame;
 
+        // Hand-offs of the current frame to mLastFrame, and how many of them had to allocate (see Frame::Recycle)
+        unsigned long mnFrameHandOffs = 0;
+        unsigned long mnFrameHandOffAllocs = 0;
+
         cv::Mat mImGray;
 
+        // Timestamp of the last tracked frame (negative before the first one) and when its image was
+        // grabbed. With the pipeline enabled it lags behind the last grabbed image.
+        double mTrackedTimestamp = -1.0;
+        std::chrono::steady_clock::time_point mTrackedGrabTime;
+
         // Initialization Variables (Monocular)
         std::vector<int> mvIniLastMatches;
         std::vector<int> mvIniMatches;
@@ -392,6 +399,53 @@ namespace ORB_SLAM3
         // Reset IMU biases and compute frame velocity
         void ResetFrameIMU();
 
+        // Copies the current frame into mLastFrame, reusing the storage of the previous last frame
+        void HandOffLastFrame();
+
+        // Input of a frame, kept together with the frame until it is tracked
+        struct FrameRequest
+        {
+            EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+            cv::Mat imGray, imGrayRight, imDepth, imRight;
+            double timestamp = 0.0;
+            string filename;
+            ORBextractor *pExtractor = nullptr;
+            std::vector<Marker *> markers;
+            std::vector<Door *> doors;
+            std::vector<Room *> rooms;
+            std::vector<std::shared_ptr<Marker>> vpMarkerCopies;
+            std::chrono::steady_clock::time_point grabTime;
+            Frame frame;
+        };
+
+        // Frame construction, only depends on the request and the calibration
+        void BuildFrame(FrameRequest &req);
+        // Takes the built frame of the request as current frame and tracks it
+        Sophus::SE3f TrackRequest(FrameRequest &req);
+
+        // Queues the request for the frame builder and tracks the oldest frame once nDepth are waiting
+        Sophus::SE3f SubmitRequest(const std::shared_ptr<FrameRequest> &pReq);
+        void RunFrameBuilder();
+        // Drops the frames not tracked yet, waiting for the one being built
+        void ClearPipeline();
+
+        int mnPipelineDepth = 0;
+        std::thread *mptFrameBuilder = nullptr;
+        bool mbFinishFrameBuilder = false;
+        bool mbBuildingFrame = false;
+        bool mbPipelineClosed = false;
+        std::deque<std::shared_ptr<FrameRequest>> mlPendingRequests, mlBuiltRequests;
+        std::mutex mMutexPipeline;
+        std::condition_variable mcvPipeline;
+        std::vector<std::shared_ptr<Marker>> mvpCurrentMarkerCopies;
+
+        // Input images in the format expected by Frame (gray, metric CV_32F depth). Inputs already in
+        // that format are shared, converted ones are written into buffers reused across frames.
+        int GrayConversionCode(const cv::Mat &im);
+        void PrepareGrayImage(const cv::Mat &im, cv::Mat &imGray, cv::Mat &imBuffer);
+        void PrepareRGBDImages(const cv::Mat &imRGB, const cv::Mat &imD, cv::Mat &imGray, cv::Mat &imDepth,
+                               cv::Mat &imGrayBuffer, cv::Mat &imDepthBuffer);
+
         bool mbMapUpdated;
 
         // Imu preintegration from last frame
@@ -436,6 +490,10 @@ namespace ORB_SLAM3
         KeyFrame *mpReferenceKF;
         std::vector<KeyFrame *> mvpLocalKeyFrames;
         std::vector<MapPoint *> mvpLocalMapPoints;
+        // Covisibility votes and local points carried over between frames
+        LocalMapCache mLocalMapCache;
+        // Batched projection of the local points in SearchLocalPoints
+        FrustumTest mLocalPointsFrustum;
 
         // System
         System *mpSystem;
@@ -475,6 +533,9 @@ namespace ORB_SLAM3
         // For RGB-D inputs only. For some datasets (e.g. TUM) the depthmap values are scaled.
         float mDepthMapFactor;
 
+        // Preallocated buffers for the converted input images
+        cv::Mat mImGrayBuffer, mImGrayRightBuffer, mImDepthBuffer;
+
         // Current matches in frame
         int mnMatchesInliers;
 
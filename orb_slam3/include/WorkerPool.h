@@ -0,0 +1,85 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ORB_SLAM3
+{
+
+    /**
+     * Process-wide pool of worker threads created once and shared by all the front-end stages.
+     * ParallelFor() may be nested: the calling thread always takes part in its own loop and only
+     * waits for the iterations already started by other threads, so it cannot deadlock.
+     */
+    class WorkerPool
+    {
+    public:
+        static WorkerPool &Instance();
+
+        ~WorkerPool();
+
+        // Runs task(i) for i in [0, n) and returns when all of them finished
+        void ParallelFor(int n, const std::function<void(int)> &task);
+
+        int NumThreads() const
+        {
+            return static_cast<int>(mvThreads.size()) + 1;
+        }
+
+    private:
+        struct Job
+        {
+            Job(int n, const std::function<void(int)> &task) : mnSize(n), mTask(task), mnNext(0), mnPending(n) {}
+
+            // Claims and runs one iteration. Returns false if there was none left
+            bool RunNext();
+
+            const int mnSize;
+            const std::function<void(int)> &mTask;
+            std::atomic<int> mnNext;
+            std::atomic<int> mnPending;
+            std::mutex mMutexDone;
+            std::condition_variable mcvDone;
+        };
+
+        explicit WorkerPool(int nThreads);
+        WorkerPool(const WorkerPool &) = delete;
+        WorkerPool &operator=(const WorkerPool &) = delete;
+
+        void Run();
+
+        std::vector<std::thread> mvThreads;
+        std::deque<std::shared_ptr<Job>> mlJobs;
+        bool mbFinish;
+        std::mutex mMutexJobs;
+        std::condition_variable mcvJobs;
+    };
+
+} // namespace ORB_SLAM3
+
+#endif // WORKERPOOL_H
@@ -240,12 +240,30 @@ namespace ORB_SLAM3
         return mpCurrentMap->GetAllMapPoints();
     }
 
+    std::vector<MapPoint *> Atlas::GetMapPointsInRadius(const Eigen::Vector3f &center, const float radius)
+    {
+        unique_lock<mutex> lock(mMutexAtlas);
+        return mpCurrentMap->GetMapPointsInRadius(center, radius);
+    }
+
+    std::vector<MapPoint *> Atlas::GetMapPointsNearPlane(const Eigen::Vector4d &plane, const float maxDist)
+    {
+        unique_lock<mutex> lock(mMutexAtlas);
+        return mpCurrentMap->GetMapPointsNearPlane(plane, maxDist);
+    }
+
     std::vector<Marker *> Atlas::GetAllMarkers()
     {
         unique_lock<mutex> lock(mMutexAtlas);
         return mpCurrentMap->GetAllMarkers();
     }
 
+    Marker *Atlas::GetMarkerById(int markerId)
+    {
+        unique_lock<mutex> lock(mMutexAtlas);
+        return mpCurrentMap->GetMarkerById(markerId);
+    }
+
     std::vector<Wall *> Atlas::GetAllWalls()
     {
         unique_lock<mutex> lock(mMutexAtlas);
@@ -404,6 +422,10 @@ namespace ORB_SLAM3
         for (GeometricCamera *pCam : mvpCameras)
         {
             mpCams[pCam->GetId()] = pCam;
+
+            // The unprojection table is not serialized
+            if (pCam->GetType() == GeometricCamera::CAM_FISHEYE)
+                static_cast<KannalaBrandt8 *>(pCam)->PrecomputeUnprojection();
         }
 
         mspMaps.clear();
@@ -414,6 +436,11 @@ namespace ORB_SLAM3
             pMi->PostLoad(mpKeyFrameDB, mpORBVocabulary, mpCams);
             numKF += pMi->GetAllKeyFrames().size();
             numMP += pMi->GetAllMapPoints().size();
+
+            // Markers of the loaded walls count as visited for the room detection
+            for (Wall *pWall : pMi->GetAllWalls())
+                for (Marker *wallMarker : pWall->getMarkers())
+                    visitedWallsMarkerIds.push_back(wallMarker->getId());
         }
         mvpBackupMaps.clear();
     }
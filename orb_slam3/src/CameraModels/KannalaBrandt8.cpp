@@ -65,31 +65,14 @@ namespace ORB_SLAM3 {
     }
 
     Eigen::Vector2f KannalaBrandt8::project(const Eigen::Vector3f &v3D) {
-        const float x2_plus_y2 = v3D[0] * v3D[0] + v3D[1] * v3D[1];
-        const float theta = atan2f(sqrtf(x2_plus_y2), v3D[2]);
-        const float psi = atan2f(v3D[1], v3D[0]);
-
-        const float theta2 = theta * theta;
-        const float theta3 = theta * theta2;
-        const float theta5 = theta3 * theta2;
-        const float theta7 = theta5 * theta2;
-        const float theta9 = theta7 * theta2;
-        const float r = theta + mvParameters[4] * theta3 + mvParameters[5] * theta5
-                         + mvParameters[6] * theta7 + mvParameters[7] * theta9;
-
-        Eigen::Vector2f res;
-        res[0] = mvParameters[0] * r * cos(psi) + mvParameters[2];
-        res[1] = mvParameters[1] * r * sin(psi) + mvParameters[3];
-
-        return res;
-
-        /*cv::Point2f cvres = this->project(cv::Point3f(v3D[0],v3D[1],v3D[2]));
-
-        Eigen::Vector2d res;
-        res[0] = cvres.x;
-        res[1] = cvres.y;
+        return GetKernel().project(v3D);
+    }
 
-        return res;*/
+    void KannalaBrandt8::projectPoints(const std::vector<Eigen::Vector3f> &vP3D, std::vector<Eigen::Vector2f> &vP2D) {
+        const Kernel kernel = GetKernel();
+        vP2D.resize(vP3D.size());
+        for(size_t i = 0; i < vP3D.size(); i++)
+            vP2D[i] = kernel.project(vP3D[i]);
     }
 
     Eigen::Vector2f KannalaBrandt8::projectMat(const cv::Point3f &p3D) {
@@ -121,20 +104,20 @@ namespace ORB_SLAM3 {
         theta_d = fminf(fmaxf(-CV_PI / 2.f, theta_d), CV_PI / 2.f);
 
         if (theta_d > 1e-8) {
-            //Compensate distortion iteratively
+            //Start from the tabulated solution if it is up to date, otherwise from theta_d
             float theta = theta_d;
-
-            for (int j = 0; j < 10; j++) {
-                float theta2 = theta * theta, theta4 = theta2 * theta2, theta6 = theta4 * theta2, theta8 =
-                        theta4 * theta4;
-                float k0_theta2 = mvParameters[4] * theta2, k1_theta4 = mvParameters[5] * theta4;
-                float k2_theta6 = mvParameters[6] * theta6, k3_theta8 = mvParameters[7] * theta8;
-                float theta_fix = (theta * (1 + k0_theta2 + k1_theta4 + k2_theta6 + k3_theta8) - theta_d) /
-                                  (1 + 3 * k0_theta2 + 5 * k1_theta4 + 7 * k2_theta6 + 9 * k3_theta8);
-                theta = theta - theta_fix;
-                if (fabsf(theta_fix) < precision)
-                    break;
+            if (!mvThetaLUT.empty() && mvLUTCoefficients[0] == mvParameters[4] && mvLUTCoefficients[1] == mvParameters[5] &&
+                mvLUTCoefficients[2] == mvParameters[6] && mvLUTCoefficients[3] == mvParameters[7]) {
+                const float x = theta_d * mfInvThetaDStep;
+                const size_t i = std::min(static_cast<size_t>(x), mvThetaLUT.size() - 2);
+                const float a = x - i;
+                theta = (1.f - a) * mvThetaLUT[i] + a * mvThetaLUT[i + 1];
+                if (!std::isfinite(theta))
+                    theta = theta_d;
             }
+
+            //Compensate distortion iteratively
+            theta = SolveTheta(theta_d, theta);
             //scale = theta - theta_d;
             scale = std::tan(theta) / theta_d;
         }
@@ -142,6 +125,50 @@ namespace ORB_SLAM3 {
         return cv::Point3f(pw.x * scale, pw.y * scale, 1.f);
     }
 
+    void KannalaBrandt8::unprojectPoints(const std::vector<cv::Point2f> &vP2D, std::vector<Eigen::Vector3f> &vRays) {
+        vRays.resize(vP2D.size());
+        for(size_t i = 0; i < vP2D.size(); i++) {
+            const cv::Point3f ray = KannalaBrandt8::unproject(vP2D[i]);
+            vRays[i] = Eigen::Vector3f(ray.x, ray.y, ray.z);
+        }
+    }
+
+    float KannalaBrandt8::SolveTheta(const float theta_d, float theta) const {
+        for (int j = 0; j < 10; j++) {
+            float theta2 = theta * theta, theta4 = theta2 * theta2, theta6 = theta4 * theta2, theta8 =
+                    theta4 * theta4;
+            float k0_theta2 = mvParameters[4] * theta2, k1_theta4 = mvParameters[5] * theta4;
+            float k2_theta6 = mvParameters[6] * theta6, k3_theta8 = mvParameters[7] * theta8;
+            float theta_fix = (theta * (1 + k0_theta2 + k1_theta4 + k2_theta6 + k3_theta8) - theta_d) /
+                              (1 + 3 * k0_theta2 + 5 * k1_theta4 + 7 * k2_theta6 + 9 * k3_theta8);
+            theta = theta - theta_fix;
+            if (fabsf(theta_fix) < precision)
+                break;
+        }
+        return theta;
+    }
+
+    void KannalaBrandt8::PrecomputeUnprojection() {
+        //theta_d is clamped to pi/2 in unproject. Each entry is solved from the previous one, which is
+        //what the interpolated starting point will be close to. If the Newton iteration diverged for the
+        //previous entry, theta_d itself (the solution without distortion) is used as starting point
+        const int nSteps = 1024;
+        mfThetaDStep = (CV_PI / 2.f) / nSteps;
+        mfInvThetaDStep = 1.f / mfThetaDStep;
+
+        mvThetaLUT.resize(nSteps + 1);
+        mvThetaLUT[0] = 0.f;
+        for (int i = 1; i <= nSteps; i++) {
+            const float theta_d = i * mfThetaDStep;
+            const float prev = mvThetaLUT[i - 1];
+            const bool bPrevValid = std::isfinite(prev) && prev >= 0.f && prev <= CV_PI;
+            mvThetaLUT[i] = SolveTheta(theta_d, bPrevValid ? prev : theta_d);
+        }
+
+        for (int k = 0; k < 4; k++)
+            mvLUTCoefficients[k] = mvParameters[4 + k];
+    }
+
     Eigen::Matrix<double, 2, 3> KannalaBrandt8::projectJac(const Eigen::Vector3d &v3D) {
         double x2 = v3D[0] * v3D[0], y2 = v3D[1] * v3D[1], z2 = v3D[2] * v3D[2];
         double r2 = x2 + y2;
@@ -388,6 +415,7 @@ namespace ORB_SLAM3 {
             kb.mvParameters[i] = nextParam;
 
         }
+        kb.PrecomputeUnprojection();
         return is;
     }
 
@@ -41,11 +41,14 @@ namespace ORB_SLAM3 {
     }
 
     Eigen::Vector2f Pinhole::project(const Eigen::Vector3f &v3D) {
-        Eigen::Vector2f res;
-        res[0] = mvParameters[0] * v3D[0] / v3D[2] + mvParameters[2];
-        res[1] = mvParameters[1] * v3D[1] / v3D[2] + mvParameters[3];
+        return GetKernel().project(v3D);
+    }
 
-        return res;
+    void Pinhole::projectPoints(const std::vector<Eigen::Vector3f> &vP3D, std::vector<Eigen::Vector2f> &vP2D) {
+        const Kernel kernel = GetKernel();
+        vP2D.resize(vP3D.size());
+        for(size_t i = 0; i < vP3D.size(); i++)
+            vP2D[i] = kernel.project(vP3D[i]);
     }
 
     Eigen::Vector2f Pinhole::projectMat(const cv::Point3f &p3D) {
@@ -68,6 +71,13 @@ namespace ORB_SLAM3 {
                            1.f);
     }
 
+    void Pinhole::unprojectPoints(const std::vector<cv::Point2f> &vP2D, std::vector<Eigen::Vector3f> &vRays) {
+        const Kernel kernel = GetKernel();
+        vRays.resize(vP2D.size());
+        for(size_t i = 0; i < vP2D.size(); i++)
+            vRays[i] = kernel.unproject(vP2D[i]);
+    }
+
     Eigen::Matrix<double, 2, 3> Pinhole::projectJac(const Eigen::Vector3d &v3D) {
         Eigen::Matrix<double, 2, 3> Jac;
         Jac(0, 0) = mvParameters[0] / v3D[2];
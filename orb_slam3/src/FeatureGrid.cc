@@ -0,0 +1,76 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FeatureGrid.h"
+
+namespace ORB_SLAM3
+{
+
+    void FeatureGrid::Build(int nCols, int nRows, const std::vector<int> &vCells)
+    {
+        const int nCells = nCols * nRows;
+        mnCols = nCols;
+        mnRows = nRows;
+
+        // Histogram of the cells shifted by one, turned into the start of every cell
+        mvCellStart.assign(nCells + 1, 0);
+        for (const int cell : vCells)
+            if (cell >= 0)
+                mvCellStart[cell + 1]++;
+        for (int c = 0; c < nCells; c++)
+            mvCellStart[c + 1] += mvCellStart[c];
+
+        mvIndices.resize(mvCellStart[nCells]);
+        std::vector<unsigned int> vNext(mvCellStart.begin(), mvCellStart.end() - 1);
+        for (size_t i = 0; i < vCells.size(); i++)
+            if (vCells[i] >= 0)
+                mvIndices[vNext[vCells[i]]++] = static_cast<unsigned int>(i);
+    }
+
+    void FeatureGrid::Assign(const std::vector<std::vector<std::vector<size_t>>> &vvvGrid)
+    {
+        if (vvvGrid.empty() || vvvGrid[0].empty())
+        {
+            clear();
+            return;
+        }
+
+        mnCols = vvvGrid.size();
+        mnRows = vvvGrid[0].size();
+
+        mvCellStart.assign(1, 0);
+        mvCellStart.reserve(mnCols * mnRows + 1);
+        mvIndices.clear();
+        for (int ix = 0; ix < mnCols; ix++)
+            for (int iy = 0; iy < mnRows; iy++)
+            {
+                for (const size_t idx : vvvGrid[ix][iy])
+                    mvIndices.push_back(static_cast<unsigned int>(idx));
+                mvCellStart.push_back(mvIndices.size());
+            }
+    }
+
+    void FeatureGrid::clear()
+    {
+        mnCols = 0;
+        mnRows = 0;
+        mvCellStart.clear();
+        mvIndices.clear();
+    }
+
+} // namespace ORB_SLAM3
@@ -25,15 +25,27 @@
 #include "Converter.h"
 #include "ORBmatcher.h"
 #include "GeometricCamera.h"
+#include "WorkerPool.h"
 
-#include <thread>
 #include <include/CameraModels/Pinhole.h>
 #include <include/CameraModels/KannalaBrandt8.h>
+#include <include/CameraModels/CameraDispatch.h>
+
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define ORB_STEREO_SIMD_X86
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define ORB_STEREO_SIMD_NEON
+#endif
 
 namespace ORB_SLAM3
 {
 
     long unsigned int Frame::nNextId = 0;
+    std::atomic<unsigned long> Frame::nNumCopies(0);
     bool Frame::mbInitialComputations = true;
     float Frame::cx, Frame::cy, Frame::fx, Frame::fy, Frame::invfx, Frame::invfy;
     float Frame::mnMinX, Frame::mnMinY, Frame::mnMaxX, Frame::mnMaxY;
@@ -71,15 +83,11 @@ namespace ORB_SLAM3
           mTlr(frame.mTlr), mRlr(frame.mRlr), mtlr(frame.mtlr), mTrl(frame.mTrl),
           mTcw(frame.mTcw), mbHasPose(false), mbHasVelocity(false)
     {
-        for (int i = 0; i < FRAME_GRID_COLS; i++)
-            for (int j = 0; j < FRAME_GRID_ROWS; j++)
-            {
-                mGrid[i][j] = frame.mGrid[i][j];
-                if (frame.Nleft > 0)
-                {
-                    mGridRight[i][j] = frame.mGridRight[i][j];
-                }
-            }
+        nNumCopies++;
+
+        mGrid = frame.mGrid;
+        if (frame.Nleft > 0)
+            mGridRight = frame.mGridRight;
 
         if (frame.mbHasPose)
             SetPose(frame.GetPose());
@@ -120,10 +128,8 @@ namespace ORB_SLAM3
 #ifdef REGISTER_TIMES
         std::chrono::steady_clock::time_point time_StartExtORB = std::chrono::steady_clock::now();
 #endif
-        thread threadLeft(&Frame::ExtractORB, this, 0, imLeft, 0, 0);
-        thread threadRight(&Frame::ExtractORB, this, 1, imRight, 0, 0);
-        threadLeft.join();
-        threadRight.join();
+        WorkerPool::Instance().ParallelFor(2, [&](int i)
+                                           { ExtractORB(i, i == 0 ? imLeft : imRight, 0, 0); });
 #ifdef REGISTER_TIMES
         std::chrono::steady_clock::time_point time_EndExtORB = std::chrono::steady_clock::now();
 
@@ -388,20 +394,9 @@ namespace ORB_SLAM3
 
     void Frame::AssignFeaturesToGrid()
     {
-        // Fill matrix with points
-        const int nCells = FRAME_GRID_COLS * FRAME_GRID_ROWS;
-
-        int nReserve = 0.5f * N / (nCells);
-
-        for (unsigned int i = 0; i < FRAME_GRID_COLS; i++)
-            for (unsigned int j = 0; j < FRAME_GRID_ROWS; j++)
-            {
-                mGrid[i][j].reserve(nReserve);
-                if (Nleft != -1)
-                {
-                    mGridRight[i][j].reserve(nReserve);
-                }
-            }
+        // Cell of every keypoint, then one counting sort per image
+        vector<int> vCells((Nleft == -1) ? N : Nleft, -1);
+        vector<int> vCellsRight((Nleft == -1) ? 0 : N - Nleft, -1);
 
         for (int i = 0; i < N; i++)
         {
@@ -413,11 +408,15 @@ namespace ORB_SLAM3
             if (PosInGrid(kp, nGridPosX, nGridPosY))
             {
                 if (Nleft == -1 || i < Nleft)
-                    mGrid[nGridPosX][nGridPosY].push_back(i);
+                    vCells[i] = nGridPosX * FRAME_GRID_ROWS + nGridPosY;
                 else
-                    mGridRight[nGridPosX][nGridPosY].push_back(i - Nleft);
+                    vCellsRight[i - Nleft] = nGridPosX * FRAME_GRID_ROWS + nGridPosY;
             }
         }
+
+        mGrid.Build(FRAME_GRID_COLS, FRAME_GRID_ROWS, vCells);
+        if (Nleft != -1)
+            mGridRight.Build(FRAME_GRID_COLS, FRAME_GRID_ROWS, vCellsRight);
     }
 
     void Frame::ExtractORB(int flag, const cv::Mat &im, const int x0, const int x1)
@@ -456,6 +455,13 @@ namespace ORB_SLAM3
         mbHasVelocity = true;
     }
 
+    void Frame::SetPrevFrame(Frame *pPrevF)
+    {
+        mpPrevFrame = pPrevF;
+        if (pPrevF && pPrevF->HasVelocity())
+            SetVelocity(pPrevF->GetVelocity());
+    }
+
     Eigen::Vector3f Frame::GetVelocity() const
     {
         return mVw;
@@ -598,6 +604,74 @@ namespace ORB_SLAM3
         }
     }
 
+    void Frame::isInFrustum(const MapPointGeometry &geometry, float viewingCosLimit, FrustumTest &test)
+    {
+        const size_t N = geometry.size();
+        test.resize(N);
+
+        const float r00 = mRcw(0, 0), r01 = mRcw(0, 1), r02 = mRcw(0, 2);
+        const float r10 = mRcw(1, 0), r11 = mRcw(1, 1), r12 = mRcw(1, 2);
+        const float r20 = mRcw(2, 0), r21 = mRcw(2, 1), r22 = mRcw(2, 2);
+        const float t0 = mtcw(0), t1 = mtcw(1), t2 = mtcw(2);
+        const float ow0 = mOw(0), ow1 = mOw(1), ow2 = mOw(2);
+        const float minX = mnMinX, maxX = mnMaxX, minY = mnMinY, maxY = mnMaxY;
+        const float bf = mbf;
+
+        // ceil(log(ratio)/log(scaleFactor)) clamped to the pyramid is the number of levels
+        // (but the last one) whose scale factor the distance ratio exceeds
+        const int nThresholds = mnScaleLevels - 1;
+        const float *pScaleFactors = mvScaleFactors.data();
+
+        const float *pX = geometry.vX.data(), *pY = geometry.vY.data(), *pZ = geometry.vZ.data();
+        const float *pNx = geometry.vNx.data(), *pNy = geometry.vNy.data(), *pNz = geometry.vNz.data();
+        const float *pMinDist = geometry.vMinDist.data(), *pMaxDist = geometry.vMaxDist.data();
+
+        unsigned char *pbInImage = test.vbInImage.data(), *pbInView = test.vbInView.data();
+        float *pU = test.vU.data(), *pV = test.vV.data(), *pUr = test.vUr.data();
+        float *pDepth = test.vDepth.data(), *pViewCos = test.vViewCos.data();
+        int *pLevel = test.vLevel.data();
+
+        // The loop is instantiated for each camera model, so the projection is inlined
+        DispatchCamera(mpCamera, [&](const auto &camera)
+        {
+            for (size_t i = 0; i < N; i++)
+            {
+                // 3D in camera coordinates
+                const float X = pX[i], Y = pY[i], Z = pZ[i];
+                const float PcX = r00 * X + r01 * Y + r02 * Z + t0;
+                const float PcY = r10 * X + r11 * Y + r12 * Z + t1;
+                const float PcZ = r20 * X + r21 * Y + r22 * Z + t2;
+
+                const Eigen::Vector2f uv = camera.project(Eigen::Vector3f(PcX, PcY, PcZ));
+                const float u = uv(0), v = uv(1);
+
+                // Same rejections as the single point test (NaNs included)
+                const bool bInImage = !(PcZ < 0.0f) & !(u < minX) & !(u > maxX) & !(v < minY) & !(v > maxY);
+
+                // Distance in the scale invariance region and viewing angle
+                const float POx = X - ow0, POy = Y - ow1, POz = Z - ow2;
+                const float dist = sqrtf(POx * POx + POy * POy + POz * POz);
+                const float viewCos = (POx * pNx[i] + POy * pNy[i] + POz * pNz[i]) / dist;
+                const bool bInView = bInImage & !(dist < 0.8f * pMinDist[i]) & !(dist > 1.2f * pMaxDist[i]) & !(viewCos < viewingCosLimit);
+
+                // Predict scale in the image
+                const float ratio = pMaxDist[i] / dist;
+                int nLevel = 0;
+                for (int k = 0; k < nThresholds; k++)
+                    nLevel += ratio > pScaleFactors[k];
+
+                pbInImage[i] = bInImage;
+                pbInView[i] = bInView;
+                pU[i] = u;
+                pV[i] = v;
+                pUr[i] = u - bf * (1.0f / PcZ);
+                pDepth[i] = sqrtf(PcX * PcX + PcY * PcY + PcZ * PcZ);
+                pViewCos[i] = viewCos;
+                pLevel[i] = nLevel;
+            }
+        });
+    }
+
     bool Frame::ProjectPointDistort(MapPoint *pMP, cv::Point2f &kp, float &u, float &v)
     {
 
@@ -700,19 +774,18 @@ namespace ORB_SLAM3
 
         const bool bCheckLevels = (minLevel > 0) || (maxLevel >= 0);
 
+        const FeatureGrid &grid = (!bRight) ? mGrid : mGridRight;
+
         for (int ix = nMinCellX; ix <= nMaxCellX; ix++)
         {
             for (int iy = nMinCellY; iy <= nMaxCellY; iy++)
             {
-                const vector<size_t> vCell = (!bRight) ? mGrid[ix][iy] : mGridRight[ix][iy];
-                if (vCell.empty())
-                    continue;
-
-                for (size_t j = 0, jend = vCell.size(); j < jend; j++)
+                for (const unsigned int *pIdx = grid.CellBegin(ix, iy), *pEnd = grid.CellEnd(ix, iy); pIdx != pEnd; pIdx++)
                 {
-                    const cv::KeyPoint &kpUn = (Nleft == -1) ? mvKeysUn[vCell[j]]
-                                               : (!bRight)   ? mvKeys[vCell[j]]
-                                                             : mvKeysRight[vCell[j]];
+                    const size_t idx = *pIdx;
+                    const cv::KeyPoint &kpUn = (Nleft == -1) ? mvKeysUn[idx]
+                                               : (!bRight)   ? mvKeys[idx]
+                                                             : mvKeysRight[idx];
                     if (bCheckLevels)
                     {
                         if (kpUn.octave < minLevel)
@@ -726,7 +799,7 @@ namespace ORB_SLAM3
                     const float disty = kpUn.pt.y - y;
 
                     if (fabs(distx) < factorX && fabs(disty) < factorY)
-                        vIndices.push_back(vCell[j]);
+                        vIndices.push_back(idx);
                 }
             }
         }
@@ -734,6 +807,74 @@ namespace ORB_SLAM3
         return vIndices;
     }
 
+    // Total capacity of the vectors of a frame. Assignment never shrinks a vector, so it grows exactly
+    // when one of them was reallocated
+    static size_t VectorCapacity(const Frame &F)
+    {
+        return F.mvKeys.capacity() + F.mvKeysRight.capacity() + F.mvKeysUn.capacity() + F.mvpMapPoints.capacity() +
+               F.mvpMapMarkers.capacity() + F.mvuRight.capacity() + F.mvDepth.capacity() + F.mvbOutlier.capacity() +
+               F.mGrid.capacity() + F.mGridRight.capacity() + F.mvScaleFactors.capacity() + F.mvInvScaleFactors.capacity() +
+               F.mvLevelSigma2.capacity() + F.mvInvLevelSigma2.capacity() + F.mvLeftToRightMatch.capacity() +
+               F.mvRightToLeftMatch.capacity() + F.mvStereo3Dpoints.capacity() + F.mNameFile.capacity();
+    }
+
+    // Copies src into the first rows of buffer and makes dst a view of them. The buffer is only reallocated
+    // when it is too small or still referenced by another matrix. Returns true if it was.
+    static bool RecycleDescriptors(const cv::Mat &src, cv::Mat &buffer, cv::Mat &dst)
+    {
+        if (src.empty())
+        {
+            dst = cv::Mat();
+            return false;
+        }
+
+        bool bAllocated = false;
+        if (buffer.rows < src.rows || buffer.cols != src.cols || buffer.type() != src.type() || buffer.u->refcount > 1)
+        {
+            buffer = cv::Mat(src.rows, src.cols, src.type());
+            bAllocated = true;
+        }
+
+        dst = buffer.rowRange(0, src.rows);
+        src.copyTo(dst);
+
+        return bAllocated;
+    }
+
+    bool Frame::Recycle(Frame &frame)
+    {
+        const size_t capacity = VectorCapacity(*this);
+        cv::Mat descriptorsBuffer = mDescriptorsBuffer;
+        cv::Mat descriptorsRightBuffer = mDescriptorsRightBuffer;
+
+        DBoW2::BowVector bowVec;
+        DBoW2::FeatureVector featVec;
+        map<long unsigned int, cv::Point2f> projectPoints, matchedInImage;
+        bowVec.swap(frame.mBowVec);
+        featVec.swap(frame.mFeatVec);
+        projectPoints.swap(frame.mmProjectPoints);
+        matchedInImage.swap(frame.mmMatchedInImage);
+
+        *this = frame;
+
+        bowVec.swap(frame.mBowVec);
+        featVec.swap(frame.mFeatVec);
+        projectPoints.swap(frame.mmProjectPoints);
+        matchedInImage.swap(frame.mmMatchedInImage);
+
+        // Drop the headers copied from frame before checking whether the buffers are shared
+        mDescriptorsBuffer = descriptorsBuffer;
+        mDescriptorsRightBuffer = descriptorsRightBuffer;
+        descriptorsBuffer.release();
+        descriptorsRightBuffer.release();
+
+        bool bAllocated = VectorCapacity(*this) > capacity;
+        bAllocated |= RecycleDescriptors(frame.mDescriptors, mDescriptorsBuffer, mDescriptors);
+        bAllocated |= RecycleDescriptors(frame.mDescriptorsRight, mDescriptorsRightBuffer, mDescriptorsRight);
+
+        return bAllocated;
+    }
+
     bool Frame::PosInGrid(const cv::KeyPoint &kp, int &posX, int &posY)
     {
         posX = round((kp.pt.x - mnMinX) * mfGridElementWidthInv);
@@ -821,6 +962,88 @@ namespace ORB_SLAM3
         }
     }
 
+    namespace
+    {
+        // Half size of the correlation window and of the sliding search range around the ORB match
+        const int kStereoWindow = 5;
+        const int kStereoRange = 5;
+
+        /**
+         * L1 distances between the 11x11 window at pL and the 11 windows shifted by -5..5 pixels in
+         * the right image. pR points to the top-left corner of the leftmost window (21 columns wide).
+         * The sums are exact integers, equal to cv::norm(IL, IR, cv::NORM_L1) for every shift.
+         */
+        void StereoWindowDistances(const uchar *pL, size_t stepL, const uchar *pR, size_t stepR, int *vDists)
+        {
+            const int W = 2 * kStereoWindow + 1;
+            const int S = 2 * kStereoRange + 1;
+
+#if defined(ORB_STEREO_SIMD_X86) || defined(ORB_STEREO_SIMD_NEON)
+            const int stripWidth = W + S - 1;
+
+            // Rows are copied into zero padded buffers so that the 16 byte loads never leave the window
+            alignas(16) uchar rowL[16] = {0};
+            alignas(16) uchar strip[32] = {0};
+            alignas(16) static const uchar windowMask[16] = {255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0, 0};
+#endif
+
+#if defined(ORB_STEREO_SIMD_X86)
+            const __m128i mask = _mm_load_si128((const __m128i *)windowMask);
+            __m128i acc[S];
+            for (int k = 0; k < S; k++)
+                acc[k] = _mm_setzero_si128();
+
+            for (int r = 0; r < W; r++)
+            {
+                memcpy(rowL, pL + r * stepL, W);
+                memcpy(strip, pR + r * stepR, stripWidth);
+                const __m128i l = _mm_load_si128((const __m128i *)rowL);
+                for (int k = 0; k < S; k++)
+                {
+                    const __m128i rv = _mm_and_si128(_mm_loadu_si128((const __m128i *)(strip + k)), mask);
+                    acc[k] = _mm_add_epi64(acc[k], _mm_sad_epu8(l, rv));
+                }
+            }
+
+            for (int k = 0; k < S; k++)
+                vDists[k] = _mm_cvtsi128_si32(acc[k]) + _mm_cvtsi128_si32(_mm_srli_si128(acc[k], 8));
+#elif defined(ORB_STEREO_SIMD_NEON)
+            const uint8x16_t mask = vld1q_u8(windowMask);
+            uint16x8_t acc[S];
+            for (int k = 0; k < S; k++)
+                acc[k] = vdupq_n_u16(0);
+
+            for (int r = 0; r < W; r++)
+            {
+                memcpy(rowL, pL + r * stepL, W);
+                memcpy(strip, pR + r * stepR, stripWidth);
+                const uint8x16_t l = vld1q_u8(rowL);
+                for (int k = 0; k < S; k++)
+                    acc[k] = vpadalq_u8(acc[k], vabdq_u8(l, vandq_u8(vld1q_u8(strip + k), mask)));
+            }
+
+            for (int k = 0; k < S; k++)
+                vDists[k] = vaddlvq_u16(acc[k]);
+#else
+            for (int k = 0; k < S; k++)
+                vDists[k] = 0;
+
+            for (int r = 0; r < W; r++)
+            {
+                const uchar *rowL = pL + r * stepL;
+                const uchar *rowR = pR + r * stepR;
+                for (int k = 0; k < S; k++)
+                {
+                    int sum = 0;
+                    for (int c = 0; c < W; c++)
+                        sum += abs((int)rowL[c] - (int)rowR[k + c]);
+                    vDists[k] += sum;
+                }
+            }
+#endif
+        }
+    } // namespace
+
     void Frame::ComputeStereoMatches()
     {
         mvuRight = vector<float>(N, -1.0f);
@@ -830,24 +1053,33 @@ namespace ORB_SLAM3
 
         const int nRows = mpORBextractorLeft->mvImagePyramid[0].rows;
 
-        // Assign keypoints to row table
-        vector<vector<size_t>> vRowIndices(nRows, vector<size_t>());
-
-        for (int i = 0; i < nRows; i++)
-            vRowIndices[i].reserve(200);
-
+        // Assign keypoints to row table, stored as one flat array indexed by the start of each row
         const int Nr = mvKeysRight.size();
+        vector<unsigned> vRowStart(nRows + 1, 0);
+        vector<int> vMinRow(Nr), vMaxRow(Nr);
 
         for (int iR = 0; iR < Nr; iR++)
         {
             const cv::KeyPoint &kp = mvKeysRight[iR];
             const float &kpY = kp.pt.y;
             const float r = 2.0f * mvScaleFactors[mvKeysRight[iR].octave];
-            const int maxr = ceil(kpY + r);
-            const int minr = floor(kpY - r);
+            vMaxRow[iR] = ceil(kpY + r);
+            vMinRow[iR] = floor(kpY - r);
+
+            for (int yi = vMinRow[iR]; yi <= vMaxRow[iR]; yi++)
+                vRowStart[yi + 1]++;
+        }
+
+        for (int i = 0; i < nRows; i++)
+            vRowStart[i + 1] += vRowStart[i];
 
-            for (int yi = minr; yi <= maxr; yi++)
-                vRowIndices[yi].push_back(iR);
+        // Candidates of each row keep the order of the right keypoints, as ties go to the first one
+        vector<unsigned> vRowIndices(vRowStart[nRows]);
+        {
+            vector<unsigned> vRowFill(vRowStart.begin(), vRowStart.end() - 1);
+            for (int iR = 0; iR < Nr; iR++)
+                for (int yi = vMinRow[iR]; yi <= vMaxRow[iR]; yi++)
+                    vRowIndices[vRowFill[yi]++] = iR;
         }
 
         // Set limits for search
@@ -855,127 +1087,155 @@ namespace ORB_SLAM3
         const float minD = 0;
         const float maxD = mbf / minZ;
 
-        // For each left keypoint search a match in the right image
-        vector<pair<int, int>> vDistIdx;
-        vDistIdx.reserve(N);
-
-        for (int iL = 0; iL < N; iL++)
-        {
-            const cv::KeyPoint &kpL = mvKeys[iL];
-            const int &levelL = kpL.octave;
-            const float &vL = kpL.pt.y;
-            const float &uL = kpL.pt.x;
-
-            const vector<size_t> &vCandidates = vRowIndices[vL];
+        // Correlation distance of each accepted match, -1 otherwise
+        vector<int> vMatchDist(N, -1);
 
-            if (vCandidates.empty())
-                continue;
+        // For each left keypoint search a match in the right image. Blocks of keypoints are
+        // processed in parallel and only write the entries of their own keypoints
+        const int nBlockSize = 64;
+        const int nBlocks = (N + nBlockSize - 1) / nBlockSize;
 
-            const float minU = uL - maxD;
-            const float maxU = uL - minD;
+        WorkerPool::Instance().ParallelFor(nBlocks, [&](int iBlock)
+                                           {
+            vector<size_t> vCandidates;
+            vector<const uchar *> vpCandidateDescs;
+            vector<int> vDists;
+            int vWindowDists[2 * kStereoRange + 1];
 
-            if (maxU < 0)
-                continue;
+            const int iEnd = min(N, (iBlock + 1) * nBlockSize);
+            for (int iL = iBlock * nBlockSize; iL < iEnd; iL++)
+            {
+                const cv::KeyPoint &kpL = mvKeys[iL];
+                const int &levelL = kpL.octave;
+                const float &vL = kpL.pt.y;
+                const float &uL = kpL.pt.x;
 
-            int bestDist = ORBmatcher::TH_HIGH;
-            size_t bestIdxR = 0;
+                const int rowL = vL;
+                const unsigned *pRowBegin = vRowIndices.data() + vRowStart[rowL];
+                const unsigned *pRowEnd = vRowIndices.data() + vRowStart[rowL + 1];
 
-            const cv::Mat &dL = mDescriptors.row(iL);
+                if (pRowBegin == pRowEnd)
+                    continue;
 
-            // Compare descriptor to right keypoints
-            for (size_t iC = 0; iC < vCandidates.size(); iC++)
-            {
-                const size_t iR = vCandidates[iC];
-                const cv::KeyPoint &kpR = mvKeysRight[iR];
+                const float minU = uL - maxD;
+                const float maxU = uL - minD;
 
-                if (kpR.octave < levelL - 1 || kpR.octave > levelL + 1)
+                if (maxU < 0)
                     continue;
 
-                const float &uR = kpR.pt.x;
-
-                if (uR >= minU && uR <= maxU)
+                // Gather the right keypoints in range and compare their descriptors in one batch
+                vCandidates.clear();
+                vpCandidateDescs.clear();
+                for (const unsigned *pR = pRowBegin; pR != pRowEnd; pR++)
                 {
-                    const cv::Mat &dR = mDescriptorsRight.row(iR);
-                    const int dist = ORBmatcher::DescriptorDistance(dL, dR);
+                    const size_t iR = *pR;
+                    const cv::KeyPoint &kpR = mvKeysRight[iR];
 
-                    if (dist < bestDist)
+                    if (kpR.octave < levelL - 1 || kpR.octave > levelL + 1)
+                        continue;
+
+                    const float &uR = kpR.pt.x;
+
+                    if (uR >= minU && uR <= maxU)
                     {
-                        bestDist = dist;
-                        bestIdxR = iR;
+                        vCandidates.push_back(iR);
+                        vpCandidateDescs.push_back(mDescriptorsRight.ptr<uchar>(iR));
                     }
                 }
-            }
 
-            // Subpixel match by correlation
-            if (bestDist < thOrbDist)
-            {
-                // coordinates in image pyramid at keypoint scale
-                const float uR0 = mvKeysRight[bestIdxR].pt.x;
-                const float scaleFactor = mvInvScaleFactors[kpL.octave];
-                const float scaleduL = round(kpL.pt.x * scaleFactor);
-                const float scaledvL = round(kpL.pt.y * scaleFactor);
-                const float scaleduR0 = round(uR0 * scaleFactor);
-
-                // sliding window search
-                const int w = 5;
-                cv::Mat IL = mpORBextractorLeft->mvImagePyramid[kpL.octave].rowRange(scaledvL - w, scaledvL + w + 1).colRange(scaleduL - w, scaleduL + w + 1);
-
-                int bestDist = INT_MAX;
-                int bestincR = 0;
-                const int L = 5;
-                vector<float> vDists;
-                vDists.resize(2 * L + 1);
-
-                const float iniu = scaleduR0 + L - w;
-                const float endu = scaleduR0 + L + w + 1;
-                if (iniu < 0 || endu >= mpORBextractorRight->mvImagePyramid[kpL.octave].cols)
+                if (vCandidates.empty())
                     continue;
 
-                for (int incR = -L; incR <= +L; incR++)
-                {
-                    cv::Mat IR = mpORBextractorRight->mvImagePyramid[kpL.octave].rowRange(scaledvL - w, scaledvL + w + 1).colRange(scaleduR0 + incR - w, scaleduR0 + incR + w + 1);
+                ORBmatcher::DescriptorDistances(mDescriptors.row(iL), vpCandidateDescs, vDists);
 
-                    float dist = cv::norm(IL, IR, cv::NORM_L1);
-                    if (dist < bestDist)
+                int bestDist = ORBmatcher::TH_HIGH;
+                size_t bestIdxR = 0;
+
+                for (size_t iC = 0; iC < vCandidates.size(); iC++)
+                {
+                    if (vDists[iC] < bestDist)
                     {
-                        bestDist = dist;
-                        bestincR = incR;
+                        bestDist = vDists[iC];
+                        bestIdxR = vCandidates[iC];
                     }
-
-                    vDists[L + incR] = dist;
                 }
 
-                if (bestincR == -L || bestincR == L)
-                    continue;
+                // Subpixel match by correlation
+                if (bestDist < thOrbDist)
+                {
+                    // coordinates in image pyramid at keypoint scale
+                    const float uR0 = mvKeysRight[bestIdxR].pt.x;
+                    const float scaleFactor = mvInvScaleFactors[kpL.octave];
+                    const float scaleduL = round(kpL.pt.x * scaleFactor);
+                    const float scaledvL = round(kpL.pt.y * scaleFactor);
+                    const float scaleduR0 = round(uR0 * scaleFactor);
+
+                    // sliding window search
+                    const int w = kStereoWindow;
+                    const int L = kStereoRange;
+                    const cv::Mat &imLeft = mpORBextractorLeft->mvImagePyramid[kpL.octave];
+                    const cv::Mat &imRight = mpORBextractorRight->mvImagePyramid[kpL.octave];
+
+                    const float iniu = scaleduR0 + L - w;
+                    const float endu = scaleduR0 + L + w + 1;
+                    if (iniu < 0 || endu >= imRight.cols)
+                        continue;
+
+                    StereoWindowDistances(imLeft.ptr<uchar>(scaledvL - w) + (int)scaleduL - w, imLeft.step,
+                                          imRight.ptr<uchar>(scaledvL - w) + (int)scaleduR0 - L - w, imRight.step,
+                                          vWindowDists);
+
+                    int bestDist = INT_MAX;
+                    int bestincR = 0;
+                    for (int incR = -L; incR <= +L; incR++)
+                    {
+                        if (vWindowDists[L + incR] < bestDist)
+                        {
+                            bestDist = vWindowDists[L + incR];
+                            bestincR = incR;
+                        }
+                    }
 
-                // Sub-pixel match (Parabola fitting)
-                const float dist1 = vDists[L + bestincR - 1];
-                const float dist2 = vDists[L + bestincR];
-                const float dist3 = vDists[L + bestincR + 1];
+                    if (bestincR == -L || bestincR == L)
+                        continue;
 
-                const float deltaR = (dist1 - dist3) / (2.0f * (dist1 + dist3 - 2.0f * dist2));
+                    // Sub-pixel match (Parabola fitting)
+                    const float dist1 = vWindowDists[L + bestincR - 1];
+                    const float dist2 = vWindowDists[L + bestincR];
+                    const float dist3 = vWindowDists[L + bestincR + 1];
 
-                if (deltaR < -1 || deltaR > 1)
-                    continue;
+                    const float deltaR = (dist1 - dist3) / (2.0f * (dist1 + dist3 - 2.0f * dist2));
 
-                // Re-scaled coordinate
-                float bestuR = mvScaleFactors[kpL.octave] * ((float)scaleduR0 + (float)bestincR + deltaR);
+                    if (deltaR < -1 || deltaR > 1)
+                        continue;
 
-                float disparity = (uL - bestuR);
+                    // Re-scaled coordinate
+                    float bestuR = mvScaleFactors[kpL.octave] * ((float)scaleduR0 + (float)bestincR + deltaR);
 
-                if (disparity >= minD && disparity < maxD)
-                {
-                    if (disparity <= 0)
+                    float disparity = (uL - bestuR);
+
+                    if (disparity >= minD && disparity < maxD)
                     {
-                        disparity = 0.01;
-                        bestuR = uL - 0.01;
+                        if (disparity <= 0)
+                        {
+                            disparity = 0.01;
+                            bestuR = uL - 0.01;
+                        }
+                        mvDepth[iL] = mbf / disparity;
+                        mvuRight[iL] = bestuR;
+                        vMatchDist[iL] = bestDist;
                     }
-                    mvDepth[iL] = mbf / disparity;
-                    mvuRight[iL] = bestuR;
-                    vDistIdx.push_back(pair<int, int>(bestDist, iL));
                 }
-            }
-        }
+            } });
+
+        vector<pair<int, int>> vDistIdx;
+        vDistIdx.reserve(N);
+        for (int iL = 0; iL < N; iL++)
+            if (vMatchDist[iL] >= 0)
+                vDistIdx.push_back(pair<int, int>(vMatchDist[iL], iL));
+
+        if (vDistIdx.empty())
+            return;
 
         sort(vDistIdx.begin(), vDistIdx.end());
         const float median = vDistIdx[vDistIdx.size() / 2].first;
@@ -1070,10 +1330,10 @@ namespace ORB_SLAM3
 #ifdef REGISTER_TIMES
         std::chrono::steady_clock::time_point time_StartExtORB = std::chrono::steady_clock::now();
 #endif
-        thread threadLeft(&Frame::ExtractORB, this, 0, imLeft, static_cast<KannalaBrandt8 *>(mpCamera)->mvLappingArea[0], static_cast<KannalaBrandt8 *>(mpCamera)->mvLappingArea[1]);
-        thread threadRight(&Frame::ExtractORB, this, 1, imRight, static_cast<KannalaBrandt8 *>(mpCamera2)->mvLappingArea[0], static_cast<KannalaBrandt8 *>(mpCamera2)->mvLappingArea[1]);
-        threadLeft.join();
-        threadRight.join();
+        WorkerPool::Instance().ParallelFor(2, [&](int i)
+                                           {
+            KannalaBrandt8 *pCamera = static_cast<KannalaBrandt8 *>(i == 0 ? mpCamera : mpCamera2);
+            ExtractORB(i, i == 0 ? imLeft : imRight, pCamera->mvLappingArea[0], pCamera->mvLappingArea[1]); });
 #ifdef REGISTER_TIMES
         std::chrono::steady_clock::time_point time_EndExtORB = std::chrono::steady_clock::now();
 
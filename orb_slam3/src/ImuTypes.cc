@@ -115,7 +115,8 @@ Preintegrated::Preintegrated(const Bias &b_, const Calib &calib)
 Preintegrated::Preintegrated(Preintegrated* pImuPre): dT(pImuPre->dT),C(pImuPre->C), Info(pImuPre->Info),
      Nga(pImuPre->Nga), NgaWalk(pImuPre->NgaWalk), b(pImuPre->b), dR(pImuPre->dR), dV(pImuPre->dV),
     dP(pImuPre->dP), JRg(pImuPre->JRg), JVg(pImuPre->JVg), JVa(pImuPre->JVa), JPg(pImuPre->JPg), JPa(pImuPre->JPa),
-    avgA(pImuPre->avgA), avgW(pImuPre->avgW), bu(pImuPre->bu), db(pImuPre->db), mvMeasurements(pImuPre->mvMeasurements)
+    avgA(pImuPre->avgA), avgW(pImuPre->avgW), bu(pImuPre->bu), db(pImuPre->db), dbgFirstOrder(pImuPre->dbgFirstOrder),
+    mvMeasurements(pImuPre->mvMeasurements)
 {
 
 }
@@ -140,6 +141,7 @@ void Preintegrated::CopyFrom(Preintegrated* pImuPre)
     avgW = pImuPre->avgW;
     bu.CopyFrom(pImuPre->bu);
     db = pImuPre->db;
+    dbgFirstOrder = pImuPre->dbgFirstOrder;
     mvMeasurements = pImuPre->mvMeasurements;
 }
 
@@ -157,6 +159,7 @@ void Preintegrated::Initialize(const Bias &b_)
     C.setZero();
     Info.setZero();
     db.setZero();
+    dbgFirstOrder.setZero();
     b=b_;
     bu=b_;
     avgA.setZero();
@@ -168,67 +171,110 @@ void Preintegrated::Initialize(const Bias &b_)
 void Preintegrated::Reintegrate()
 {
     std::unique_lock<std::mutex> lock(mMutex);
-    const std::vector<integrable> aux = mvMeasurements;
+
+    // The deltas are linear in the accelerometer bias, so only the gyro bias change limits the
+    // first order update. It is accumulated, as the Jacobians stay at the last integration
+    const Eigen::Vector3f dbg = db.head(3);
+    const Eigen::Vector3f dba = db.tail(3);
+    if((JRg * (dbgFirstOrder + dbg)).norm() < MAX_FIRST_ORDER_ROTATION)
+    {
+        dR = NormalizeRotation(dR * Sophus::SO3f::exp(JRg * dbg).matrix());
+        dV = dV + JVg * dbg + JVa * dba;
+        dP = dP + JPg * dbg + JPa * dba;
+        avgW = avgW - dbg;
+        if(dT > 0.0f)
+            avgA = dV / dT;
+
+        b = bu;
+        db.setZero();
+        dbgFirstOrder += dbg;
+        return;
+    }
+
+    std::vector<integrable> vMeasurements;
+    vMeasurements.swap(mvMeasurements);
     Initialize(bu);
-    for(size_t i=0;i<aux.size();i++)
-        IntegrateNewMeasurement(aux[i].a,aux[i].w,aux[i].t);
+    mvMeasurements.swap(vMeasurements);
+    for(size_t i=0;i<mvMeasurements.size();i++)
+        Integrate(mvMeasurements[i].a,mvMeasurements[i].w,mvMeasurements[i].t);
 }
 
 void Preintegrated::IntegrateNewMeasurement(const Eigen::Vector3f &acceleration, const Eigen::Vector3f &angVel, const float &dt)
 {
     mvMeasurements.push_back(integrable(acceleration,angVel,dt));
+    Integrate(acceleration,angVel,dt);
+}
 
+void Preintegrated::Integrate(const Eigen::Vector3f &acceleration, const Eigen::Vector3f &angVel, const float &dt)
+{
     // Position is updated firstly, as it depends on previously computed velocity and rotation.
     // Velocity is updated secondly, as it depends on previously computed rotation.
     // Rotation is the last to be updated.
 
-    //Matrices to compute covariance
-    Eigen::Matrix<float,9,9> A;
-    A.setIdentity();
-    Eigen::Matrix<float,9,6> B;
-    B.setZero();
-
+    // The covariance is propagated with the 3x3 blocks of A = [Ar 0 0; Avr I 0; Apr dt*I I] and
+    // B = [Br 0; 0 Bv; 0 Bp], skipping the products by zero and identity blocks
     Eigen::Vector3f acc, accW;
     acc << acceleration(0)-b.bax, acceleration(1)-b.bay, acceleration(2)-b.baz;
     accW << angVel(0)-b.bwx, angVel(1)-b.bwy, angVel(2)-b.bwz;
 
-    avgA = (dT*avgA + dR*acc*dt)/(dT+dt);
+    const Eigen::Vector3f dRacc = dR*acc;
+    avgA = (dT*avgA + dRacc*dt)/(dT+dt);
     avgW = (dT*avgW + accW*dt)/(dT+dt);
 
     // Update delta position dP and velocity dV (rely on no-updated delta rotation)
-    dP = dP + dV*dt + 0.5f*dR*acc*dt*dt;
-    dV = dV + dR*acc*dt;
+    dP = dP + dV*dt + 0.5f*dRacc*dt*dt;
+    dV = dV + dRacc*dt;
 
     // Compute velocity and position parts of matrices A and B (rely on non-updated delta rotation)
-    Eigen::Matrix<float,3,3> Wacc = Sophus::SO3f::hat(acc);
-
-    A.block<3,3>(3,0) = -dR*dt*Wacc;
-    A.block<3,3>(6,0) = -0.5f*dR*dt*dt*Wacc;
-    A.block<3,3>(6,3) = Eigen::DiagonalMatrix<float,3>(dt, dt, dt);
-    B.block<3,3>(3,3) = dR*dt;
-    B.block<3,3>(6,3) = 0.5f*dR*dt*dt;
-
+    const Eigen::Matrix3f Wacc = Sophus::SO3f::hat(acc);
+    const Eigen::Matrix3f Avr = -dR*dt*Wacc;
+    const Eigen::Matrix3f Apr = 0.5f*dt*Avr;
+    const Eigen::Matrix3f Bv = dR*dt;
 
     // Update position and velocity jacobians wrt bias correction
-    JPa = JPa + JVa*dt -0.5f*dR*dt*dt;
-    JPg = JPg + JVg*dt -0.5f*dR*dt*dt*Wacc*JRg;
-    JVa = JVa - dR*dt;
-    JVg = JVg - dR*dt*Wacc*JRg;
+    const Eigen::Matrix3f AvrJRg = Avr*JRg;
+    JPa = JPa + JVa*dt -0.5f*dt*Bv;
+    JPg = JPg + JVg*dt + 0.5f*dt*AvrJRg;
+    JVa = JVa - Bv;
+    JVg = JVg + AvrJRg;
 
     // Update delta rotation
     IntegratedRotation dRi(angVel,b,dt);
     dR = NormalizeRotation(dR*dRi.deltaR);
 
     // Compute rotation parts of matrices A and B
-    A.block<3,3>(0,0) = dRi.deltaR.transpose();
-    B.block<3,3>(0,0) = dRi.rightJ*dt;
-
-    // Update covariance
-    C.block<9,9>(0,0) = A * C.block<9,9>(0,0) * A.transpose() + B*Nga*B.transpose();
+    const Eigen::Matrix3f Ar = dRi.deltaR.transpose();
+    const Eigen::Matrix3f Br = dRi.rightJ*dt;
+
+    // Update covariance. T = A*C by block rows, then C = T*A' + B*Nga*B'
+    const Eigen::Matrix<float,3,9> CR = C.block<3,9>(0,0);
+    const Eigen::Matrix<float,3,9> CV = C.block<3,9>(3,0);
+    const Eigen::Matrix<float,3,9> CP = C.block<3,9>(6,0);
+
+    Eigen::Matrix<float,9,9> T;
+    T.block<3,9>(0,0) = Ar*CR;
+    const Eigen::Matrix<float,3,9> AvrCR = Avr*CR;
+    T.block<3,9>(3,0) = AvrCR + CV;
+    T.block<3,9>(6,0) = 0.5f*dt*AvrCR + dt*CV + CP;
+
+    const Eigen::Matrix<float,9,3> TR = T.block<9,3>(0,0);
+    const Eigen::Matrix<float,9,3> TRAvr = TR*Avr.transpose();
+    C.block<9,3>(0,0) = TR*Ar.transpose();
+    C.block<9,3>(0,3) = TRAvr + T.block<9,3>(0,3);
+    C.block<9,3>(0,6) = 0.5f*dt*TRAvr + dt*T.block<9,3>(0,3) + T.block<9,3>(0,6);
+
+    const Eigen::DiagonalMatrix<float,3> Ng(Nga.diagonal().head<3>());
+    const Eigen::DiagonalMatrix<float,3> Na(Nga.diagonal().tail<3>());
+    const Eigen::Matrix3f BvNaBv = Bv*Na*Bv.transpose();
+    C.block<3,3>(0,0) += Br*Ng*Br.transpose();
+    C.block<3,3>(3,3) += BvNaBv;
+    C.block<3,3>(3,6) += 0.5f*dt*BvNaBv;
+    C.block<3,3>(6,3) += 0.5f*dt*BvNaBv;
+    C.block<3,3>(6,6) += 0.25f*dt*dt*BvNaBv;
     C.block<6,6>(9,9) += NgaWalk;
 
     // Update rotation jacobian wrt bias correction
-    JRg = dRi.deltaR.transpose()*JRg - dRi.rightJ*dt;
+    JRg = Ar*JRg - Br;
 
     // Total integrated time
     dT += dt;
@@ -249,14 +295,15 @@ void Preintegrated::MergePrevious(Preintegrated* pPrev)
     bav.bay = bu.bay;
     bav.baz = bu.baz;
 
-    const std::vector<integrable > aux1 = pPrev->mvMeasurements;
-    const std::vector<integrable> aux2 = mvMeasurements;
+    std::vector<integrable> vMeasurements;
+    vMeasurements.reserve(pPrev->mvMeasurements.size() + mvMeasurements.size());
+    vMeasurements.insert(vMeasurements.end(), pPrev->mvMeasurements.begin(), pPrev->mvMeasurements.end());
+    vMeasurements.insert(vMeasurements.end(), mvMeasurements.begin(), mvMeasurements.end());
 
     Initialize(bav);
-    for(size_t i=0;i<aux1.size();i++)
-        IntegrateNewMeasurement(aux1[i].a,aux1[i].w,aux1[i].t);
-    for(size_t i=0;i<aux2.size();i++)
-        IntegrateNewMeasurement(aux2[i].a,aux2[i].w,aux2[i].t);
+    mvMeasurements.swap(vMeasurements);
+    for(size_t i=0;i<mvMeasurements.size();i++)
+        Integrate(mvMeasurements[i].a,mvMeasurements[i].w,mvMeasurements[i].t);
 
 }
 
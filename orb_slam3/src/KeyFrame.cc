@@ -60,23 +60,9 @@ namespace ORB_SLAM3
     {
         mnId = nNextId++;
 
-        mGrid.resize(mnGridCols);
+        mGrid = F.mGrid;
         if (F.Nleft != -1)
-            mGridRight.resize(mnGridCols);
-        for (int i = 0; i < mnGridCols; i++)
-        {
-            mGrid[i].resize(mnGridRows);
-            if (F.Nleft != -1)
-                mGridRight[i].resize(mnGridRows);
-            for (int j = 0; j < mnGridRows; j++)
-            {
-                mGrid[i][j] = F.mGrid[i][j];
-                if (F.Nleft != -1)
-                {
-                    mGridRight[i][j] = F.mGridRight[i][j];
-                }
-            }
-        }
+            mGridRight = F.mGridRight;
 
         if (!F.HasVelocity())
         {
@@ -302,6 +288,7 @@ namespace ORB_SLAM3
     {
         unique_lock<mutex> lock(mMutexFeatures);
         mvpMapPoints[idx] = pMP;
+        mnMapPointsVersion++;
     }
 
     void KeyFrame::AddMapMarker(Marker *marker)
@@ -326,6 +313,7 @@ namespace ORB_SLAM3
     {
         unique_lock<mutex> lock(mMutexFeatures);
         mvpMapPoints[idx] = static_cast<MapPoint *>(NULL);
+        mnMapPointsVersion++;
     }
 
     void KeyFrame::EraseMapPointMatch(MapPoint *pMP)
@@ -336,11 +324,13 @@ namespace ORB_SLAM3
             mvpMapPoints[leftIndex] = static_cast<MapPoint *>(NULL);
         if (rightIndex != -1)
             mvpMapPoints[rightIndex] = static_cast<MapPoint *>(NULL);
+        mnMapPointsVersion++;
     }
 
     void KeyFrame::ReplaceMapPointMatch(const int &idx, MapPoint *pMP)
     {
         mvpMapPoints[idx] = pMP;
+        mnMapPointsVersion++;
     }
 
     set<MapPoint *> KeyFrame::GetMapPoints()
@@ -760,21 +750,23 @@ namespace ORB_SLAM3
         if (nMaxCellY < 0)
             return vIndices;
 
+        const FeatureGrid &grid = (!bRight) ? mGrid : mGridRight;
+
         for (int ix = nMinCellX; ix <= nMaxCellX; ix++)
         {
             for (int iy = nMinCellY; iy <= nMaxCellY; iy++)
             {
-                const vector<size_t> vCell = (!bRight) ? mGrid[ix][iy] : mGridRight[ix][iy];
-                for (size_t j = 0, jend = vCell.size(); j < jend; j++)
+                for (const unsigned int *pIdx = grid.CellBegin(ix, iy), *pEnd = grid.CellEnd(ix, iy); pIdx != pEnd; pIdx++)
                 {
-                    const cv::KeyPoint &kpUn = (NLeft == -1) ? mvKeysUn[vCell[j]]
-                                               : (!bRight)   ? mvKeys[vCell[j]]
-                                                             : mvKeysRight[vCell[j]];
+                    const size_t idx = *pIdx;
+                    const cv::KeyPoint &kpUn = (NLeft == -1) ? mvKeysUn[idx]
+                                               : (!bRight)   ? mvKeys[idx]
+                                                             : mvKeysRight[idx];
                     const float distx = kpUn.pt.x - x;
                     const float disty = kpUn.pt.y - y;
 
                     if (fabs(distx) < r && fabs(disty) < r)
-                        vIndices.push_back(vCell[j]);
+                        vIndices.push_back(idx);
                 }
             }
         }
@@ -975,6 +967,7 @@ namespace ORB_SLAM3
             else
                 mvpMapPoints[i] = static_cast<MapPoint *>(NULL);
         }
+        mnMapPointsVersion++;
 
         // Conected KeyFrames with him weight
         mConnectedKeyFrameWeights.clear();
@@ -0,0 +1,269 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LocalMapCache.h"
+
+#include "KeyFrame.h"
+#include "MapPoint.h"
+
+namespace ORB_SLAM3
+{
+
+    LocalMapCache::LocalMapCache() : mnVotesPass(0), mnPointsPass(0), mbPointsValid(false), mnGeneration(0),
+                                     mnGeometryGeneration(0), mbGeometryValid(false)
+    {
+    }
+
+    void LocalMapCache::Clear()
+    {
+        mvTrackedPoints.clear();
+        mmKeyFrameVotes.clear();
+        mvLocalKeyFrames.clear();
+        mvpLastLocalKFs.clear();
+        mbPointsValid = false;
+        mbGeometryValid = false;
+        mnGeneration++;
+    }
+
+    void LocalMapCache::ReadObservations(TrackedPoint &tp)
+    {
+        // The version is read first, so a change during the copy is caught in the next pass
+        tp.nVersion = tp.pMP->GetObservationsVersion();
+        const map<KeyFrame *, tuple<int, int>> observations = tp.pMP->GetObservations();
+
+        tp.vpKFs.clear();
+        tp.vpKFs.reserve(observations.size());
+        for (map<KeyFrame *, tuple<int, int>>::const_iterator it = observations.begin(), itend = observations.end(); it != itend; it++)
+            tp.vpKFs.push_back(it->first);
+    }
+
+    void LocalMapCache::AddVotes(const TrackedPoint &tp, const int n)
+    {
+        if (n == 0)
+            return;
+
+        for (KeyFrame *pKF : tp.vpKFs)
+        {
+            map<KeyFrame *, int>::iterator it = mmKeyFrameVotes.insert(make_pair(pKF, 0)).first;
+            it->second += n;
+            if (it->second == 0)
+                mmKeyFrameVotes.erase(it);
+        }
+    }
+
+    const map<KeyFrame *, int> &LocalMapCache::UpdateKeyFrameVotes(vector<MapPoint *> &vpTrackedMPs)
+    {
+        mnVotesPass++;
+
+        for (vector<MapPoint *>::iterator vit = vpTrackedMPs.begin(), vend = vpTrackedMPs.end(); vit != vend; vit++)
+        {
+            MapPoint *pMP = *vit;
+            if (!pMP)
+                continue;
+
+            if (pMP->isBad())
+            {
+                *vit = static_cast<MapPoint *>(NULL);
+                continue;
+            }
+
+            int slot = pMP->mnTrackVotesSlot;
+            if (slot < 0 || slot >= static_cast<int>(mvTrackedPoints.size()) ||
+                mvTrackedPoints[slot].pMP != pMP || mvTrackedPoints[slot].nId != pMP->mnId)
+            {
+                slot = mvTrackedPoints.size();
+                pMP->mnTrackVotesSlot = slot;
+
+                mvTrackedPoints.push_back(TrackedPoint());
+                TrackedPoint &tp = mvTrackedPoints.back();
+                tp.pMP = pMP;
+                tp.nId = pMP->mnId;
+                tp.nPass = mnVotesPass;
+                tp.nCount = 0;
+                tp.nVotes = 0;
+                ReadObservations(tp);
+            }
+
+            TrackedPoint &tp = mvTrackedPoints[slot];
+            if (tp.nPass != mnVotesPass)
+            {
+                tp.nPass = mnVotesPass;
+                tp.nCount = 0;
+
+                if (pMP->GetObservationsVersion() != tp.nVersion)
+                {
+                    AddVotes(tp, -tp.nVotes);
+                    tp.nVotes = 0;
+                    ReadObservations(tp);
+                }
+            }
+            tp.nCount++;
+        }
+
+        // Withdraw the points no longer tracked, apply the new ones and compact
+        size_t n = 0;
+        for (size_t i = 0, iend = mvTrackedPoints.size(); i < iend; i++)
+        {
+            TrackedPoint &tp = mvTrackedPoints[i];
+            if (tp.nPass != mnVotesPass)
+            {
+                AddVotes(tp, -tp.nVotes);
+                continue;
+            }
+
+            if (tp.nCount != tp.nVotes)
+            {
+                AddVotes(tp, tp.nCount - tp.nVotes);
+                tp.nVotes = tp.nCount;
+            }
+
+            // Points of this pass are in the frame, so they are alive
+            if (n != i)
+            {
+                mvTrackedPoints[n] = std::move(tp);
+                mvTrackedPoints[n].pMP->mnTrackVotesSlot = n;
+            }
+            n++;
+        }
+        mvTrackedPoints.resize(n);
+
+        return mmKeyFrameVotes;
+    }
+
+    void LocalMapCache::UpdateLocalPoints(const vector<KeyFrame *> &vpLocalKFs, const long unsigned int nFrameId,
+                                          vector<MapPoint *> &vpLocalMPs)
+    {
+        mnPointsPass++;
+
+        bool bChanged = !mbPointsValid || vpLocalKFs != mvpLastLocalKFs;
+
+        for (KeyFrame *pKF : vpLocalKFs)
+        {
+            int slot = pKF->mnTrackPointsSlot;
+            if (slot < 0 || slot >= static_cast<int>(mvLocalKeyFrames.size()) ||
+                mvLocalKeyFrames[slot].pKF != pKF || mvLocalKeyFrames[slot].nId != pKF->mnId)
+            {
+                slot = mvLocalKeyFrames.size();
+                pKF->mnTrackPointsSlot = slot;
+
+                mvLocalKeyFrames.push_back(LocalKeyFrame());
+                LocalKeyFrame &lk = mvLocalKeyFrames.back();
+                lk.pKF = pKF;
+                lk.nId = pKF->mnId;
+                lk.nVersion = pKF->GetMapPointsVersion();
+                lk.vpMPs = pKF->GetMapPointMatches();
+                bChanged = true;
+            }
+
+            LocalKeyFrame &lk = mvLocalKeyFrames[slot];
+            lk.nPass = mnPointsPass;
+
+            const long unsigned int nVersion = pKF->GetMapPointsVersion();
+            if (nVersion != lk.nVersion)
+            {
+                lk.nVersion = nVersion;
+                lk.vpMPs = pKF->GetMapPointMatches();
+                bChanged = true;
+            }
+        }
+
+        size_t n = 0;
+        for (size_t i = 0, iend = mvLocalKeyFrames.size(); i < iend; i++)
+        {
+            if (mvLocalKeyFrames[i].nPass != mnPointsPass)
+                continue;
+
+            if (n != i)
+            {
+                mvLocalKeyFrames[n] = std::move(mvLocalKeyFrames[i]);
+                mvLocalKeyFrames[n].pKF->mnTrackPointsSlot = n;
+            }
+            n++;
+        }
+        mvLocalKeyFrames.resize(n);
+
+        // Same keyframes with the same matches: the list is still valid (bad points are skipped by the search)
+        if (!bChanged)
+            return;
+
+        vpLocalMPs.clear();
+
+        for (vector<KeyFrame *>::const_reverse_iterator itKF = vpLocalKFs.rbegin(), itEndKF = vpLocalKFs.rend(); itKF != itEndKF; ++itKF)
+        {
+            const vector<MapPoint *> &vpMPs = mvLocalKeyFrames[(*itKF)->mnTrackPointsSlot].vpMPs;
+
+            for (vector<MapPoint *>::const_iterator itMP = vpMPs.begin(), itEndMP = vpMPs.end(); itMP != itEndMP; itMP++)
+            {
+                MapPoint *pMP = *itMP;
+                if (!pMP)
+                    continue;
+                if (pMP->mnTrackReferenceForFrame == nFrameId)
+                    continue;
+                if (!pMP->isBad())
+                {
+                    vpLocalMPs.push_back(pMP);
+                    pMP->mnTrackReferenceForFrame = nFrameId;
+                }
+            }
+        }
+
+        mvpLastLocalKFs = vpLocalKFs;
+        mbPointsValid = true;
+        mnGeneration++;
+    }
+
+    const MapPointGeometry &LocalMapCache::UpdateGeometry(const vector<MapPoint *> &vpLocalMPs)
+    {
+        const size_t N = vpLocalMPs.size();
+
+        // A rebuilt list has other points at each index
+        if (!mbGeometryValid || mnGeometryGeneration != mnGeneration || mGeometry.size() != N)
+        {
+            mGeometry.resize(N);
+            mvGeometryVersions.assign(N, static_cast<long unsigned int>(-1));
+            mnGeometryGeneration = mnGeneration;
+            mbGeometryValid = true;
+        }
+
+        Eigen::Vector3f Pos, Normal;
+        float minDistance, maxDistance;
+        for (size_t i = 0; i < N; i++)
+        {
+            MapPoint *pMP = vpLocalMPs[i];
+
+            // The version is read first, so a change during the copy is caught in the next call
+            const long unsigned int nVersion = pMP->GetGeometryVersion();
+            if (nVersion == mvGeometryVersions[i])
+                continue;
+
+            pMP->GetViewGeometry(Pos, Normal, minDistance, maxDistance);
+            mGeometry.vX[i] = Pos(0);
+            mGeometry.vY[i] = Pos(1);
+            mGeometry.vZ[i] = Pos(2);
+            mGeometry.vNx[i] = Normal(0);
+            mGeometry.vNy[i] = Normal(1);
+            mGeometry.vNz[i] = Normal(2);
+            mGeometry.vMinDist[i] = minDistance;
+            mGeometry.vMaxDist[i] = maxDistance;
+            mvGeometryVersions[i] = nVersion;
+        }
+
+        return mGeometry;
+    }
+
+} // namespace ORB_SLAM3
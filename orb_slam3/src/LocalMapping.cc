@@ -22,6 +22,7 @@
 #include "Optimizer.h"
 #include "Converter.h"
 #include "GeometricTools.h"
+#include "WorkerPool.h"
 
 #include <mutex>
 #include <chrono>
@@ -153,6 +154,10 @@ namespace ORB_SLAM3
                             b_doneLBA = true;
                         }
                     }
+
+                    // Re-index the points moved by the local BA in one batch
+                    if (b_doneLBA)
+                        mpCurrentKeyFrame->GetMap()->IndexMovedMapPoints();
 #ifdef REGISTER_TIMES
                     std::chrono::steady_clock::time_point time_EndLBA = std::chrono::steady_clock::now();
 
@@ -413,34 +418,46 @@ namespace ORB_SLAM3
 
         float th = 0.6f;
 
-        ORBmatcher matcher(th, false);
-
-        Sophus::SE3<float> sophTcw1 = mpCurrentKeyFrame->GetPose();
-        Eigen::Matrix<float, 3, 4> eigTcw1 = sophTcw1.matrix3x4();
-        Eigen::Matrix<float, 3, 3> Rcw1 = eigTcw1.block<3, 3>(0, 0);
-        Eigen::Matrix<float, 3, 3> Rwc1 = Rcw1.transpose();
-        Eigen::Vector3f tcw1 = sophTcw1.translation();
-        Eigen::Vector3f Ow1 = mpCurrentKeyFrame->GetCameraCenter();
-
         const float &fx1 = mpCurrentKeyFrame->fx;
         const float &fy1 = mpCurrentKeyFrame->fy;
         const float &cx1 = mpCurrentKeyFrame->cx;
         const float &cy1 = mpCurrentKeyFrame->cy;
-        const float &invfx1 = mpCurrentKeyFrame->invfx;
-        const float &invfy1 = mpCurrentKeyFrame->invfy;
 
         const float ratioFactor = 1.5f * mpCurrentKeyFrame->mfScaleFactor;
-        int countStereo = 0;
-        int countStereoGoodProj = 0;
-        int countStereoAttempt = 0;
-        int totalStereoPts = 0;
-        // Search matches with epipolar restriction and triangulate
-        for (size_t i = 0; i < vpNeighKFs.size(); i++)
+        const bool bCoarse = mbInertial && mpTracker->mState == Tracking::RECENTLY_LOST && mpCurrentKeyFrame->GetMap()->GetIniertialBA2();
+
+        // Points triangulated with each neighbor. The neighbors only share the current keyframe, whose
+        // map points are not modified until all of them are done, so the matching and triangulation
+        // run in parallel and the points are inserted afterwards in the neighbor order
+        struct NewPoint
         {
+            size_t idx1, idx2;
+            Eigen::Vector3f x3D;
+        };
+        const int nNeighs = vpNeighKFs.size();
+        vector<vector<NewPoint>> vvNewPoints(nNeighs);
+        vector<char> vbAborted(nNeighs, false);
+
+        // Search matches with epipolar restriction and triangulate
+        WorkerPool::Instance().ParallelFor(nNeighs, [&](int i)
+                                           {
             if (i > 0 && CheckNewKeyFrames())
+            {
+                vbAborted[i] = true;
                 return;
+            }
 
             KeyFrame *pKF2 = vpNeighKFs[i];
+            vector<NewPoint> &vNewPoints = vvNewPoints[i];
+
+            ORBmatcher matcher(th, false);
+
+            Sophus::SE3<float> sophTcw1 = mpCurrentKeyFrame->GetPose();
+            Eigen::Matrix<float, 3, 4> eigTcw1 = sophTcw1.matrix3x4();
+            Eigen::Matrix<float, 3, 3> Rcw1 = eigTcw1.block<3, 3>(0, 0);
+            Eigen::Matrix<float, 3, 3> Rwc1 = Rcw1.transpose();
+            Eigen::Vector3f tcw1 = sophTcw1.translation();
+            Eigen::Vector3f Ow1 = mpCurrentKeyFrame->GetCameraCenter();
 
             GeometricCamera *pCamera1 = mpCurrentKeyFrame->mpCamera, *pCamera2 = pKF2->mpCamera;
 
@@ -452,7 +469,7 @@ namespace ORB_SLAM3
             if (!mbMonocular)
             {
                 if (baseline < pKF2->mb)
-                    continue;
+                    return;
             }
             else
             {
@@ -460,13 +477,11 @@ namespace ORB_SLAM3
                 const float ratioBaselineDepth = baseline / medianDepthKF2;
 
                 if (ratioBaselineDepth < 0.01)
-                    continue;
+                    return;
             }
 
             // Search matches that fullfil epipolar constraint
             vector<pair<size_t, size_t>> vMatchedIndices;
-            bool bCoarse = mbInertial && mpTracker->mState == Tracking::RECENTLY_LOST && mpCurrentKeyFrame->GetMap()->GetIniertialBA2();
-
             matcher.SearchForTriangulation(mpCurrentKeyFrame, pKF2, vMatchedIndices, false, bCoarse);
 
             Sophus::SE3<float> sophTcw2 = pKF2->GetPose();
@@ -479,11 +494,10 @@ namespace ORB_SLAM3
             const float &fy2 = pKF2->fy;
             const float &cx2 = pKF2->cx;
             const float &cy2 = pKF2->cy;
-            const float &invfx2 = pKF2->invfx;
-            const float &invfy2 = pKF2->invfy;
 
             // Triangulate each match
             const int nmatches = vMatchedIndices.size();
+            vNewPoints.reserve(nmatches);
             for (int ikp = 0; ikp < nmatches; ikp++)
             {
                 const int &idx1 = vMatchedIndices[ikp].first;
@@ -580,15 +594,11 @@ namespace ORB_SLAM3
                 else if (bStereo2)
                     cosParallaxStereo2 = cos(2 * atan2(pKF2->mb / 2, pKF2->mvDepth[idx2]));
 
-                if (bStereo1 || bStereo2)
-                    totalStereoPts++;
-
                 cosParallaxStereo = min(cosParallaxStereo1, cosParallaxStereo2);
 
                 Eigen::Vector3f x3D;
 
                 bool goodProj = false;
-                bool bPointStereo = false;
                 if (cosParallaxRays < cosParallaxStereo && cosParallaxRays > 0 && (bStereo1 || bStereo2 || (cosParallaxRays < 0.9996 && mbInertial) || (cosParallaxRays < 0.9998 && !mbInertial)))
                 {
                     goodProj = GeometricTools::Triangulate(xn1, xn2, eigTcw1, eigTcw2, x3D);
@@ -597,14 +607,10 @@ namespace ORB_SLAM3
                 }
                 else if (bStereo1 && cosParallaxStereo1 < cosParallaxStereo2)
                 {
-                    countStereoAttempt++;
-                    bPointStereo = true;
                     goodProj = mpCurrentKeyFrame->UnprojectStereo(idx1, x3D);
                 }
                 else if (bStereo2 && cosParallaxStereo2 < cosParallaxStereo1)
                 {
-                    countStereoAttempt++;
-                    bPointStereo = true;
                     goodProj = pKF2->UnprojectStereo(idx2, x3D);
                 }
                 else
@@ -612,9 +618,6 @@ namespace ORB_SLAM3
                     continue; // No stereo and very low parallax
                 }
 
-                if (goodProj && bPointStereo)
-                    countStereoGoodProj++;
-
                 if (!goodProj)
                     continue;
 
@@ -699,15 +702,35 @@ namespace ORB_SLAM3
                     continue;
 
                 // Triangulation is succesfull
-                MapPoint *pMP = new MapPoint(x3D, mpCurrentKeyFrame, mpAtlas->GetCurrentMap());
-                if (bPointStereo)
-                    countStereo++;
+                NewPoint np;
+                np.idx1 = idx1;
+                np.idx2 = idx2;
+                np.x3D = x3D;
+                vNewPoints.push_back(np);
+            } });
+
+        // Insert the new points. A keypoint of the current keyframe matched with several neighbors keeps
+        // the point of the first one, as when the neighbors were searched one after the other
+        for (int i = 0; i < nNeighs; i++)
+        {
+            if (vbAborted[i])
+                return;
 
-                pMP->AddObservation(mpCurrentKeyFrame, idx1);
-                pMP->AddObservation(pKF2, idx2);
+            KeyFrame *pKF2 = vpNeighKFs[i];
+            const vector<NewPoint> &vNewPoints = vvNewPoints[i];
+
+            for (const NewPoint &np : vNewPoints)
+            {
+                if (mpCurrentKeyFrame->GetMapPoint(np.idx1))
+                    continue;
+
+                MapPoint *pMP = new MapPoint(np.x3D, mpCurrentKeyFrame, mpAtlas->GetCurrentMap());
 
-                mpCurrentKeyFrame->AddMapPoint(pMP, idx1);
-                pKF2->AddMapPoint(pMP, idx2);
+                pMP->AddObservation(mpCurrentKeyFrame, np.idx1);
+                pMP->AddObservation(pKF2, np.idx2);
+
+                mpCurrentKeyFrame->AddMapPoint(pMP, np.idx1);
+                pKF2->AddMapPoint(pMP, np.idx2);
 
                 pMP->ComputeDistinctiveDescriptors();
 
@@ -770,16 +793,28 @@ namespace ORB_SLAM3
             }
         }
 
-        // Search matches by projection from current KF in target KFs
+        // Search matches by projection from current KF in target KFs. The searches only read the map and
+        // run in parallel, the matches are then fused one keyframe after the other in the target order
         ORBmatcher matcher;
         vector<MapPoint *> vpMapPointMatches = mpCurrentKeyFrame->GetMapPointMatches();
-        for (vector<KeyFrame *>::iterator vit = vpTargetKFs.begin(), vend = vpTargetKFs.end(); vit != vend; vit++)
+        const int nTargets = vpTargetKFs.size();
+        vector<vector<pair<size_t, MapPoint *>>> vvTargetMatches(nTargets), vvTargetMatchesRight(nTargets);
+        WorkerPool::Instance().ParallelFor(nTargets, [&](int i)
+                                           {
+            KeyFrame *pKFi = vpTargetKFs[i];
+
+            ORBmatcher matcheri;
+            matcheri.SearchForFuse(pKFi, vpMapPointMatches, vvTargetMatches[i]);
+            if (pKFi->NLeft != -1)
+                matcheri.SearchForFuse(pKFi, vpMapPointMatches, vvTargetMatchesRight[i], true); });
+
+        for (int i = 0; i < nTargets; i++)
         {
-            KeyFrame *pKFi = *vit;
+            KeyFrame *pKFi = vpTargetKFs[i];
 
-            matcher.Fuse(pKFi, vpMapPointMatches);
+            matcher.FuseMatches(pKFi, vvTargetMatches[i]);
             if (pKFi->NLeft != -1)
-                matcher.Fuse(pKFi, vpMapPointMatches, true);
+                matcher.FuseMatches(pKFi, vvTargetMatchesRight[i]);
         }
 
         if (mbAbortBA)
@@ -807,9 +842,28 @@ namespace ORB_SLAM3
             }
         }
 
-        matcher.Fuse(mpCurrentKeyFrame, vpFuseCandidates);
+        // All the candidates go to the current KF: they are searched in blocks in parallel and the matches
+        // are fused in the candidate order
+        const int nBlockSize = 256;
+        const int nBlocks = (vpFuseCandidates.size() + nBlockSize - 1) / nBlockSize;
+        vector<vector<pair<size_t, MapPoint *>>> vvBlockMatches(nBlocks), vvBlockMatchesRight(nBlocks);
+        WorkerPool::Instance().ParallelFor(nBlocks, [&](int iBlock)
+                                           {
+            const vector<MapPoint *> vpBlockCandidates(vpFuseCandidates.begin() + iBlock * nBlockSize,
+                                                       vpFuseCandidates.begin() + min<size_t>(vpFuseCandidates.size(), (iBlock + 1) * nBlockSize));
+
+            ORBmatcher matcherBlock;
+            matcherBlock.SearchForFuse(mpCurrentKeyFrame, vpBlockCandidates, vvBlockMatches[iBlock]);
+            if (mpCurrentKeyFrame->NLeft != -1)
+                matcherBlock.SearchForFuse(mpCurrentKeyFrame, vpBlockCandidates, vvBlockMatchesRight[iBlock], true); });
+
+        for (int iBlock = 0; iBlock < nBlocks; iBlock++)
+            matcher.FuseMatches(mpCurrentKeyFrame, vvBlockMatches[iBlock]);
         if (mpCurrentKeyFrame->NLeft != -1)
-            matcher.Fuse(mpCurrentKeyFrame, vpFuseCandidates, true);
+        {
+            for (int iBlock = 0; iBlock < nBlocks; iBlock++)
+                matcher.FuseMatches(mpCurrentKeyFrame, vvBlockMatchesRight[iBlock]);
+        }
 
         // Update points
         vpMapPointMatches = mpCurrentKeyFrame->GetMapPointMatches();
@@ -975,39 +1029,7 @@ namespace ORB_SLAM3
                             const int &scaleLevel = (pKF->NLeft == -1) ? pKF->mvKeysUn[i].octave
                                                     : (i < pKF->NLeft) ? pKF->mvKeys[i].octave
                                                                        : pKF->mvKeysRight[i].octave;
-                            const map<KeyFrame *, tuple<int, int>> observations = pMP->GetObservations();
-                            int nObs = 0;
-                            for (map<KeyFrame *, tuple<int, int>>::const_iterator mit = observations.begin(), mend = observations.end(); mit != mend; mit++)
-                            {
-                                KeyFrame *pKFi = mit->first;
-                                if (pKFi == pKF)
-                                    continue;
-                                tuple<int, int> indexes = mit->second;
-                                int leftIndex = get<0>(indexes), rightIndex = get<1>(indexes);
-                                int scaleLeveli = -1;
-                                if (pKFi->NLeft == -1)
-                                    scaleLeveli = pKFi->mvKeysUn[leftIndex].octave;
-                                else
-                                {
-                                    if (leftIndex != -1)
-                                    {
-                                        scaleLeveli = pKFi->mvKeys[leftIndex].octave;
-                                    }
-                                    if (rightIndex != -1)
-                                    {
-                                        int rightLevel = pKFi->mvKeysRight[rightIndex - pKFi->NLeft].octave;
-                                        scaleLeveli = (scaleLeveli == -1 || scaleLeveli > rightLevel) ? rightLevel
-                                                                                                      : scaleLeveli;
-                                    }
-                                }
-
-                                if (scaleLeveli <= scaleLevel + 1)
-                                {
-                                    nObs++;
-                                    if (nObs > thObs)
-                                        break;
-                                }
-                            }
+                            const int nObs = pMP->ObservationsUpToLevel(pKF, scaleLevel + 1);
                             if (nObs > thObs)
                             {
                                 nRedundantObservations++;
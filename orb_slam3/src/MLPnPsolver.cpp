@@ -74,12 +74,6 @@ namespace ORB_SLAM3 {
                     mvP2D.push_back(kp.pt);
                     mvSigma2.push_back(F.mvLevelSigma2[kp.octave]);
 
-                    //Bearing vector should be normalized
-                    cv::Point3f cv_br = mpCamera->unproject(kp.pt);
-                    cv_br /= cv_br.z;
-                    bearingVector_t br(cv_br.x,cv_br.y,cv_br.z);
-                    mvBearingVecs.push_back(br);
-
                     //3D coordinates
                     Eigen::Matrix<float,3,1> posEig = pMP -> GetWorldPos();
                     point_t pos(posEig(0),posEig(1),posEig(2));
@@ -93,6 +87,14 @@ namespace ORB_SLAM3 {
             }
         }
 
+        //Bearing vectors, unprojected all at once
+        vector<Eigen::Vector3f> vRays;
+        mpCamera->unprojectPoints(mvP2D, vRays);
+        for(const Eigen::Vector3f &ray : vRays){
+            bearingVector_t br(ray(0)/ray(2),ray(1)/ray(2),1.0);
+            mvBearingVecs.push_back(br);
+        }
+
         SetRansacParameters();
     }
 
@@ -17,8 +17,13 @@
  */
 
 #include "Map.h"
+#include "Semantic/Wall.h"
+#include "Semantic/Door.h"
+#include "Semantic/Room.h"
 
 #include <mutex>
+#include <cmath>
+#include <algorithm>
 
 namespace ORB_SLAM3
 {
@@ -26,7 +31,8 @@ namespace ORB_SLAM3
     long unsigned int Map::nNextId = 0;
 
     Map::Map() : mnMaxKFid(0), mnBigChangeIdx(0), mbImuInitialized(false), mnMapChange(0), mpFirstRegionKF(static_cast<KeyFrame *>(NULL)),
-                 mbFail(false), mIsInUse(false), mHasTumbnail(false), mbBad(false), mnMapChangeNotified(0), mbIsInertial(false), mbIMU_BA1(false), mbIMU_BA2(false)
+                 mbFail(false), mIsInUse(false), mHasTumbnail(false), mbBad(false), mnMapChangeNotified(0), mbIsInertial(false), mbIMU_BA1(false), mbIMU_BA2(false),
+                 mnMapPointSeq(0), mnMapPointSeqOldest(0)
     {
         mnId = nNextId++;
         mThumbnail = static_cast<GLubyte *>(NULL);
@@ -34,7 +40,8 @@ namespace ORB_SLAM3
 
     Map::Map(int initKFid) : mnInitKFid(initKFid), mnMaxKFid(initKFid), /*mnLastLoopKFid(initKFid),*/ mnBigChangeIdx(0), mIsInUse(false),
                              mHasTumbnail(false), mbBad(false), mbImuInitialized(false), mpFirstRegionKF(static_cast<KeyFrame *>(NULL)),
-                             mnMapChange(0), mbFail(false), mnMapChangeNotified(0), mbIsInertial(false), mbIMU_BA1(false), mbIMU_BA2(false)
+                             mnMapChange(0), mbFail(false), mnMapChangeNotified(0), mbIsInertial(false), mbIMU_BA1(false), mbIMU_BA2(false),
+                             mnMapPointSeq(0), mnMapPointSeqOldest(0)
     {
         mnId = nNextId++;
         mThumbnail = static_cast<GLubyte *>(NULL);
@@ -89,12 +96,17 @@ namespace ORB_SLAM3
     {
         unique_lock<mutex> lock(mMutexMap);
         mspMapPoints.insert(pMP);
+        RecordMapPointChange(pMP, false);
+
+        unique_lock<mutex> lock2(mMutexVoxelIndex);
+        IndexMapPoint(pMP);
     }
 
     void Map::AddMapMarker(Marker *pMarker)
     {
         unique_lock<mutex> lock(mMutexMap);
         mspMarkers.insert(pMarker);
+        mmMarkersById[pMarker->getId()] = pMarker;
     }
 
     void Map::AddMapWall(Wall *pWall)
@@ -131,6 +143,11 @@ namespace ORB_SLAM3
     {
         unique_lock<mutex> lock(mMutexMap);
         mspMapPoints.erase(pMP);
+        RecordMapPointChange(pMP, true);
+        {
+            unique_lock<mutex> lock2(mMutexVoxelIndex);
+            UnindexMapPoint(pMP);
+        }
 
         // TODO: This only erase the pointer.
         // Delete the MapPoint
@@ -140,6 +157,10 @@ namespace ORB_SLAM3
     {
         unique_lock<mutex> lock(mMutexMap);
         mspMarkers.erase(pMarker);
+
+        auto it = mmMarkersById.find(pMarker->getId());
+        if (it != mmMarkersById.end() && it->second == pMarker)
+            mmMarkersById.erase(it);
     }
 
     void Map::EraseMapWall(Wall *pWall)
@@ -200,6 +221,254 @@ namespace ORB_SLAM3
         return mnBigChangeIdx;
     }
 
+    void Map::RecordMapPointChange(MapPoint *pMP, const bool bErased)
+    {
+        unique_lock<mutex> lock(mMutexMapPointChanges);
+
+        MapPointChange change;
+        change.mnSeq = ++mnMapPointSeq;
+        change.mpMP = pMP;
+        // The id is only needed (and only guaranteed to be set) for erased points
+        change.mnMPId = bErased ? pMP->mnId : 0;
+        change.mbErased = bErased;
+        mdMapPointChanges.push_back(change);
+
+        while (mdMapPointChanges.size() > MAX_MAPPOINT_CHANGES)
+        {
+            mnMapPointSeqOldest = mdMapPointChanges.front().mnSeq;
+            mdMapPointChanges.pop_front();
+        }
+    }
+
+    void Map::RecordMapPointMoves(const vector<MapPoint *> &vpMPs)
+    {
+        unique_lock<mutex> lock(mMutexMapPointChanges);
+
+        for (MapPoint *pMP : vpMPs)
+        {
+            MapPointChange change;
+            change.mnSeq = ++mnMapPointSeq;
+            change.mpMP = pMP;
+            change.mnMPId = 0;
+            change.mbErased = false;
+            mdMapPointChanges.push_back(change);
+        }
+
+        while (mdMapPointChanges.size() > MAX_MAPPOINT_CHANGES)
+        {
+            mnMapPointSeqOldest = mdMapPointChanges.front().mnSeq;
+            mdMapPointChanges.pop_front();
+        }
+    }
+
+    void Map::InformMapPointMoved(MapPoint *pMP)
+    {
+        // Do not take mMutexMap here, positions are also updated while it is held (ApplyScaledRotation).
+        // Only points of this map are indexed, new points (still being built) and temporal ones are skipped
+        unique_lock<mutex> lock(mMutexVoxelIndex);
+        if (mmMapPointVoxel.count(pMP))
+            mspMovedMapPoints.insert(pMP);
+    }
+
+    void Map::IndexMovedMapPoints()
+    {
+        vector<MapPoint *> vpMoved;
+        {
+            unique_lock<mutex> lock(mMutexVoxelIndex);
+            if (mspMovedMapPoints.empty())
+                return;
+
+            vpMoved.reserve(mspMovedMapPoints.size());
+            for (MapPoint *pMP : mspMovedMapPoints)
+            {
+                IndexMapPoint(pMP);
+                vpMoved.push_back(pMP);
+            }
+            mspMovedMapPoints.clear();
+        }
+
+        RecordMapPointMoves(vpMoved);
+    }
+
+    Map::VoxelKey Map::GetVoxelKey(const int x, const int y, const int z)
+    {
+        // 21 bits per axis, enough for +-262 km with the default voxel size
+        return ((static_cast<VoxelKey>(x) & 0x1FFFFF) << 42) | ((static_cast<VoxelKey>(y) & 0x1FFFFF) << 21) |
+               (static_cast<VoxelKey>(z) & 0x1FFFFF);
+    }
+
+    Map::VoxelKey Map::GetVoxelKey(const Eigen::Vector3f &pos)
+    {
+        return GetVoxelKey((int)std::floor(pos(0) / MAPPOINT_VOXEL_SIZE), (int)std::floor(pos(1) / MAPPOINT_VOXEL_SIZE),
+                           (int)std::floor(pos(2) / MAPPOINT_VOXEL_SIZE));
+    }
+
+    Eigen::Vector3f Map::GetVoxelCenter(const VoxelKey key)
+    {
+        Eigen::Vector3f center;
+        for (int i = 0; i < 3; i++)
+        {
+            // Sign extension of the 21 bit coordinate
+            int c = static_cast<int>((key >> (42 - 21 * i)) & 0x1FFFFF);
+            if (c & 0x100000)
+                c -= 0x200000;
+            center(i) = (c + 0.5f) * MAPPOINT_VOXEL_SIZE;
+        }
+        return center;
+    }
+
+    void Map::IndexMapPoint(MapPoint *pMP)
+    {
+        // Called with mMutexVoxelIndex held. The position is read under the index lock,
+        // so the last of two concurrent moves always leaves the point in the right voxel.
+        const VoxelKey key = GetVoxelKey(pMP->GetWorldPos());
+        auto it = mmMapPointVoxel.find(pMP);
+        if (it != mmMapPointVoxel.end())
+        {
+            if (it->second == key)
+                return;
+            UnindexMapPoint(pMP);
+        }
+
+        mmVoxelMapPoints[key].push_back(pMP);
+        mmMapPointVoxel[pMP] = key;
+    }
+
+    void Map::UnindexMapPoint(MapPoint *pMP)
+    {
+        // Called with mMutexVoxelIndex held
+        auto it = mmMapPointVoxel.find(pMP);
+        if (it == mmMapPointVoxel.end())
+            return;
+
+        auto vit = mmVoxelMapPoints.find(it->second);
+        if (vit != mmVoxelMapPoints.end())
+        {
+            vector<MapPoint *> &vpVoxel = vit->second;
+            vpVoxel.erase(std::remove(vpVoxel.begin(), vpVoxel.end(), pMP), vpVoxel.end());
+            if (vpVoxel.empty())
+                mmVoxelMapPoints.erase(vit);
+        }
+        mmMapPointVoxel.erase(it);
+        mspMovedMapPoints.erase(pMP);
+    }
+
+    vector<MapPoint *> Map::GetMapPointsInRadius(const Eigen::Vector3f &center, const float radius)
+    {
+        vector<MapPoint *> vpPoints;
+        const float radius2 = radius * radius;
+        const int nMin[3] = {(int)std::floor((center(0) - radius) / MAPPOINT_VOXEL_SIZE),
+                             (int)std::floor((center(1) - radius) / MAPPOINT_VOXEL_SIZE),
+                             (int)std::floor((center(2) - radius) / MAPPOINT_VOXEL_SIZE)};
+        const int nMax[3] = {(int)std::floor((center(0) + radius) / MAPPOINT_VOXEL_SIZE),
+                             (int)std::floor((center(1) + radius) / MAPPOINT_VOXEL_SIZE),
+                             (int)std::floor((center(2) + radius) / MAPPOINT_VOXEL_SIZE)};
+
+        IndexMovedMapPoints();
+
+        unique_lock<mutex> lock(mMutexVoxelIndex);
+        for (int x = nMin[0]; x <= nMax[0]; x++)
+            for (int y = nMin[1]; y <= nMax[1]; y++)
+                for (int z = nMin[2]; z <= nMax[2]; z++)
+                {
+                    auto vit = mmVoxelMapPoints.find(GetVoxelKey(x, y, z));
+                    if (vit == mmVoxelMapPoints.end())
+                        continue;
+
+                    for (MapPoint *pMP : vit->second)
+                    {
+                        if (!pMP->isBad() && (pMP->GetWorldPos() - center).squaredNorm() <= radius2)
+                            vpPoints.push_back(pMP);
+                    }
+                }
+
+        return vpPoints;
+    }
+
+    vector<MapPoint *> Map::GetMapPointsNearPlane(const Eigen::Vector4d &plane, const float maxDist)
+    {
+        vector<MapPoint *> vpPoints;
+        const Eigen::Vector3f normal = plane.head<3>().cast<float>();
+        const float d = plane(3);
+
+        // A voxel can only hold points of the slab if its center is closer than maxDist plus half its diagonal
+        const float voxelReach = maxDist + 0.5f * std::sqrt(3.f) * MAPPOINT_VOXEL_SIZE * normal.norm();
+
+        IndexMovedMapPoints();
+
+        unique_lock<mutex> lock(mMutexVoxelIndex);
+        for (const auto &voxel : mmVoxelMapPoints)
+        {
+            if (std::fabs(normal.dot(GetVoxelCenter(voxel.first)) + d) > voxelReach)
+                continue;
+
+            for (MapPoint *pMP : voxel.second)
+            {
+                if (!pMP->isBad() && std::fabs(normal.dot(pMP->GetWorldPos()) + d) < maxDist)
+                    vpPoints.push_back(pMP);
+            }
+        }
+
+        return vpPoints;
+    }
+
+    long unsigned int Map::GetMapPointSeq()
+    {
+        unique_lock<mutex> lock(mMutexMapPointChanges);
+        return mnMapPointSeq;
+    }
+
+    bool Map::GetMapPointChangesSince(long unsigned int &nSeq, vector<MapPoint *> &vpChangedMPs, vector<long unsigned int> &vnErasedMPIds)
+    {
+        IndexMovedMapPoints();
+
+        vpChangedMPs.clear();
+        vnErasedMPIds.clear();
+
+        vector<MapPointChange> vChanges;
+        {
+            unique_lock<mutex> lock(mMutexMapPointChanges);
+            if (nSeq < mnMapPointSeqOldest || nSeq > mnMapPointSeq)
+            {
+                nSeq = mnMapPointSeq;
+                return false;
+            }
+
+            // Changes are stored in increasing sequence order
+            vChanges.assign(mdMapPointChanges.end() - (mnMapPointSeq - nSeq), mdMapPointChanges.end());
+            nSeq = mnMapPointSeq;
+        }
+
+        // A point can change several times since the last request, only its final state is reported
+        vector<MapPoint *> vpCandidates;
+        vector<pair<MapPoint *, long unsigned int>> vErased;
+        for (const MapPointChange &change : vChanges)
+        {
+            if (change.mbErased)
+                vErased.push_back(make_pair(change.mpMP, change.mnMPId));
+            else
+                vpCandidates.push_back(change.mpMP);
+        }
+        sort(vpCandidates.begin(), vpCandidates.end());
+        vpCandidates.erase(unique(vpCandidates.begin(), vpCandidates.end()), vpCandidates.end());
+
+        // Pointers are only compared against the indexed points of the map, points that are not in the
+        // map anymore (e.g. temporal points deleted by Tracking) are never dereferenced
+        {
+            unique_lock<mutex> lock(mMutexVoxelIndex);
+            for (MapPoint *pMP : vpCandidates)
+                if (mmMapPointVoxel.count(pMP))
+                    vpChangedMPs.push_back(pMP);
+            for (const pair<MapPoint *, long unsigned int> &erased : vErased)
+                if (!mmMapPointVoxel.count(erased.first))
+                    vnErasedMPIds.push_back(erased.second);
+        }
+        sort(vnErasedMPIds.begin(), vnErasedMPIds.end());
+        vnErasedMPIds.erase(unique(vnErasedMPIds.begin(), vnErasedMPIds.end()), vnErasedMPIds.end());
+
+        return true;
+    }
+
     vector<KeyFrame *> Map::GetAllKeyFrames()
     {
         unique_lock<mutex> lock(mMutexMap);
@@ -218,6 +487,13 @@ namespace ORB_SLAM3
         return vector<Marker *>(mspMarkers.begin(), mspMarkers.end());
     }
 
+    Marker *Map::GetMarkerById(int nMarkerId)
+    {
+        unique_lock<mutex> lock(mMutexMap);
+        auto it = mmMarkersById.find(nMarkerId);
+        return (it != mmMarkersById.end()) ? it->second : static_cast<Marker *>(NULL);
+    }
+
     vector<Wall *> Map::GetAllWalls()
     {
         unique_lock<mutex> lock(mMutexMap);
@@ -313,8 +589,21 @@ namespace ORB_SLAM3
         mspDoors.clear();
         mspRooms.clear();
         mspMarkers.clear();
+        mmMarkersById.clear();
         mspMapPoints.clear();
         mspKeyFrames.clear();
+        {
+            // Previous sequence numbers are no longer valid, clients need a full snapshot
+            unique_lock<mutex> lock(mMutexMapPointChanges);
+            mdMapPointChanges.clear();
+            mnMapPointSeqOldest = ++mnMapPointSeq;
+        }
+        {
+            unique_lock<mutex> lock(mMutexVoxelIndex);
+            mmVoxelMapPoints.clear();
+            mmMapPointVoxel.clear();
+            mspMovedMapPoints.clear();
+        }
         mnMaxKFid = mnInitKFid;
         mbImuInitialized = false;
         mvpReferenceMapPoints.clear();
@@ -524,6 +813,53 @@ namespace ORB_SLAM3
         {
             mnBackupKFlowerID = mpKFlowerID->mnId;
         }
+
+        PreSaveSemantics();
+    }
+
+    void Map::PreSaveSemantics()
+    {
+        // Semantic entities reference each other by their index in the backup vectors
+        mvpBackupMarkers.assign(mspMarkers.begin(), mspMarkers.end());
+        mvpBackupWalls.assign(mspWalls.begin(), mspWalls.end());
+        mvpBackupDoors.assign(mspDoors.begin(), mspDoors.end());
+        mvpBackupRooms.assign(mspRooms.begin(), mspRooms.end());
+
+        std::map<Marker *, int> mMarkerIdx;
+        std::map<Wall *, int> mWallIdx;
+        std::map<Door *, int> mDoorIdx;
+        for (int i = 0; i < mvpBackupMarkers.size(); i++)
+            mMarkerIdx[mvpBackupMarkers[i]] = i;
+        for (int i = 0; i < mvpBackupWalls.size(); i++)
+            mWallIdx[mvpBackupWalls[i]] = i;
+        for (int i = 0; i < mvpBackupDoors.size(); i++)
+            mDoorIdx[mvpBackupDoors[i]] = i;
+
+        for (Marker *pMarker : mvpBackupMarkers)
+            pMarker->PreSave(mspKeyFrames);
+        for (Wall *pWall : mvpBackupWalls)
+            pWall->PreSave(mMarkerIdx, mspMapPoints);
+        for (Door *pDoor : mvpBackupDoors)
+            pDoor->PreSave(mMarkerIdx);
+        for (Room *pRoom : mvpBackupRooms)
+            pRoom->PreSave(mWallIdx, mDoorIdx);
+
+        // Keyframes holding each entity, used by the optimizer
+        mvBackupMarkersKFId.assign(mvpBackupMarkers.size(), -1);
+        mvBackupWallsKFId.assign(mvpBackupWalls.size(), -1);
+        mvBackupDoorsKFId.assign(mvpBackupDoors.size(), -1);
+        for (KeyFrame *pKFi : mvpBackupKeyFrames)
+        {
+            for (Marker *pMarker : pKFi->GetMapMarkers())
+                if (mMarkerIdx.count(pMarker))
+                    mvBackupMarkersKFId[mMarkerIdx[pMarker]] = pKFi->mnId;
+            for (Wall *pWall : pKFi->GetMapWalls())
+                if (mWallIdx.count(pWall))
+                    mvBackupWallsKFId[mWallIdx[pWall]] = pKFi->mnId;
+            for (Door *pDoor : pKFi->GetMapDoors())
+                if (mDoorIdx.count(pDoor))
+                    mvBackupDoorsKFId[mDoorIdx[pDoor]] = pKFi->mnId;
+        }
     }
 
     void Map::PostLoad(KeyFrameDatabase *pKFDB, ORBVocabulary *pORBVoc /*, map<long unsigned int, KeyFrame*>& mpKeyFrameId*/, map<unsigned int, GeometricCamera *> &mpCams)
@@ -539,6 +875,9 @@ namespace ORB_SLAM3
 
             pMPi->UpdateMap(this);
             mpMapPointId[pMPi->mnId] = pMPi;
+
+            unique_lock<mutex> lock(mMutexVoxelIndex);
+            IndexMapPoint(pMPi);
         }
 
         map<long unsigned int, KeyFrame *> mpKeyFrameId;
@@ -588,7 +927,62 @@ namespace ORB_SLAM3
             mvpKeyFrameOrigins.push_back(mpKeyFrameId[mvBackupKeyFrameOriginsId[i]]);
         }
 
+        PostLoadSemantics(mpKeyFrameId, mpMapPointId);
+
         mvpBackupMapPoints.clear();
     }
 
+    void Map::PostLoadSemantics(map<long unsigned int, KeyFrame *> &mpKeyFrameId, map<long unsigned int, MapPoint *> &mpMapPointId)
+    {
+        std::copy(mvpBackupMarkers.begin(), mvpBackupMarkers.end(), std::inserter(mspMarkers, mspMarkers.begin()));
+        std::copy(mvpBackupWalls.begin(), mvpBackupWalls.end(), std::inserter(mspWalls, mspWalls.begin()));
+        std::copy(mvpBackupRooms.begin(), mvpBackupRooms.end(), std::inserter(mspRooms, mspRooms.begin()));
+
+        for (Marker *pMarker : mvpBackupMarkers)
+        {
+            pMarker->PostLoad(mpKeyFrameId, this);
+            mmMarkersById[pMarker->getId()] = pMarker;
+        }
+        for (Wall *pWall : mvpBackupWalls)
+            pWall->PostLoad(mvpBackupMarkers, mpMapPointId, this);
+        // A door is only usable through its marker, drop the ones whose marker was not saved
+        vector<Door *> vpDroppedDoors;
+        for (Door *&pDoor : mvpBackupDoors)
+        {
+            if (pDoor->PostLoad(mvpBackupMarkers, this))
+            {
+                mspDoors.insert(pDoor);
+                continue;
+            }
+
+            cout << "Warning: dropping door " << pDoor->getId() << " without a marker from the loaded map" << endl;
+            vpDroppedDoors.push_back(pDoor);
+            pDoor = nullptr;
+        }
+        for (Room *pRoom : mvpBackupRooms)
+            pRoom->PostLoad(mvpBackupWalls, mvpBackupDoors, this);
+
+        // Restore the semantic entities held by the keyframes
+        for (int i = 0; i < mvBackupMarkersKFId.size(); i++)
+            if (mpKeyFrameId.count(mvBackupMarkersKFId[i]))
+                mpKeyFrameId[mvBackupMarkersKFId[i]]->AddMapMarker(mvpBackupMarkers[i]);
+        for (int i = 0; i < mvBackupWallsKFId.size(); i++)
+            if (mpKeyFrameId.count(mvBackupWallsKFId[i]))
+                mpKeyFrameId[mvBackupWallsKFId[i]]->AddMapWall(mvpBackupWalls[i]);
+        for (int i = 0; i < mvBackupDoorsKFId.size(); i++)
+            if (mvpBackupDoors[i] && mpKeyFrameId.count(mvBackupDoorsKFId[i]))
+                mpKeyFrameId[mvBackupDoorsKFId[i]]->AddMapDoor(mvpBackupDoors[i]);
+
+        for (Door *pDoor : vpDroppedDoors)
+            delete pDoor;
+
+        mvpBackupMarkers.clear();
+        mvpBackupWalls.clear();
+        mvpBackupDoors.clear();
+        mvpBackupRooms.clear();
+        mvBackupMarkersKFId.clear();
+        mvBackupWallsKFId.clear();
+        mvBackupDoorsKFId.clear();
+    }
+
 } // namespace ORB_SLAM3
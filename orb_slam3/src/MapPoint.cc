@@ -30,7 +30,7 @@ namespace ORB_SLAM3
     MapPoint::MapPoint() : mnFirstKFid(0), mnFirstFrame(0), nObs(0), mnTrackReferenceForFrame(0),
                            mnLastFrameSeen(0), mnBALocalForKF(0), mnFuseCandidateForKF(0), mnLoopPointForKF(0), mnCorrectedByKF(0),
                            mnCorrectedReference(0), mnBAGlobalForKF(0), mnVisible(1), mnFound(1), mbBad(false),
-                           mpReplaced(static_cast<MapPoint *>(NULL))
+                           mpReplaced(static_cast<MapPoint *>(NULL)), mpMap(static_cast<Map *>(NULL))
     {
         mpReplaced = static_cast<MapPoint *>(NULL);
     }
@@ -115,9 +115,17 @@ namespace ORB_SLAM3
 
     void MapPoint::SetWorldPos(const Eigen::Vector3f &Pos)
     {
-        unique_lock<mutex> lock2(mGlobalMutex);
-        unique_lock<mutex> lock(mMutexPos);
-        mWorldPos = Pos;
+        {
+            unique_lock<mutex> lock2(mGlobalMutex);
+            unique_lock<mutex> lock(mMutexPos);
+            mWorldPos = Pos;
+            mnGeometryVersion++;
+        }
+
+        // Notify the change feed of the map (used for incremental publishing)
+        Map *pMap = GetMap();
+        if (pMap)
+            pMap->InformMapPointMoved(this);
     }
 
     Eigen::Vector3f MapPoint::GetWorldPos()
@@ -132,6 +140,15 @@ namespace ORB_SLAM3
         return mNormalVector;
     }
 
+    void MapPoint::GetViewGeometry(Eigen::Vector3f &Pos, Eigen::Vector3f &Normal, float &minDistance, float &maxDistance)
+    {
+        unique_lock<mutex> lock(mMutexPos);
+        Pos = mWorldPos;
+        Normal = mNormalVector;
+        minDistance = mfMinDistance;
+        maxDistance = mfMaxDistance;
+    }
+
     KeyFrame *MapPoint::GetReferenceKeyFrame()
     {
         unique_lock<mutex> lock(mMutexFeatures);
@@ -146,6 +163,7 @@ namespace ORB_SLAM3
         if (mObservations.count(pKF))
         {
             indexes = mObservations[pKF];
+            CountObservationLevel(ObservationLevel(pKF, indexes), -1);
         }
         else
         {
@@ -162,6 +180,8 @@ namespace ORB_SLAM3
         }
 
         mObservations[pKF] = indexes;
+        mnObservationsVersion++;
+        CountObservationLevel(ObservationLevel(pKF, indexes), 1);
 
         if (!pKF->mpCamera2 && pKF->mvuRight[idx] >= 0)
             nObs += 2;
@@ -191,7 +211,9 @@ namespace ORB_SLAM3
                     nObs--;
                 }
 
+                CountObservationLevel(ObservationLevel(pKF, indexes), -1);
                 mObservations.erase(pKF);
+                mnObservationsVersion++;
 
                 if (mpRefKF == pKF)
                     mpRefKF = mObservations.begin()->first;
@@ -218,6 +240,45 @@ namespace ORB_SLAM3
         return nObs;
     }
 
+    int MapPoint::ObservationsUpToLevel(KeyFrame *pKF, const int maxLevel)
+    {
+        unique_lock<mutex> lock(mMutexFeatures);
+
+        int n = 0;
+        for (int level = 0, levelEnd = min(maxLevel + 1, static_cast<int>(mvnObservationsPerLevel.size())); level < levelEnd; level++)
+            n += mvnObservationsPerLevel[level];
+
+        map<KeyFrame *, tuple<int, int>>::const_iterator it = mObservations.find(pKF);
+        if (it != mObservations.end() && ObservationLevel(pKF, it->second) <= maxLevel)
+            n--;
+
+        return n;
+    }
+
+    int MapPoint::ObservationLevel(KeyFrame *pKF, const tuple<int, int> &indexes)
+    {
+        const int leftIndex = get<0>(indexes), rightIndex = get<1>(indexes);
+        if (pKF->NLeft == -1)
+            return pKF->mvKeysUn[leftIndex].octave;
+
+        int level = -1;
+        if (leftIndex != -1)
+            level = pKF->mvKeys[leftIndex].octave;
+        if (rightIndex != -1)
+        {
+            const int rightLevel = pKF->mvKeysRight[rightIndex - pKF->NLeft].octave;
+            level = (level == -1 || level > rightLevel) ? rightLevel : level;
+        }
+        return level;
+    }
+
+    void MapPoint::CountObservationLevel(const int level, const int n)
+    {
+        if (level >= static_cast<int>(mvnObservationsPerLevel.size()))
+            mvnObservationsPerLevel.resize(level + 1, 0);
+        mvnObservationsPerLevel[level] += n;
+    }
+
     void MapPoint::SetBadFlag()
     {
         map<KeyFrame *, tuple<int, int>> obs;
@@ -227,6 +288,8 @@ namespace ORB_SLAM3
             mbBad = true;
             obs = mObservations;
             mObservations.clear();
+            mnObservationsVersion++;
+            mvnObservationsPerLevel.clear();
         }
         for (map<KeyFrame *, tuple<int, int>>::iterator mit = obs.begin(), mend = obs.end(); mit != mend; mit++)
         {
@@ -264,6 +327,8 @@ namespace ORB_SLAM3
             unique_lock<mutex> lock2(mMutexPos);
             obs = mObservations;
             mObservations.clear();
+            mnObservationsVersion++;
+            mvnObservationsPerLevel.clear();
             mbBad = true;
             nvisible = mnVisible;
             nfound = mnFound;
@@ -509,6 +574,7 @@ namespace ORB_SLAM3
             mfMaxDistance = dist * levelScaleFactor;
             mfMinDistance = mfMaxDistance / pRefKF->mvScaleFactors[nLevels - 1];
             mNormalVector = normal / n;
+            mnGeometryVersion++;
         }
     }
 
@@ -516,6 +582,7 @@ namespace ORB_SLAM3
     {
         unique_lock<mutex> lock3(mMutexPos);
         mNormalVector = normal;
+        mnGeometryVersion++;
     }
 
     float MapPoint::GetMinDistanceInvariance()
@@ -638,6 +705,7 @@ namespace ORB_SLAM3
         }
 
         mObservations.clear();
+        mvnObservationsPerLevel.clear();
 
         for (map<long unsigned int, int>::const_iterator it = mBackupObservationsId1.begin(), end = mBackupObservationsId1.end(); it != end; ++it)
         {
@@ -647,8 +715,10 @@ namespace ORB_SLAM3
             if (pKFi)
             {
                 mObservations[pKFi] = indexes;
+                CountObservationLevel(ObservationLevel(pKFi, indexes), 1);
             }
         }
+        mnObservationsVersion++;
 
         mBackupObservationsId1.clear();
         mBackupObservationsId2.clear();
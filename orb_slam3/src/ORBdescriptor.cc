@@ -0,0 +1,297 @@
+/**
+* This file is part of ORB-SLAM3
+*
+* Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+* Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+*
+* ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+* License as published by the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+* the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+* If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2009, Willow Garage, Inc.
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Willow Garage nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <opencv2/core/core.hpp>
+#include <vector>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ORB_SIMD_X86
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define ORB_SIMD_NEON
+#endif
+
+#include "ORBdescriptor.h"
+
+using namespace cv;
+using namespace std;
+
+namespace ORB_SLAM3
+{
+
+    /*
+     * The vector kernels reproduce computeOrbDescriptor bit by bit: the rotated offsets of the pattern are
+     * evaluated with the same float products and sums and rounded to the nearest even integer as cvRound
+     * does, then the intensity pairs are compared. If the compiler fuses a product and a sum into a
+     * multiply-add (it does by default where FMA is available, on aarch64 or with -march=native) the offset
+     * is rounded once instead of twice and lands on another pixel for some angles. This file is therefore
+     * compiled with -ffp-contract=off (see CMakeLists.txt), and test/orb_descriptor_check.cc compares the
+     * kernels offline.
+     */
+
+    const float factorPI = (float)(CV_PI/180.f);
+    static void computeOrbDescriptor(const KeyPoint& kpt,
+                                     const Mat& img, const Point* pattern,
+                                     uchar* desc)
+    {
+        float angle = (float)kpt.angle*factorPI;
+        float a = (float)cos(angle), b = (float)sin(angle);
+
+        const uchar* center = &img.at<uchar>(cvRound(kpt.pt.y), cvRound(kpt.pt.x));
+        const int step = (int)img.step;
+
+#define GET_VALUE(idx) \
+        center[cvRound(pattern[idx].x*b + pattern[idx].y*a)*step + \
+               cvRound(pattern[idx].x*a - pattern[idx].y*b)]
+
+
+        for (int i = 0; i < 32; ++i, pattern += 16)
+        {
+            int t0, t1, val;
+            t0 = GET_VALUE(0); t1 = GET_VALUE(1);
+            val = t0 < t1;
+            t0 = GET_VALUE(2); t1 = GET_VALUE(3);
+            val |= (t0 < t1) << 1;
+            t0 = GET_VALUE(4); t1 = GET_VALUE(5);
+            val |= (t0 < t1) << 2;
+            t0 = GET_VALUE(6); t1 = GET_VALUE(7);
+            val |= (t0 < t1) << 3;
+            t0 = GET_VALUE(8); t1 = GET_VALUE(9);
+            val |= (t0 < t1) << 4;
+            t0 = GET_VALUE(10); t1 = GET_VALUE(11);
+            val |= (t0 < t1) << 5;
+            t0 = GET_VALUE(12); t1 = GET_VALUE(13);
+            val |= (t0 < t1) << 6;
+            t0 = GET_VALUE(14); t1 = GET_VALUE(15);
+            val |= (t0 < t1) << 7;
+
+            desc[i] = (uchar)val;
+        }
+
+#undef GET_VALUE
+    }
+
+    void computeOrbDescriptorScalar(const KeyPoint& kpt, const Mat& img, const Point* pattern,
+                                    const OrbPatternSoA&, uchar* desc)
+    {
+        computeOrbDescriptor(kpt, img, pattern, desc);
+    }
+
+#ifdef ORB_SIMD_X86
+    __attribute__((target("avx2")))
+    static void computeOrbDescriptorAVX2(const KeyPoint& kpt, const Mat& img, const Point*,
+                                         const OrbPatternSoA& soa, uchar* desc)
+    {
+        float angle = (float)kpt.angle*factorPI;
+        float a = (float)cos(angle), b = (float)sin(angle);
+
+        const uchar* center = &img.at<uchar>(cvRound(kpt.pt.y), cvRound(kpt.pt.x));
+        const int step = (int)img.step;
+
+        const __m256 va = _mm256_set1_ps(a), vb = _mm256_set1_ps(b);
+        const __m256i vstep = _mm256_set1_epi32(step);
+
+        alignas(32) int offsets0[256], offsets1[256];
+        for (int i = 0; i < 256; i += 8)
+        {
+            __m256 x = _mm256_load_ps(soa.x0 + i), y = _mm256_load_ps(soa.y0 + i);
+            __m256i row = _mm256_cvtps_epi32(_mm256_add_ps(_mm256_mul_ps(x, vb), _mm256_mul_ps(y, va)));
+            __m256i col = _mm256_cvtps_epi32(_mm256_sub_ps(_mm256_mul_ps(x, va), _mm256_mul_ps(y, vb)));
+            _mm256_store_si256((__m256i*)(offsets0 + i), _mm256_add_epi32(_mm256_mullo_epi32(row, vstep), col));
+
+            x = _mm256_load_ps(soa.x1 + i); y = _mm256_load_ps(soa.y1 + i);
+            row = _mm256_cvtps_epi32(_mm256_add_ps(_mm256_mul_ps(x, vb), _mm256_mul_ps(y, va)));
+            col = _mm256_cvtps_epi32(_mm256_sub_ps(_mm256_mul_ps(x, va), _mm256_mul_ps(y, vb)));
+            _mm256_store_si256((__m256i*)(offsets1 + i), _mm256_add_epi32(_mm256_mullo_epi32(row, vstep), col));
+        }
+
+        alignas(32) uchar t0[256], t1[256];
+        for (int i = 0; i < 256; ++i)
+        {
+            t0[i] = center[offsets0[i]];
+            t1[i] = center[offsets1[i]];
+        }
+
+        // Unsigned t0 < t1 as a signed comparison of the biased values. Bit k of the mask is pair
+        // 32*i + k, i.e. bit k%8 of the descriptor byte 4*i + k/8
+        const __m256i bias = _mm256_set1_epi8((char)0x80);
+        for (int i = 0; i < 8; ++i)
+        {
+            __m256i v0 = _mm256_xor_si256(_mm256_load_si256((const __m256i*)(t0 + 32*i)), bias);
+            __m256i v1 = _mm256_xor_si256(_mm256_load_si256((const __m256i*)(t1 + 32*i)), bias);
+            unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpgt_epi8(v1, v0));
+            desc[4*i] = (uchar)mask;
+            desc[4*i+1] = (uchar)(mask >> 8);
+            desc[4*i+2] = (uchar)(mask >> 16);
+            desc[4*i+3] = (uchar)(mask >> 24);
+        }
+    }
+
+    __attribute__((target("sse4.1")))
+    static void computeOrbDescriptorSSE41(const KeyPoint& kpt, const Mat& img, const Point*,
+                                          const OrbPatternSoA& soa, uchar* desc)
+    {
+        float angle = (float)kpt.angle*factorPI;
+        float a = (float)cos(angle), b = (float)sin(angle);
+
+        const uchar* center = &img.at<uchar>(cvRound(kpt.pt.y), cvRound(kpt.pt.x));
+        const int step = (int)img.step;
+
+        const __m128 va = _mm_set1_ps(a), vb = _mm_set1_ps(b);
+        const __m128i vstep = _mm_set1_epi32(step);
+
+        alignas(16) int offsets0[256], offsets1[256];
+        for (int i = 0; i < 256; i += 4)
+        {
+            __m128 x = _mm_load_ps(soa.x0 + i), y = _mm_load_ps(soa.y0 + i);
+            __m128i row = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(x, vb), _mm_mul_ps(y, va)));
+            __m128i col = _mm_cvtps_epi32(_mm_sub_ps(_mm_mul_ps(x, va), _mm_mul_ps(y, vb)));
+            _mm_store_si128((__m128i*)(offsets0 + i), _mm_add_epi32(_mm_mullo_epi32(row, vstep), col));
+
+            x = _mm_load_ps(soa.x1 + i); y = _mm_load_ps(soa.y1 + i);
+            row = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(x, vb), _mm_mul_ps(y, va)));
+            col = _mm_cvtps_epi32(_mm_sub_ps(_mm_mul_ps(x, va), _mm_mul_ps(y, vb)));
+            _mm_store_si128((__m128i*)(offsets1 + i), _mm_add_epi32(_mm_mullo_epi32(row, vstep), col));
+        }
+
+        alignas(16) uchar t0[256], t1[256];
+        for (int i = 0; i < 256; ++i)
+        {
+            t0[i] = center[offsets0[i]];
+            t1[i] = center[offsets1[i]];
+        }
+
+        const __m128i bias = _mm_set1_epi8((char)0x80);
+        for (int i = 0; i < 16; ++i)
+        {
+            __m128i v0 = _mm_xor_si128(_mm_load_si128((const __m128i*)(t0 + 16*i)), bias);
+            __m128i v1 = _mm_xor_si128(_mm_load_si128((const __m128i*)(t1 + 16*i)), bias);
+            unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpgt_epi8(v1, v0));
+            desc[2*i] = (uchar)mask;
+            desc[2*i+1] = (uchar)(mask >> 8);
+        }
+    }
+#endif
+
+#ifdef ORB_SIMD_NEON
+    static void computeOrbDescriptorNEON(const KeyPoint& kpt, const Mat& img, const Point*,
+                                         const OrbPatternSoA& soa, uchar* desc)
+    {
+        float angle = (float)kpt.angle*factorPI;
+        float a = (float)cos(angle), b = (float)sin(angle);
+
+        const uchar* center = &img.at<uchar>(cvRound(kpt.pt.y), cvRound(kpt.pt.x));
+        const int step = (int)img.step;
+
+        const float32x4_t va = vdupq_n_f32(a), vb = vdupq_n_f32(b);
+        const int32x4_t vstep = vdupq_n_s32(step);
+
+        int offsets0[256], offsets1[256];
+        for (int i = 0; i < 256; i += 4)
+        {
+            float32x4_t x = vld1q_f32(soa.x0 + i), y = vld1q_f32(soa.y0 + i);
+            int32x4_t row = vcvtnq_s32_f32(vaddq_f32(vmulq_f32(x, vb), vmulq_f32(y, va)));
+            int32x4_t col = vcvtnq_s32_f32(vsubq_f32(vmulq_f32(x, va), vmulq_f32(y, vb)));
+            vst1q_s32(offsets0 + i, vaddq_s32(vmulq_s32(row, vstep), col));
+
+            x = vld1q_f32(soa.x1 + i); y = vld1q_f32(soa.y1 + i);
+            row = vcvtnq_s32_f32(vaddq_f32(vmulq_f32(x, vb), vmulq_f32(y, va)));
+            col = vcvtnq_s32_f32(vsubq_f32(vmulq_f32(x, va), vmulq_f32(y, vb)));
+            vst1q_s32(offsets1 + i, vaddq_s32(vmulq_s32(row, vstep), col));
+        }
+
+        uchar t0[256], t1[256];
+        for (int i = 0; i < 256; ++i)
+        {
+            t0[i] = center[offsets0[i]];
+            t1[i] = center[offsets1[i]];
+        }
+
+        // Weight each lane with its bit and add the 8 lanes of every half into one byte
+        static const uint8_t kBits[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+        const uint8x16_t bits = vld1q_u8(kBits);
+        for (int i = 0; i < 16; ++i)
+        {
+            uint8x16_t lt = vandq_u8(vcltq_u8(vld1q_u8(t0 + 16*i), vld1q_u8(t1 + 16*i)), bits);
+            desc[2*i] = vaddv_u8(vget_low_u8(lt));
+            desc[2*i+1] = vaddv_u8(vget_high_u8(lt));
+        }
+    }
+#endif
+
+    vector<OrbDescriptorKernel> supportedOrbDescriptorKernels()
+    {
+        vector<OrbDescriptorKernel> vKernels;
+#if defined(ORB_SIMD_X86)
+        if (checkHardwareSupport(CV_CPU_AVX2))
+            vKernels.push_back(computeOrbDescriptorAVX2);
+        if (checkHardwareSupport(CV_CPU_SSE4_1))
+            vKernels.push_back(computeOrbDescriptorSSE41);
+#elif defined(ORB_SIMD_NEON)
+        vKernels.push_back(computeOrbDescriptorNEON);
+#endif
+        return vKernels;
+    }
+
+    OrbDescriptorKernel selectOrbDescriptorKernel()
+    {
+        if (!useOptimized())
+            return computeOrbDescriptorScalar;
+
+        static const vector<OrbDescriptorKernel> vKernels = supportedOrbDescriptorKernels();
+        return vKernels.empty() ? computeOrbDescriptorScalar : vKernels.front();
+    }
+
+} //namespace ORB_SLAM
@@ -26,6 +26,12 @@
 #include "Thirdparty/DBoW2/DBoW2/FeatureVector.h"
 
 #include<stdint-gcc.h>
+#include<cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include<immintrin.h>
+#define ORB_MATCHER_SIMD_X86
+#endif
 
 using namespace std;
 
@@ -46,6 +52,11 @@ namespace ORB_SLAM3
 
         const bool bFactor = th!=1.0;
 
+        // Candidates of each MapPoint, scored in one batch
+        vector<size_t> vCandidates;
+        vector<const uchar*> vpCandidateDescs;
+        vector<int> vDists;
+
         for(size_t iMP=0; iMP<vpMapPoints.size(); iMP++)
         {
             MapPoint* pMP = vpMapPoints[iMP];
@@ -80,7 +91,8 @@ namespace ORB_SLAM3
                     int bestLevel2 = -1;
                     int bestIdx =-1 ;
 
-                    // Get best and second matches with near keypoints
+                    vCandidates.clear();
+                    vpCandidateDescs.clear();
                     for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
                     {
                         const size_t idx = *vit;
@@ -96,9 +108,16 @@ namespace ORB_SLAM3
                                 continue;
                         }
 
-                        const cv::Mat &d = F.mDescriptors.row(idx);
+                        vCandidates.push_back(idx);
+                        vpCandidateDescs.push_back(F.mDescriptors.ptr<uchar>(idx));
+                    }
+                    DescriptorDistances(MPdescriptor, vpCandidateDescs, vDists);
 
-                        const int dist = DescriptorDistance(MPdescriptor,d);
+                    // Get best and second matches with near keypoints
+                    for(size_t iC=0; iC<vCandidates.size(); iC++)
+                    {
+                        const size_t idx = vCandidates[iC];
+                        const int dist = vDists[iC];
 
                         if(dist<bestDist)
                         {
@@ -160,7 +179,8 @@ namespace ORB_SLAM3
                     int bestLevel2 = -1;
                     int bestIdx =-1 ;
 
-                    // Get best and second matches with near keypoints
+                    vCandidates.clear();
+                    vpCandidateDescs.clear();
                     for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
                     {
                         const size_t idx = *vit;
@@ -169,10 +189,16 @@ namespace ORB_SLAM3
                             if(F.mvpMapPoints[idx + F.Nleft]->Observations()>0)
                                 continue;
 
+                        vCandidates.push_back(idx);
+                        vpCandidateDescs.push_back(F.mDescriptors.ptr<uchar>(idx + F.Nleft));
+                    }
+                    DescriptorDistances(MPdescriptor, vpCandidateDescs, vDists);
 
-                        const cv::Mat &d = F.mDescriptors.row(idx + F.Nleft);
-
-                        const int dist = DescriptorDistance(MPdescriptor,d);
+                    // Get best and second matches with near keypoints
+                    for(size_t iC=0; iC<vCandidates.size(); iC++)
+                    {
+                        const size_t idx = vCandidates[iC];
+                        const int dist = vDists[iC];
 
                         if(dist<bestDist)
                         {
@@ -235,6 +261,10 @@ namespace ORB_SLAM3
             rotHist[i].reserve(500);
         const float factor = 1.0f/HISTO_LENGTH;
 
+        vector<unsigned int> vCandidates;
+        vector<const uchar*> vpCandidateDescs;
+        vector<int> vDists;
+
         // We perform the matching over ORB that belong to the same vocabulary node (at a certain level)
         DBoW2::FeatureVector::const_iterator KFit = vFeatVecKF.begin();
         DBoW2::FeatureVector::const_iterator Fit = F.mFeatVec.begin();
@@ -270,18 +300,26 @@ namespace ORB_SLAM3
                     int bestIdxFR =-1 ;
                     int bestDist2R=256;
 
+                    vCandidates.clear();
+                    vpCandidateDescs.clear();
                     for(size_t iF=0; iF<vIndicesF.size(); iF++)
                     {
-                        if(F.Nleft == -1){
-                            const unsigned int realIdxF = vIndicesF[iF];
+                        const unsigned int realIdxF = vIndicesF[iF];
 
-                            if(vpMapPointMatches[realIdxF])
-                                continue;
+                        if(vpMapPointMatches[realIdxF])
+                            continue;
 
-                            const cv::Mat &dF = F.mDescriptors.row(realIdxF);
+                        vCandidates.push_back(realIdxF);
+                        vpCandidateDescs.push_back(F.mDescriptors.ptr<uchar>(realIdxF));
+                    }
+                    DescriptorDistances(dKF, vpCandidateDescs, vDists);
 
-                            const int dist =  DescriptorDistance(dKF,dF);
+                    for(size_t iC=0; iC<vCandidates.size(); iC++)
+                    {
+                        const unsigned int realIdxF = vCandidates[iC];
+                        const int dist = vDists[iC];
 
+                        if(F.Nleft == -1){
                             if(dist<bestDist1)
                             {
                                 bestDist2=bestDist1;
@@ -294,15 +332,6 @@ namespace ORB_SLAM3
                             }
                         }
                         else{
-                            const unsigned int realIdxF = vIndicesF[iF];
-
-                            if(vpMapPointMatches[realIdxF])
-                                continue;
-
-                            const cv::Mat &dF = F.mDescriptors.row(realIdxF);
-
-                            const int dist =  DescriptorDistance(dKF,dF);
-
                             if(realIdxF < F.Nleft && dist<bestDist1){
                                 bestDist2=bestDist1;
                                 bestDist1=dist;
@@ -785,6 +814,10 @@ namespace ORB_SLAM3
 
         int nmatches = 0;
 
+        vector<size_t> vCandidates;
+        vector<const uchar*> vpCandidateDescs;
+        vector<int> vDists;
+
         DBoW2::FeatureVector::const_iterator f1it = vFeatVec1.begin();
         DBoW2::FeatureVector::const_iterator f2it = vFeatVec2.begin();
         DBoW2::FeatureVector::const_iterator f1end = vFeatVec1.end();
@@ -813,6 +846,8 @@ namespace ORB_SLAM3
                     int bestIdx2 =-1 ;
                     int bestDist2=256;
 
+                    vCandidates.clear();
+                    vpCandidateDescs.clear();
                     for(size_t i2=0, iend2=f2it->second.size(); i2<iend2; i2++)
                     {
                         const size_t idx2 = f2it->second[i2];
@@ -829,9 +864,15 @@ namespace ORB_SLAM3
                         if(pMP2->isBad())
                             continue;
 
-                        const cv::Mat &d2 = Descriptors2.row(idx2);
+                        vCandidates.push_back(idx2);
+                        vpCandidateDescs.push_back(Descriptors2.ptr<uchar>(idx2));
+                    }
+                    DescriptorDistances(d1, vpCandidateDescs, vDists);
 
-                        int dist = DescriptorDistance(d1,d2);
+                    for(size_t iC=0; iC<vCandidates.size(); iC++)
+                    {
+                        const size_t idx2 = vCandidates[iC];
+                        const int dist = vDists[iC];
 
                         if(dist<bestDist1)
                         {
@@ -955,6 +996,10 @@ namespace ORB_SLAM3
 
         const float factor = 1.0f/HISTO_LENGTH;
 
+        vector<size_t> vCandidates;
+        vector<const uchar*> vpCandidateDescs;
+        vector<int> vDists;
+
         DBoW2::FeatureVector::const_iterator f1it = vFeatVec1.begin();
         DBoW2::FeatureVector::const_iterator f2it = vFeatVec2.begin();
         DBoW2::FeatureVector::const_iterator f1end = vFeatVec1.end();
@@ -994,6 +1039,8 @@ namespace ORB_SLAM3
                     int bestDist = TH_LOW;
                     int bestIdx2 = -1;
 
+                    vCandidates.clear();
+                    vpCandidateDescs.clear();
                     for(size_t i2=0, iend2=f2it->second.size(); i2<iend2; i2++)
                     {
                         size_t idx2 = f2it->second[i2];
@@ -1010,13 +1057,21 @@ namespace ORB_SLAM3
                             if(!bStereo2)
                                 continue;
 
-                        const cv::Mat &d2 = pKF2->mDescriptors.row(idx2);
+                        vCandidates.push_back(idx2);
+                        vpCandidateDescs.push_back(pKF2->mDescriptors.ptr<uchar>(idx2));
+                    }
+                    DescriptorDistances(d1, vpCandidateDescs, vDists);
 
-                        const int dist = DescriptorDistance(d1,d2);
+                    for(size_t iC=0; iC<vCandidates.size(); iC++)
+                    {
+                        size_t idx2 = vCandidates[iC];
+                        const int dist = vDists[iC];
 
                         if(dist>TH_LOW || dist>bestDist)
                             continue;
 
+                        const bool bStereo2 = (!pKF2->mpCamera2 &&  pKF2->mvuRight[idx2]>=0);
+
                         const cv::KeyPoint &kp2 = (pKF2 -> NLeft == -1) ? pKF2->mvKeysUn[idx2]
                                                                         : (idx2 < pKF2 -> NLeft) ? pKF2 -> mvKeys[idx2]
                                                                                                  : pKF2 -> mvKeysRight[idx2 - pKF2 -> NLeft];
@@ -1146,6 +1201,14 @@ namespace ORB_SLAM3
     }
 
     int ORBmatcher::Fuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const float th, const bool bRight)
+    {
+        vector<pair<size_t, MapPoint*> > vMatches;
+        SearchForFuse(pKF, vpMapPoints, vMatches, th, bRight);
+        return FuseMatches(pKF, vMatches);
+    }
+
+    int ORBmatcher::SearchForFuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, vector<pair<size_t, MapPoint*> > &vMatches,
+                                  const float th, const bool bRight)
     {
         GeometricCamera* pCamera;
         Sophus::SE3f Tcw;
@@ -1172,6 +1235,10 @@ namespace ORB_SLAM3
 
         const int nMPs = vpMapPoints.size();
 
+        vector<size_t> vCandidates;
+        vector<const uchar*> vpCandidateDescs;
+        vector<int> vDists;
+
         // For debbuging
         int count_notMP = 0, count_bad=0, count_isinKF = 0, count_negdepth = 0, count_notinim = 0, count_dist = 0, count_normal=0, count_notidx = 0, count_thcheck = 0;
         for(int i=0; i<nMPs; i++)
@@ -1257,6 +1324,8 @@ namespace ORB_SLAM3
 
             int bestDist = 256;
             int bestIdx = -1;
+            vCandidates.clear();
+            vpCandidateDescs.clear();
             for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
             {
                 size_t idx = *vit;
@@ -1297,36 +1366,23 @@ namespace ORB_SLAM3
 
                 if(bRight) idx += pKF->NLeft;
 
-                const cv::Mat &dKF = pKF->mDescriptors.row(idx);
-
-                const int dist = DescriptorDistance(dMP,dKF);
+                vCandidates.push_back(idx);
+                vpCandidateDescs.push_back(pKF->mDescriptors.ptr<uchar>(idx));
+            }
+            DescriptorDistances(dMP, vpCandidateDescs, vDists);
 
-                if(dist<bestDist)
+            for(size_t iC=0; iC<vCandidates.size(); iC++)
+            {
+                if(vDists[iC]<bestDist)
                 {
-                    bestDist = dist;
-                    bestIdx = idx;
+                    bestDist = vDists[iC];
+                    bestIdx = vCandidates[iC];
                 }
             }
 
-            // If there is already a MapPoint replace otherwise add new measurement
             if(bestDist<=TH_LOW)
             {
-                MapPoint* pMPinKF = pKF->GetMapPoint(bestIdx);
-                if(pMPinKF)
-                {
-                    if(!pMPinKF->isBad())
-                    {
-                        if(pMPinKF->Observations()>pMP->Observations())
-                            pMP->Replace(pMPinKF);
-                        else
-                            pMPinKF->Replace(pMP);
-                    }
-                }
-                else
-                {
-                    pMP->AddObservation(pKF,bestIdx);
-                    pKF->AddMapPoint(pMP,bestIdx);
-                }
+                vMatches.push_back(make_pair(static_cast<size_t>(bestIdx),pMP));
                 nFused++;
             }
             else
@@ -1337,6 +1393,42 @@ namespace ORB_SLAM3
         return nFused;
     }
 
+    int ORBmatcher::FuseMatches(KeyFrame *pKF, const vector<pair<size_t, MapPoint*> > &vMatches)
+    {
+        int nFused=0;
+
+        for(vector<pair<size_t, MapPoint*> >::const_iterator vit=vMatches.begin(), vend=vMatches.end(); vit!=vend; vit++)
+        {
+            const size_t idx = vit->first;
+            MapPoint* pMP = vit->second;
+
+            // The point may have been replaced or added to the keyframe by a previous match
+            if(pMP->isBad() || pMP->IsInKeyFrame(pKF))
+                continue;
+
+            // If there is already a MapPoint replace otherwise add new measurement
+            MapPoint* pMPinKF = pKF->GetMapPoint(idx);
+            if(pMPinKF)
+            {
+                if(!pMPinKF->isBad())
+                {
+                    if(pMPinKF->Observations()>pMP->Observations())
+                        pMP->Replace(pMPinKF);
+                    else
+                        pMPinKF->Replace(pMP);
+                }
+            }
+            else
+            {
+                pMP->AddObservation(pKF,idx);
+                pKF->AddMapPoint(pMP,idx);
+            }
+            nFused++;
+        }
+
+        return nFused;
+    }
+
     int ORBmatcher::Fuse(KeyFrame *pKF, Sophus::Sim3f &Scw, const vector<MapPoint *> &vpPoints, float th, vector<MapPoint *> &vpReplacePoint)
     {
         // Get Calibration Parameters for later projection
@@ -1692,6 +1784,10 @@ namespace ORB_SLAM3
         const bool bForward = tlc(2)>CurrentFrame.mb && !bMono;
         const bool bBackward = -tlc(2)>CurrentFrame.mb && !bMono;
 
+        vector<size_t> vCandidates;
+        vector<const uchar*> vpCandidateDescs;
+        vector<int> vDists;
+
         for(int i=0; i<LastFrame.N; i++)
         {
             MapPoint* pMP = LastFrame.mvpMapPoints[i];
@@ -1740,6 +1836,8 @@ namespace ORB_SLAM3
                     int bestDist = 256;
                     int bestIdx2 = -1;
 
+                    vCandidates.clear();
+                    vpCandidateDescs.clear();
                     for(vector<size_t>::const_iterator vit=vIndices2.begin(), vend=vIndices2.end(); vit!=vend; vit++)
                     {
                         const size_t i2 = *vit;
@@ -1756,14 +1854,17 @@ namespace ORB_SLAM3
                                 continue;
                         }
 
-                        const cv::Mat &d = CurrentFrame.mDescriptors.row(i2);
-
-                        const int dist = DescriptorDistance(dMP,d);
+                        vCandidates.push_back(i2);
+                        vpCandidateDescs.push_back(CurrentFrame.mDescriptors.ptr<uchar>(i2));
+                    }
+                    DescriptorDistances(dMP, vpCandidateDescs, vDists);
 
-                        if(dist<bestDist)
+                    for(size_t iC=0; iC<vCandidates.size(); iC++)
+                    {
+                        if(vDists[iC]<bestDist)
                         {
-                            bestDist=dist;
-                            bestIdx2=i2;
+                            bestDist=vDists[iC];
+                            bestIdx2=vCandidates[iC];
                         }
                     }
 
@@ -1815,6 +1916,8 @@ namespace ORB_SLAM3
                         int bestDist = 256;
                         int bestIdx2 = -1;
 
+                        vCandidates.clear();
+                        vpCandidateDescs.clear();
                         for(vector<size_t>::const_iterator vit=vIndices2.begin(), vend=vIndices2.end(); vit!=vend; vit++)
                         {
                             const size_t i2 = *vit;
@@ -1822,14 +1925,17 @@ namespace ORB_SLAM3
                                 if(CurrentFrame.mvpMapPoints[i2 + CurrentFrame.Nleft]->Observations()>0)
                                     continue;
 
-                            const cv::Mat &d = CurrentFrame.mDescriptors.row(i2 + CurrentFrame.Nleft);
-
-                            const int dist = DescriptorDistance(dMP,d);
+                            vCandidates.push_back(i2);
+                            vpCandidateDescs.push_back(CurrentFrame.mDescriptors.ptr<uchar>(i2 + CurrentFrame.Nleft));
+                        }
+                        DescriptorDistances(dMP, vpCandidateDescs, vDists);
 
-                            if(dist<bestDist)
+                        for(size_t iC=0; iC<vCandidates.size(); iC++)
+                        {
+                            if(vDists[iC]<bestDist)
                             {
-                                bestDist=dist;
-                                bestIdx2=i2;
+                                bestDist=vDists[iC];
+                                bestIdx2=vCandidates[iC];
                             }
                         }
 
@@ -1901,6 +2007,10 @@ namespace ORB_SLAM3
 
         const vector<MapPoint*> vpMPs = pKF->GetMapPointMatches();
 
+        vector<size_t> vCandidates;
+        vector<const uchar*> vpCandidateDescs;
+        vector<int> vDists;
+
         for(size_t i=0, iend=vpMPs.size(); i<iend; i++)
         {
             MapPoint* pMP = vpMPs[i];
@@ -1946,20 +2056,25 @@ namespace ORB_SLAM3
                     int bestDist = 256;
                     int bestIdx2 = -1;
 
+                    vCandidates.clear();
+                    vpCandidateDescs.clear();
                     for(vector<size_t>::const_iterator vit=vIndices2.begin(); vit!=vIndices2.end(); vit++)
                     {
                         const size_t i2 = *vit;
                         if(CurrentFrame.mvpMapPoints[i2])
                             continue;
 
-                        const cv::Mat &d = CurrentFrame.mDescriptors.row(i2);
-
-                        const int dist = DescriptorDistance(dMP,d);
+                        vCandidates.push_back(i2);
+                        vpCandidateDescs.push_back(CurrentFrame.mDescriptors.ptr<uchar>(i2));
+                    }
+                    DescriptorDistances(dMP, vpCandidateDescs, vDists);
 
-                        if(dist<bestDist)
+                    for(size_t iC=0; iC<vCandidates.size(); iC++)
+                    {
+                        if(vDists[iC]<bestDist)
                         {
-                            bestDist=dist;
-                            bestIdx2=i2;
+                            bestDist=vDists[iC];
+                            bestIdx2=vCandidates[iC];
                         }
                     }
 
@@ -2073,4 +2188,131 @@ namespace ORB_SLAM3
         return dist;
     }
 
+    typedef void (*DescriptorDistancesKernel)(const uchar* a, const uchar* const* vpB, size_t n, int* vDist);
+
+    static void DescriptorDistancesScalar(const uchar* a, const uchar* const* vpB, size_t n, int* vDist)
+    {
+        uint32_t va[8];
+        memcpy(va, a, 32);
+
+        for(size_t i=0; i<n; i++)
+        {
+            uint32_t vb[8];
+            memcpy(vb, vpB[i], 32);
+
+            int dist=0;
+            for(int j=0; j<8; j++)
+            {
+                unsigned int v = va[j] ^ vb[j];
+                v = v - ((v >> 1) & 0x55555555);
+                v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+                dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
+            }
+            vDist[i] = dist;
+        }
+    }
+
+#ifdef ORB_MATCHER_SIMD_X86
+    // One POPCNT per 64 bits
+    __attribute__((target("popcnt")))
+    static void DescriptorDistancesPopcnt(const uchar* a, const uchar* const* vpB, size_t n, int* vDist)
+    {
+        uint64_t va[4];
+        memcpy(va, a, 32);
+
+        for(size_t i=0; i<n; i++)
+        {
+            uint64_t vb[4];
+            memcpy(vb, vpB[i], 32);
+            vDist[i] = (int)(__builtin_popcountll(va[0] ^ vb[0]) + __builtin_popcountll(va[1] ^ vb[1]) +
+                             __builtin_popcountll(va[2] ^ vb[2]) + __builtin_popcountll(va[3] ^ vb[3]));
+        }
+    }
+
+    // Nibble lookup with VPSHUFB, a descriptor fills one register
+    __attribute__((target("avx2")))
+    static void DescriptorDistancesAVX2(const uchar* a, const uchar* const* vpB, size_t n, int* vDist)
+    {
+        const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                             0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i lowMask = _mm256_set1_epi8(0x0f);
+        const __m256i va = _mm256_loadu_si256((const __m256i*)a);
+
+        for(size_t i=0; i<n; i++)
+        {
+            const __m256i x = _mm256_xor_si256(va, _mm256_loadu_si256((const __m256i*)vpB[i]));
+            const __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(x, lowMask));
+            const __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(x, 4), lowMask));
+            const __m256i sums = _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+            const __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+            vDist[i] = _mm_cvtsi128_si32(sum) + _mm_extract_epi16(sum, 4);
+        }
+    }
+
+#ifdef CV_CPU_AVX_512VPOPCNTDQ
+    // VPOPCNTQ over two descriptors per register. The masked forms avoid undefined upper lanes
+    __attribute__((target("avx512f,avx512vpopcntdq")))
+    static inline int SumHalf(__m512i counts, const int half)
+    {
+        const __m256i v = half == 0 ? _mm512_maskz_extracti64x4_epi64(0x0f, counts, 0)
+                                    : _mm512_maskz_extracti64x4_epi64(0x0f, counts, 1);
+        const __m128i s = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        return _mm_cvtsi128_si32(s) + _mm_extract_epi32(s, 2);
+    }
+
+    __attribute__((target("avx512f,avx512vpopcntdq")))
+    static void DescriptorDistancesAVX512(const uchar* a, const uchar* const* vpB, size_t n, int* vDist)
+    {
+        const __m512i va = _mm512_maskz_broadcast_i64x4(0xff, _mm256_loadu_si256((const __m256i*)a));
+
+        for(size_t i=0; i<n; i+=2)
+        {
+            const __m256i b1 = _mm256_loadu_si256((const __m256i*)vpB[i+1<n ? i+1 : i]);
+            __m512i vb = _mm512_maskz_broadcast_i64x4(0x0f, _mm256_loadu_si256((const __m256i*)vpB[i]));
+            vb = _mm512_mask_broadcast_i64x4(vb, 0xf0, b1);
+
+            const __m512i counts = _mm512_popcnt_epi64(_mm512_xor_si512(va, vb));
+            vDist[i] = SumHalf(counts, 0);
+            if(i+1<n)
+                vDist[i+1] = SumHalf(counts, 1);
+        }
+    }
+#endif
+#endif
+
+    // Widest kernel supported by the CPU
+    static DescriptorDistancesKernel WidestDescriptorDistancesKernel()
+    {
+#ifdef ORB_MATCHER_SIMD_X86
+#ifdef CV_CPU_AVX_512VPOPCNTDQ
+        if(cv::checkHardwareSupport(CV_CPU_AVX_512VPOPCNTDQ))
+            return DescriptorDistancesAVX512;
+#endif
+        if(cv::checkHardwareSupport(CV_CPU_AVX2))
+            return DescriptorDistancesAVX2;
+        if(cv::checkHardwareSupport(CV_CPU_POPCNT))
+            return DescriptorDistancesPopcnt;
+#endif
+        return DescriptorDistancesScalar;
+    }
+
+    // The CPU is probed once, cv::setUseOptimized(false) forces the scalar kernel
+    static DescriptorDistancesKernel SelectDescriptorDistancesKernel()
+    {
+        if(!cv::useOptimized())
+            return DescriptorDistancesScalar;
+
+        static const DescriptorDistancesKernel kernel = WidestDescriptorDistancesKernel();
+        return kernel;
+    }
+
+    void ORBmatcher::DescriptorDistances(const cv::Mat &a, const vector<const uchar*> &vpCandidates, vector<int> &vDist)
+    {
+        vDist.resize(vpCandidates.size());
+        if(vpCandidates.empty())
+            return;
+
+        SelectDescriptorDistancesKernel()(a.ptr<uchar>(), vpCandidates.data(), vpCandidates.size(), vDist.data());
+    }
+
 } //namespace ORB_SLAM
@@ -35,6 +35,8 @@
 #include "G2oTypes.h"
 #include "Converter.h"
 #include "OptimizableTypes.h"
+#include "PoseSolver.h"
+#include "WorkerPool.h"
 
 namespace ORB_SLAM3
 {
@@ -990,44 +992,26 @@ namespace ORB_SLAM3
 
     int Optimizer::PoseOptimization(Frame *pFrame)
     {
-        g2o::SparseOptimizer optimizer;
-        g2o::BlockSolver_6_3::LinearSolverType *linearSolver;
-
-        linearSolver = new g2o::LinearSolverDense<g2o::BlockSolver_6_3::PoseMatrixType>();
-
-        g2o::BlockSolver_6_3 *solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
+        int nInitialCorrespondences = 0;
 
-        g2o::OptimizationAlgorithmLevenberg *solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
-        optimizer.setAlgorithm(solver);
+        const float deltaMono = sqrt(5.991);
+        const float deltaStereo = sqrt(7.815);
 
-        int nInitialCorrespondences = 0;
+        // Motion-only problem solved by PoseSolver (same edges and LM scheme as the g2o graph it replaces)
+        const Sophus::SE3f Trl = pFrame->mpCamera2 ? pFrame->GetRelativePoseTrl() : Sophus::SE3f();
+        PoseSolver solver(pFrame->mpCamera, pFrame->mpCamera2, Trl, pFrame->fx, pFrame->fy, pFrame->cx, pFrame->cy, pFrame->mbf,
+                          deltaMono, deltaStereo);
 
-        // Set Frame vertex
-        g2o::VertexSE3Expmap *vSE3 = new g2o::VertexSE3Expmap();
+        // Set Frame pose
         Sophus::SE3<float> Tcw = pFrame->GetPose();
-        vSE3->setEstimate(g2o::SE3Quat(Tcw.unit_quaternion().cast<double>(), Tcw.translation().cast<double>()));
-        vSE3->setId(0);
-        vSE3->setFixed(false);
-        optimizer.addVertex(vSE3);
+        const g2o::SE3Quat Tcw0(Tcw.unit_quaternion().cast<double>(), Tcw.translation().cast<double>());
 
-        // Set MapPoint vertices
+        // Set MapPoint observations
         const int N = pFrame->N;
 
-        vector<ORB_SLAM3::EdgeSE3ProjectXYZOnlyPose *> vpEdgesMono;
-        vector<ORB_SLAM3::EdgeSE3ProjectXYZOnlyPoseToBody *> vpEdgesMono_FHR;
-        vector<size_t> vnIndexEdgeMono, vnIndexEdgeRight;
-        vpEdgesMono.reserve(N);
-        vpEdgesMono_FHR.reserve(N);
-        vnIndexEdgeMono.reserve(N);
-        vnIndexEdgeRight.reserve(N);
-
-        vector<g2o::EdgeStereoSE3ProjectXYZOnlyPose *> vpEdgesStereo;
-        vector<size_t> vnIndexEdgeStereo;
-        vpEdgesStereo.reserve(N);
-        vnIndexEdgeStereo.reserve(N);
-
-        const float deltaMono = sqrt(5.991);
-        const float deltaStereo = sqrt(7.815);
+        vector<size_t> vnIndexObs;
+        vnIndexObs.reserve(N);
+        solver.Reserve(N);
 
         {
             unique_lock<mutex> lock(MapPoint::mGlobalMutex);
@@ -1037,139 +1021,32 @@ namespace ORB_SLAM3
                 MapPoint *pMP = pFrame->mvpMapPoints[i];
                 if (pMP)
                 {
+                    nInitialCorrespondences++;
+                    pFrame->mvbOutlier[i] = false;
+
                     // Conventional SLAM
                     if (!pFrame->mpCamera2)
                     {
+                        const cv::KeyPoint &kpUn = pFrame->mvKeysUn[i];
+                        const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
+
                         // Monocular observation
                         if (pFrame->mvuRight[i] < 0)
-                        {
-                            nInitialCorrespondences++;
-                            pFrame->mvbOutlier[i] = false;
-
-                            Eigen::Matrix<double, 2, 1> obs;
-                            const cv::KeyPoint &kpUn = pFrame->mvKeysUn[i];
-                            obs << kpUn.pt.x, kpUn.pt.y;
-
-                            ORB_SLAM3::EdgeSE3ProjectXYZOnlyPose *e = new ORB_SLAM3::EdgeSE3ProjectXYZOnlyPose();
-
-                            e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
-                            e->setMeasurement(obs);
-                            const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
-                            e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
-
-                            g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
-                            e->setRobustKernel(rk);
-                            rk->setDelta(deltaMono);
-
-                            e->pCamera = pFrame->mpCamera;
-                            e->Xw = pMP->GetWorldPos().cast<double>();
-
-                            optimizer.addEdge(e);
-
-                            vpEdgesMono.push_back(e);
-                            vnIndexEdgeMono.push_back(i);
-                        }
+                            solver.AddMonocular(pMP->GetWorldPos(), kpUn.pt.x, kpUn.pt.y, invSigma2);
                         else // Stereo observation
-                        {
-                            nInitialCorrespondences++;
-                            pFrame->mvbOutlier[i] = false;
-
-                            Eigen::Matrix<double, 3, 1> obs;
-                            const cv::KeyPoint &kpUn = pFrame->mvKeysUn[i];
-                            const float &kp_ur = pFrame->mvuRight[i];
-                            obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
-
-                            g2o::EdgeStereoSE3ProjectXYZOnlyPose *e = new g2o::EdgeStereoSE3ProjectXYZOnlyPose();
-
-                            e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
-                            e->setMeasurement(obs);
-                            const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
-                            Eigen::Matrix3d Info = Eigen::Matrix3d::Identity() * invSigma2;
-                            e->setInformation(Info);
-
-                            g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
-                            e->setRobustKernel(rk);
-                            rk->setDelta(deltaStereo);
-
-                            e->fx = pFrame->fx;
-                            e->fy = pFrame->fy;
-                            e->cx = pFrame->cx;
-                            e->cy = pFrame->cy;
-                            e->bf = pFrame->mbf;
-                            e->Xw = pMP->GetWorldPos().cast<double>();
-
-                            optimizer.addEdge(e);
-
-                            vpEdgesStereo.push_back(e);
-                            vnIndexEdgeStereo.push_back(i);
-                        }
+                            solver.AddStereo(pMP->GetWorldPos(), kpUn.pt.x, kpUn.pt.y, pFrame->mvuRight[i], invSigma2);
                     }
                     // SLAM with respect a rigid body
                     else
                     {
-                        nInitialCorrespondences++;
-
-                        cv::KeyPoint kpUn;
-
-                        if (i < pFrame->Nleft)
-                        { // Left camera observation
-                            kpUn = pFrame->mvKeys[i];
-
-                            pFrame->mvbOutlier[i] = false;
-
-                            Eigen::Matrix<double, 2, 1> obs;
-                            obs << kpUn.pt.x, kpUn.pt.y;
-
-                            ORB_SLAM3::EdgeSE3ProjectXYZOnlyPose *e = new ORB_SLAM3::EdgeSE3ProjectXYZOnlyPose();
-
-                            e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
-                            e->setMeasurement(obs);
-                            const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
-                            e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
-
-                            g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
-                            e->setRobustKernel(rk);
-                            rk->setDelta(deltaMono);
-
-                            e->pCamera = pFrame->mpCamera;
-                            e->Xw = pMP->GetWorldPos().cast<double>();
-
-                            optimizer.addEdge(e);
-
-                            vpEdgesMono.push_back(e);
-                            vnIndexEdgeMono.push_back(i);
-                        }
-                        else
-                        {
-                            kpUn = pFrame->mvKeysRight[i - pFrame->Nleft];
-
-                            Eigen::Matrix<double, 2, 1> obs;
-                            obs << kpUn.pt.x, kpUn.pt.y;
-
-                            pFrame->mvbOutlier[i] = false;
+                        const bool bRight = i >= pFrame->Nleft;
+                        const cv::KeyPoint &kp = bRight ? pFrame->mvKeysRight[i - pFrame->Nleft] : pFrame->mvKeys[i];
+                        const float invSigma2 = pFrame->mvInvLevelSigma2[kp.octave];
 
-                            ORB_SLAM3::EdgeSE3ProjectXYZOnlyPoseToBody *e = new ORB_SLAM3::EdgeSE3ProjectXYZOnlyPoseToBody();
-
-                            e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
-                            e->setMeasurement(obs);
-                            const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
-                            e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
-
-                            g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
-                            e->setRobustKernel(rk);
-                            rk->setDelta(deltaMono);
-
-                            e->pCamera = pFrame->mpCamera2;
-                            e->Xw = pMP->GetWorldPos().cast<double>();
-
-                            e->mTrl = g2o::SE3Quat(pFrame->GetRelativePoseTrl().unit_quaternion().cast<double>(), pFrame->GetRelativePoseTrl().translation().cast<double>());
-
-                            optimizer.addEdge(e);
-
-                            vpEdgesMono_FHR.push_back(e);
-                            vnIndexEdgeRight.push_back(i);
-                        }
+                        solver.AddMonocular(pMP->GetWorldPos(), kp.pt.x, kp.pt.y, invSigma2, bRight);
                     }
+
+                    vnIndexObs.push_back(i);
                 }
             }
         }
@@ -1186,107 +1063,43 @@ namespace ORB_SLAM3
         int nBad = 0;
         for (size_t it = 0; it < 4; it++)
         {
-            Tcw = pFrame->GetPose();
-            vSE3->setEstimate(g2o::SE3Quat(Tcw.unit_quaternion().cast<double>(), Tcw.translation().cast<double>()));
-
-            optimizer.initializeOptimization(0);
-            optimizer.optimize(its[it]);
+            solver.SetEstimate(Tcw0);
+            solver.Optimize(its[it]);
 
             nBad = 0;
-            for (size_t i = 0, iend = vpEdgesMono.size(); i < iend; i++)
-            {
-                ORB_SLAM3::EdgeSE3ProjectXYZOnlyPose *e = vpEdgesMono[i];
-
-                const size_t idx = vnIndexEdgeMono[i];
-
-                if (pFrame->mvbOutlier[idx])
-                {
-                    e->computeError();
-                }
-
-                const float chi2 = e->chi2();
-
-                if (chi2 > chi2Mono[it])
-                {
-                    pFrame->mvbOutlier[idx] = true;
-                    e->setLevel(1);
-                    nBad++;
-                }
-                else
-                {
-                    pFrame->mvbOutlier[idx] = false;
-                    e->setLevel(0);
-                }
-
-                if (it == 2)
-                    e->setRobustKernel(0);
-            }
-
-            for (size_t i = 0, iend = vpEdgesMono_FHR.size(); i < iend; i++)
+            for (size_t i = 0, iend = solver.Size(); i < iend; i++)
             {
-                ORB_SLAM3::EdgeSE3ProjectXYZOnlyPoseToBody *e = vpEdgesMono_FHR[i];
-
-                const size_t idx = vnIndexEdgeRight[i];
+                const size_t idx = vnIndexObs[i];
 
                 if (pFrame->mvbOutlier[idx])
                 {
-                    e->computeError();
+                    solver.ComputeChi2(i);
                 }
 
-                const float chi2 = e->chi2();
+                const float chi2 = solver.Chi2(i);
 
-                if (chi2 > chi2Mono[it])
+                if (chi2 > (solver.IsStereo(i) ? chi2Stereo[it] : chi2Mono[it]))
                 {
                     pFrame->mvbOutlier[idx] = true;
-                    e->setLevel(1);
+                    solver.SetActive(i, false);
                     nBad++;
                 }
                 else
                 {
                     pFrame->mvbOutlier[idx] = false;
-                    e->setLevel(0);
+                    solver.SetActive(i, true);
                 }
-
-                if (it == 2)
-                    e->setRobustKernel(0);
             }
 
-            for (size_t i = 0, iend = vpEdgesStereo.size(); i < iend; i++)
-            {
-                g2o::EdgeStereoSE3ProjectXYZOnlyPose *e = vpEdgesStereo[i];
-
-                const size_t idx = vnIndexEdgeStereo[i];
-
-                if (pFrame->mvbOutlier[idx])
-                {
-                    e->computeError();
-                }
+            if (it == 2)
+                solver.SetRobust(false);
 
-                const float chi2 = e->chi2();
-
-                if (chi2 > chi2Stereo[it])
-                {
-                    pFrame->mvbOutlier[idx] = true;
-                    e->setLevel(1);
-                    nBad++;
-                }
-                else
-                {
-                    e->setLevel(0);
-                    pFrame->mvbOutlier[idx] = false;
-                }
-
-                if (it == 2)
-                    e->setRobustKernel(0);
-            }
-
-            if (optimizer.edges().size() < 10)
+            if (solver.Size() < 10)
                 break;
         }
 
         // Recover optimized pose and return number of inliers
-        g2o::VertexSE3Expmap *vSE3_recov = static_cast<g2o::VertexSE3Expmap *>(optimizer.vertex(0));
-        g2o::SE3Quat SE3quat_recov = vSE3_recov->estimate();
+        const g2o::SE3Quat &SE3quat_recov = solver.GetEstimate();
         Sophus::SE3<float> pose(SE3quat_recov.rotation().cast<float>(),
                                 SE3quat_recov.translation().cast<float>());
         pFrame->SetPose(pose);
@@ -3721,6 +3534,7 @@ namespace ORB_SLAM3
 
         // Keyframes velocities and biases
         const int N = vpKFs.size();
+        vector<KeyFrame *> vpKFsToReintegrate;
         for (size_t i = 0; i < N; i++)
         {
             KeyFrame *pKFi = vpKFs[i];
@@ -3735,11 +3549,15 @@ namespace ORB_SLAM3
             {
                 pKFi->SetNewBias(b);
                 if (pKFi->mpImuPreintegrated)
-                    pKFi->mpImuPreintegrated->Reintegrate();
+                    vpKFsToReintegrate.push_back(pKFi);
             }
             else
                 pKFi->SetNewBias(b);
         }
+
+        // Each keyframe owns its preintegration, so they are updated in parallel
+        WorkerPool::Instance().ParallelFor(vpKFsToReintegrate.size(), [&](int i)
+                                           { vpKFsToReintegrate[i]->mpImuPreintegrated->Reintegrate(); });
     }
 
     void Optimizer::InertialOptimization(Map *pMap, Eigen::Vector3d &bg, Eigen::Vector3d &ba, float priorG, float priorA)
@@ -3881,6 +3699,7 @@ namespace ORB_SLAM3
 
         // Keyframes velocities and biases
         const int N = vpKFs.size();
+        vector<KeyFrame *> vpKFsToReintegrate;
         for (size_t i = 0; i < N; i++)
         {
             KeyFrame *pKFi = vpKFs[i];
@@ -3895,11 +3714,15 @@ namespace ORB_SLAM3
             {
                 pKFi->SetNewBias(b);
                 if (pKFi->mpImuPreintegrated)
-                    pKFi->mpImuPreintegrated->Reintegrate();
+                    vpKFsToReintegrate.push_back(pKFi);
             }
             else
                 pKFi->SetNewBias(b);
         }
+
+        // Each keyframe owns its preintegration, so they are updated in parallel
+        WorkerPool::Instance().ParallelFor(vpKFsToReintegrate.size(), [&](int i)
+                                           { vpKFsToReintegrate[i]->mpImuPreintegrated->Reintegrate(); });
     }
 
     void Optimizer::InertialOptimization(Map *pMap, Eigen::Matrix3d &Rwg, double &scale)
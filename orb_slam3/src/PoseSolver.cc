@@ -0,0 +1,349 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PoseSolver.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include <Eigen/Cholesky>
+
+namespace ORB_SLAM3
+{
+
+    PoseSolver::PoseSolver(GeometricCamera *pCamera, GeometricCamera *pCamera2, const Sophus::SE3f &Trl,
+                           const float fx, const float fy, const float cx, const float cy, const float bf,
+                           const float deltaMono, const float deltaStereo)
+        : mpCamera(pCamera), mpCamera2(pCamera2), mbPinhole(false), mbPinhole2(false),
+          fx(fx), fy(fy), cx(cx), cy(cy), bf(bf), mDeltaMono(deltaMono), mDeltaStereo(deltaStereo), mbRobust(true)
+    {
+        if (mpCamera && mpCamera->GetType() == GeometricCamera::CAM_PINHOLE)
+        {
+            mbPinhole = true;
+            for (int i = 0; i < 4; i++)
+                mK[i] = mpCamera->getParameter(i);
+        }
+
+        if (mpCamera2 && mpCamera2->GetType() == GeometricCamera::CAM_PINHOLE)
+        {
+            mbPinhole2 = true;
+            for (int i = 0; i < 4; i++)
+                mK2[i] = mpCamera2->getParameter(i);
+        }
+
+        // Same conversion as the g2o::SE3Quat used by the ToBody edges
+        g2o::SE3Quat Trl_(Trl.unit_quaternion().cast<double>(), Trl.translation().cast<double>());
+        mRrl = Trl_.rotation().toRotationMatrix();
+        mtrl = Trl_.translation();
+    }
+
+    void PoseSolver::Reserve(const size_t n)
+    {
+        mvX.reserve(n);
+        mvY.reserve(n);
+        mvZ.reserve(n);
+        mvU.reserve(n);
+        mvV.reserve(n);
+        mvUr.reserve(n);
+        mvInvSigma2.reserve(n);
+        mvType.reserve(n);
+        mvbActive.reserve(n);
+        mvChi2.reserve(n);
+        mvActive.reserve(n);
+    }
+
+    int PoseSolver::AddMonocular(const Eigen::Vector3f &Xw, const float u, const float v, const float invSigma2, const bool bRight)
+    {
+        mvX.push_back(Xw[0]);
+        mvY.push_back(Xw[1]);
+        mvZ.push_back(Xw[2]);
+        mvU.push_back(u);
+        mvV.push_back(v);
+        mvUr.push_back(0.0);
+        mvInvSigma2.push_back(invSigma2);
+        mvType.push_back(bRight ? MONOCULAR_RIGHT : MONOCULAR);
+        mvbActive.push_back(true);
+        mvChi2.push_back(0.0);
+
+        return mvType.size() - 1;
+    }
+
+    int PoseSolver::AddStereo(const Eigen::Vector3f &Xw, const float u, const float v, const float ur, const float invSigma2)
+    {
+        mvX.push_back(Xw[0]);
+        mvY.push_back(Xw[1]);
+        mvZ.push_back(Xw[2]);
+        mvU.push_back(u);
+        mvV.push_back(v);
+        mvUr.push_back(ur);
+        mvInvSigma2.push_back(invSigma2);
+        mvType.push_back(STEREO);
+        mvbActive.push_back(true);
+        mvChi2.push_back(0.0);
+
+        return mvType.size() - 1;
+    }
+
+    double PoseSolver::Evaluate(const size_t i, const Eigen::Matrix3d &Rcw, const Eigen::Vector3d &tcw,
+                                Eigen::Vector3d &e, Eigen::Matrix<double, 3, 6> *pJ) const
+    {
+        const Eigen::Vector3d Xc = Rcw * Eigen::Vector3d(mvX[i], mvY[i], mvZ[i]) + tcw;
+
+        if (mvType[i] == STEREO)
+        {
+            // Same arithmetic as g2o::EdgeStereoSE3ProjectXYZOnlyPose
+            const float invzf = 1.0f / Xc[2];
+            const double u = Xc[0] * invzf * fx + cx;
+            const double v = Xc[1] * invzf * fy + cy;
+            e << mvU[i] - u, mvV[i] - v, mvUr[i] - (u - bf * invzf);
+
+            if (pJ)
+            {
+                Eigen::Matrix<double, 3, 6> &J = *pJ;
+                const double x = Xc[0];
+                const double y = Xc[1];
+                const double invz = 1.0 / Xc[2];
+                const double invz_2 = invz * invz;
+
+                J(0, 0) = x * y * invz_2 * fx;
+                J(0, 1) = -(1 + (x * x * invz_2)) * fx;
+                J(0, 2) = y * invz * fx;
+                J(0, 3) = -invz * fx;
+                J(0, 4) = 0;
+                J(0, 5) = x * invz_2 * fx;
+
+                J(1, 0) = (1 + y * y * invz_2) * fy;
+                J(1, 1) = -x * y * invz_2 * fy;
+                J(1, 2) = -x * invz * fy;
+                J(1, 3) = 0;
+                J(1, 4) = -invz * fy;
+                J(1, 5) = y * invz_2 * fy;
+
+                J(2, 0) = J(0, 0) - bf * y * invz_2;
+                J(2, 1) = J(0, 1) + bf * x * invz_2;
+                J(2, 2) = J(0, 2);
+                J(2, 3) = J(0, 3);
+                J(2, 4) = 0;
+                J(2, 5) = J(0, 5) - bf * invz_2;
+            }
+        }
+        else
+        {
+            const bool bRight = mvType[i] == MONOCULAR_RIGHT;
+            GeometricCamera *pCamera = bRight ? mpCamera2 : mpCamera;
+            const bool bPinhole = bRight ? mbPinhole2 : mbPinhole;
+            const double *K = bRight ? mK2 : mK;
+
+            const Eigen::Vector3d Xp = bRight ? Eigen::Vector3d(mRrl * Xc + mtrl) : Xc;
+
+            // Pinhole projection inlined with the arithmetic of Pinhole::project
+            Eigen::Vector2d uv;
+            if (bPinhole)
+            {
+                uv[0] = K[0] * Xp[0] / Xp[2] + K[2];
+                uv[1] = K[1] * Xp[1] / Xp[2] + K[3];
+            }
+            else
+                uv = pCamera->project(Xp);
+
+            e << mvU[i] - uv[0], mvV[i] - uv[1], 0.0;
+
+            if (pJ)
+            {
+                Eigen::Matrix<double, 2, 3> Jproj;
+                if (bPinhole)
+                {
+                    Jproj(0, 0) = K[0] / Xp[2];
+                    Jproj(0, 1) = 0.0;
+                    Jproj(0, 2) = -K[0] * Xp[0] / (Xp[2] * Xp[2]);
+                    Jproj(1, 0) = 0.0;
+                    Jproj(1, 1) = K[1] / Xp[2];
+                    Jproj(1, 2) = -K[1] * Xp[1] / (Xp[2] * Xp[2]);
+                }
+                else
+                    Jproj = pCamera->projectJac(Xp);
+
+                Eigen::Matrix<double, 3, 6> SE3deriv;
+                SE3deriv << 0.0, Xc[2], -Xc[1], 1.0, 0.0, 0.0,
+                    -Xc[2], 0.0, Xc[0], 0.0, 1.0, 0.0,
+                    Xc[1], -Xc[0], 0.0, 0.0, 0.0, 1.0;
+
+                if (bRight)
+                    pJ->topRows<2>().noalias() = -Jproj * mRrl * SE3deriv;
+                else
+                    pJ->topRows<2>().noalias() = -Jproj * SE3deriv;
+                pJ->row(2).setZero();
+            }
+        }
+
+        return mvInvSigma2[i] * e.squaredNorm();
+    }
+
+    void PoseSolver::Robustify(const size_t i, const double chi2, double &cost, double &weight) const
+    {
+        if (!mbRobust)
+        {
+            cost = chi2;
+            weight = 1.0;
+            return;
+        }
+
+        const double delta = mvType[i] == STEREO ? mDeltaStereo : mDeltaMono;
+        const double dsqr = delta * delta;
+        if (chi2 <= dsqr)
+        {
+            cost = chi2;
+            weight = 1.0;
+        }
+        else
+        {
+            const double sqrte = sqrt(chi2);
+            cost = 2 * sqrte * delta - dsqr;
+            weight = delta / sqrte;
+        }
+    }
+
+    double PoseSolver::ComputeActiveChi2(const g2o::SE3Quat &Tcw)
+    {
+        const Eigen::Matrix3d Rcw = Tcw.rotation().toRotationMatrix();
+        const Eigen::Vector3d tcw = Tcw.translation();
+
+        Eigen::Vector3d e;
+        double cost, weight;
+        double chi = 0.0;
+        for (const size_t i : mvActive)
+        {
+            mvChi2[i] = Evaluate(i, Rcw, tcw, e, nullptr);
+            Robustify(i, mvChi2[i], cost, weight);
+            chi += cost;
+        }
+
+        return chi;
+    }
+
+    double PoseSolver::ComputeChi2(const size_t i)
+    {
+        Eigen::Vector3d e;
+        mvChi2[i] = Evaluate(i, mTcw.rotation().toRotationMatrix(), mTcw.translation(), e, nullptr);
+        return mvChi2[i];
+    }
+
+    void PoseSolver::Optimize(const int nIterations)
+    {
+        mvActive.clear();
+        for (size_t i = 0; i < mvType.size(); i++)
+        {
+            if (mvbActive[i])
+                mvActive.push_back(i);
+        }
+
+        // Like g2o, a pose without active observations is not optimized
+        if (mvActive.empty())
+            return;
+
+        // Levenberg-Marquardt with the damping update of g2o::OptimizationAlgorithmLevenberg
+        const int maxTrials = 10;
+        double lambda = 0.0;
+        double ni = 2.0;
+        int nBad = 0;
+
+        Eigen::Vector3d e;
+        Eigen::Matrix<double, 3, 6> J;
+
+        for (int it = 0; it < nIterations; it++)
+        {
+            const Eigen::Matrix3d Rcw = mTcw.rotation().toRotationMatrix();
+            const Eigen::Vector3d tcw = mTcw.translation();
+
+            Matrix6d H = Matrix6d::Zero();
+            Vector6d b = Vector6d::Zero();
+            double currentChi = 0.0;
+
+            for (const size_t i : mvActive)
+            {
+                double cost, weight;
+                mvChi2[i] = Evaluate(i, Rcw, tcw, e, &J);
+                Robustify(i, mvChi2[i], cost, weight);
+                currentChi += cost;
+
+                const double w = weight * mvInvSigma2[i];
+                H.noalias() += w * J.transpose() * J;
+                b.noalias() -= w * J.transpose() * e;
+            }
+
+            const double iniChi = currentChi;
+
+            if (it == 0)
+            {
+                lambda = 1e-5 * H.diagonal().cwiseAbs().maxCoeff();
+                ni = 2.0;
+                nBad = 0;
+            }
+
+            double rho = 0.0;
+            int nTrials = 0;
+            do
+            {
+                Matrix6d Hl = H;
+                Hl.diagonal().array() += lambda;
+
+                Eigen::LDLT<Matrix6d> ldlt(Hl);
+                const bool bSolved = ldlt.isPositive();
+                Vector6d x = Vector6d::Zero();
+                if (bSolved)
+                    x = ldlt.solve(b);
+
+                const g2o::SE3Quat Tnew = g2o::SE3Quat::exp(x) * mTcw;
+                double tempChi = ComputeActiveChi2(Tnew);
+                if (!bSolved)
+                    tempChi = std::numeric_limits<double>::max();
+
+                rho = (currentChi - tempChi) / (x.dot(lambda * x + b) + 1e-3);
+
+                if (rho > 0 && std::isfinite(tempChi))
+                {
+                    const double alpha = std::min(1.0 - pow(2 * rho - 1, 3), 2.0 / 3.0);
+                    lambda *= std::max(1.0 / 3.0, alpha);
+                    ni = 2.0;
+                    currentChi = tempChi;
+                    mTcw = Tnew;
+                }
+                else
+                {
+                    // The chi2 of the rejected step are kept, as g2o does
+                    lambda *= ni;
+                    ni *= 2;
+                }
+                nTrials++;
+            } while (rho < 0 && nTrials < maxTrials);
+
+            if (nTrials == maxTrials || rho == 0)
+                break;
+
+            if ((iniChi - currentChi) * 1e3 < iniChi)
+                nBad++;
+            else
+                nBad = 0;
+
+            if (nBad >= 3)
+                break;
+        }
+    }
+
+} // namespace ORB_SLAM3
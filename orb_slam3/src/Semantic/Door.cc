@@ -103,4 +103,22 @@ namespace ORB_SLAM3
         unique_lock<mutex> lock(mMutexMap);
         mpMap = pMap;
     }
+
+    void Door::PreSave(const std::map<Marker *, int> &mMarkerIdx)
+    {
+        auto it = mMarkerIdx.find(marker);
+        mnBackupMarkerIdx = (it != mMarkerIdx.end()) ? it->second : -1;
+    }
+
+    bool Door::PostLoad(const std::vector<Marker *> &vpMarkers, Map *pMap)
+    {
+        SetMap(pMap);
+
+        if (mnBackupMarkerIdx >= 0 && mnBackupMarkerIdx < (int)vpMarkers.size())
+            marker = vpMarkers[mnBackupMarkerIdx];
+        else
+            marker = nullptr;
+
+        return marker != nullptr;
+    }
 }
\ No newline at end of file
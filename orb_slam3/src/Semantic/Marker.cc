@@ -103,4 +103,35 @@ namespace ORB_SLAM3
         unique_lock<mutex> lock(mMutexMap);
         mpMap = pMap;
     }
+
+    void Marker::PreSave(set<KeyFrame *> &spKF)
+    {
+        // Save the id and the relative pose of each keyframe observing the marker
+        mvBackupObsKFIds.clear();
+        mvBackupObsPoses.clear();
+        for (const auto &obs : mObservations)
+        {
+            if (!obs.first || obs.first->isBad() || spKF.find(obs.first) == spKF.end())
+                continue;
+
+            mvBackupObsKFIds.push_back(obs.first->mnId);
+            mvBackupObsPoses.push_back(obs.second);
+        }
+    }
+
+    void Marker::PostLoad(map<long unsigned int, KeyFrame *> &mpKFid, Map *pMap)
+    {
+        SetMap(pMap);
+
+        mObservations.clear();
+        for (size_t i = 0; i < mvBackupObsKFIds.size(); i++)
+        {
+            auto it = mpKFid.find(mvBackupObsKFIds[i]);
+            if (it != mpKFid.end())
+                mObservations.insert({it->second, mvBackupObsPoses[i]});
+        }
+
+        mvBackupObsKFIds.clear();
+        mvBackupObsPoses.clear();
+    }
 };
\ No newline at end of file
@@ -128,4 +128,46 @@ namespace ORB_SLAM3
         unique_lock<mutex> lock(mMutexMap);
         mpMap = pMap;
     }
+
+    void Room::PreSave(const std::map<Wall *, int> &mWallIdx, const std::map<Door *, int> &mDoorIdx)
+    {
+        // Walls and doors of other maps are not kept
+        mvBackupWallsIdx.clear();
+        for (Wall *pWall : walls)
+        {
+            auto it = mWallIdx.find(pWall);
+            if (it != mWallIdx.end())
+                mvBackupWallsIdx.push_back(it->second);
+        }
+
+        mvBackupDoorsIdx.clear();
+        for (Door *pDoor : doors)
+        {
+            auto it = mDoorIdx.find(pDoor);
+            if (it != mDoorIdx.end())
+                mvBackupDoorsIdx.push_back(it->second);
+        }
+    }
+
+    void Room::PostLoad(const std::vector<Wall *> &vpWalls, const std::vector<Door *> &vpDoors, Map *pMap)
+    {
+        SetMap(pMap);
+
+        walls.clear();
+        for (int idx : mvBackupWallsIdx)
+        {
+            if (idx >= 0 && idx < (int)vpWalls.size())
+                walls.push_back(vpWalls[idx]);
+        }
+
+        doors.clear();
+        for (int idx : mvBackupDoorsIdx)
+        {
+            if (idx >= 0 && idx < (int)vpDoors.size() && vpDoors[idx])
+                doors.push_back(vpDoors[idx]);
+        }
+
+        mvBackupWallsIdx.clear();
+        mvBackupDoorsIdx.clear();
+    }
 }
\ No newline at end of file
@@ -115,4 +115,48 @@ namespace ORB_SLAM3
         unique_lock<mutex> lock(mMutexMap);
         mpMap = pMap;
     }
+
+    void Wall::PreSave(const std::map<Marker *, int> &mMarkerIdx, std::set<MapPoint *> &spMP)
+    {
+        mvBackupMarkersIdx.clear();
+        for (Marker *pMarker : markers)
+        {
+            auto it = mMarkerIdx.find(pMarker);
+            if (it != mMarkerIdx.end())
+                mvBackupMarkersIdx.push_back(it->second);
+        }
+
+        unique_lock<mutex> lock(mMutexPoint);
+        mvBackupMapPointsId.clear();
+        mvBackupMapPointsId.reserve(map_points.size());
+        for (MapPoint *pMP : map_points)
+        {
+            if (pMP && !pMP->isBad() && spMP.find(pMP) != spMP.end())
+                mvBackupMapPointsId.push_back(pMP->mnId);
+        }
+    }
+
+    void Wall::PostLoad(const std::vector<Marker *> &vpMarkers, std::map<long unsigned int, MapPoint *> &mpMPid, Map *pMap)
+    {
+        SetMap(pMap);
+
+        markers.clear();
+        for (int idx : mvBackupMarkersIdx)
+        {
+            if (idx >= 0 && idx < (int)vpMarkers.size())
+                markers.push_back(vpMarkers[idx]);
+        }
+
+        unique_lock<mutex> lock(mMutexPoint);
+        map_points.clear();
+        for (long unsigned int nId : mvBackupMapPointsId)
+        {
+            auto it = mpMPid.find(nId);
+            if (it != mpMPid.end())
+                map_points.insert(it->second);
+        }
+
+        mvBackupMarkersIdx.clear();
+        mvBackupMapPointsId.clear();
+    }
 }
\ No newline at end of file
@@ -38,7 +38,7 @@ namespace ORB_SLAM3
 
     System::System(const string &strVocFile, const string &strSettingsFile, const eSensor sensor,
                    const bool bUseViewer, const int initFr, const string &strSequence) : mSensor(sensor), mpViewer(static_cast<Viewer *>(NULL)), mbReset(false), mbResetActiveMap(false),
-                                                                                         mbActivateLocalizationMode(false), mbDeactivateLocalizationMode(false), mbShutDown(false)
+                                                                                         mbActivateLocalizationMode(false), mbDeactivateLocalizationMode(false), mnPipelineDepthRequest(-1), mbShutDown(false), mTrackedTimestamp(-1.0), mbTrackedImuValid(false)
     {
         // Output welcome message
         cout << endl
@@ -247,8 +247,9 @@ namespace ORB_SLAM3
         }
         else
         {
-            imLeftToFeed = imLeft.clone();
-            imRightToFeed = imRight.clone();
+            // Tracking does not keep the input images after the call, no copy is needed
+            imLeftToFeed = imLeft;
+            imRightToFeed = imRight;
         }
 
         // Check mode change
@@ -273,6 +274,11 @@ namespace ORB_SLAM3
                 mpLocalMapper->Release();
                 mbDeactivateLocalizationMode = false;
             }
+            if (mnPipelineDepthRequest >= 0)
+            {
+                mpTracker->SetPipelineDepth(mnPipelineDepthRequest);
+                mnPipelineDepthRequest = -1;
+            }
         }
 
         // Check reset
@@ -304,6 +310,9 @@ namespace ORB_SLAM3
         mTrackingState = mpTracker->mState;
         mTrackedMapPoints = mpTracker->mCurrentFrame.mvpMapPoints;
         mTrackedKeyPointsUn = mpTracker->mCurrentFrame.mvKeysUn;
+        mTrackedTimestamp = mpTracker->mTrackedTimestamp;
+        mTrackedGrabTime = mpTracker->mTrackedGrabTime;
+        StoreTrackedImuState();
 
         return Tcw;
     }
@@ -319,9 +328,9 @@ namespace ORB_SLAM3
             exit(-1);
         }
 
-        // Obtain the images
-        cv::Mat imToFeed = im.clone();
-        cv::Mat imDepthToFeed = depthmap.clone();
+        // Obtain the images without copy, Tracking does not keep the input images after the call
+        cv::Mat imToFeed = im;
+        cv::Mat imDepthToFeed = depthmap;
         if (settings_ && settings_->needToResize())
         {
             cv::Mat resizedIm;
@@ -353,6 +362,11 @@ namespace ORB_SLAM3
                 mpLocalMapper->Release();
                 mbDeactivateLocalizationMode = false;
             }
+            if (mnPipelineDepthRequest >= 0)
+            {
+                mpTracker->SetPipelineDepth(mnPipelineDepthRequest);
+                mnPipelineDepthRequest = -1;
+            }
         }
 
         // Check reset
@@ -383,6 +397,9 @@ namespace ORB_SLAM3
         mTrackingState = mpTracker->mState;
         mTrackedMapPoints = mpTracker->mCurrentFrame.mvpMapPoints;
         mTrackedKeyPointsUn = mpTracker->mCurrentFrame.mvKeysUn;
+        mTrackedTimestamp = mpTracker->mTrackedTimestamp;
+        mTrackedGrabTime = mpTracker->mTrackedGrabTime;
+        StoreTrackedImuState();
         return Tcw;
     }
 
@@ -402,7 +419,8 @@ namespace ORB_SLAM3
             exit(-1);
         }
 
-        cv::Mat imToFeed = im.clone();
+        // Obtained without copy, Tracking does not keep the input image after the call
+        cv::Mat imToFeed = im;
         if (settings_ && settings_->needToResize())
         {
             cv::Mat resizedIm;
@@ -432,6 +450,11 @@ namespace ORB_SLAM3
                 mpLocalMapper->Release();
                 mbDeactivateLocalizationMode = false;
             }
+            if (mnPipelineDepthRequest >= 0)
+            {
+                mpTracker->SetPipelineDepth(mnPipelineDepthRequest);
+                mnPipelineDepthRequest = -1;
+            }
         }
 
         // Check reset
@@ -461,6 +484,9 @@ namespace ORB_SLAM3
         mTrackingState = mpTracker->mState;
         mTrackedMapPoints = mpTracker->mCurrentFrame.mvpMapPoints;
         mTrackedKeyPointsUn = mpTracker->mCurrentFrame.mvKeysUn;
+        mTrackedTimestamp = mpTracker->mTrackedTimestamp;
+        mTrackedGrabTime = mpTracker->mTrackedGrabTime;
+        StoreTrackedImuState();
 
         return Tcw;
     }
@@ -496,6 +522,12 @@ namespace ORB_SLAM3
         mbReset = true;
     }
 
+    void System::SetTrackingPipelineDepth(int nDepth)
+    {
+        unique_lock<mutex> lock(mMutexMode);
+        mnPipelineDepthRequest = std::max(nDepth, 0);
+    }
+
     void System::ResetActiveMap()
     {
         unique_lock<mutex> lock(mMutexReset);
@@ -511,6 +543,9 @@ namespace ORB_SLAM3
 
         cout << "Shutdown" << endl;
 
+        // Frames built but not tracked yet are dropped
+        mpTracker->ClosePipeline();
+
         mpLocalMapper->RequestFinish();
         mpLoopCloser->RequestFinish();
         /*if(mpViewer)
@@ -1314,6 +1349,42 @@ namespace ORB_SLAM3
         return mTrackingState;
     }
 
+    bool System::GetTrackedFrameTime(double &timestamp, std::chrono::steady_clock::time_point &grabTime)
+    {
+        unique_lock<mutex> lock(mMutexState);
+        if (mTrackedTimestamp < 0)
+            return false;
+
+        timestamp = mTrackedTimestamp;
+        grabTime = mTrackedGrabTime;
+        return true;
+    }
+
+    bool System::GetTrackedImuState(double &timestamp, Sophus::SE3f &Twb, Eigen::Vector3f &Vwb, IMU::Bias &bias)
+    {
+        unique_lock<mutex> lock(mMutexState);
+        if (!mbTrackedImuValid)
+            return false;
+
+        timestamp = mTrackedTimestamp;
+        Twb = mTrackedTwb;
+        Vwb = mTrackedVwb;
+        bias = mTrackedImuBias;
+        return true;
+    }
+
+    void System::StoreTrackedImuState()
+    {
+        mbTrackedImuValid = (mSensor == IMU_MONOCULAR || mSensor == IMU_STEREO || mSensor == IMU_RGBD) &&
+                            mTrackingState == Tracking::OK && mpAtlas->isImuInitialized();
+        if (!mbTrackedImuValid)
+            return;
+
+        mTrackedTwb = mpTracker->mCurrentFrame.GetImuPose();
+        mTrackedVwb = mpTracker->mCurrentFrame.GetVelocity();
+        mTrackedImuBias = mpTracker->mCurrentFrame.mImuBias;
+    }
+
     vector<MapPoint *> System::GetTrackedMapPoints()
     {
         unique_lock<mutex> lock(mMutexState);
@@ -1583,6 +1654,22 @@ namespace ORB_SLAM3
         return pActiveMap->GetAllMapPoints();
     }
 
+    bool System::GetMapPointChanges(long unsigned int &nMapId, long unsigned int &nSeq, vector<MapPoint *> &vpChangedMPs,
+                                    vector<long unsigned int> &vnErasedMPIds)
+    {
+        Map *pActiveMap = mpAtlas->GetCurrentMap();
+        if (pActiveMap->GetId() != nMapId)
+        {
+            vpChangedMPs.clear();
+            vnErasedMPIds.clear();
+            nMapId = pActiveMap->GetId();
+            nSeq = pActiveMap->GetMapPointSeq();
+            return false;
+        }
+
+        return pActiveMap->GetMapPointChangesSince(nSeq, vpChangedMPs, vnErasedMPIds);
+    }
+
     vector<Sophus::SE3f> System::GetAllKeyframePoses()
     {
         vector<KeyFrame *> vpKFs = mpAtlas->GetAllKeyFrames();
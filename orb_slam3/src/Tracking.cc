@@ -372,6 +372,9 @@ namespace ORB_SLAM3
         std::cout << "Total Tracking: " << average << "$\\pm$" << deviation << std::endl;
         f << "Total Tracking: " << average << "$\\pm$" << deviation << std::endl;
 
+        std::cout << "Frame copies: " << Frame::nNumCopies << ", hand-offs: " << mnFrameHandOffs << " (" << mnFrameHandOffAllocs << " allocating)" << std::endl;
+        f << "Frame copies: " << Frame::nNumCopies << ", hand-offs: " << mnFrameHandOffs << " (" << mnFrameHandOffAllocs << " allocating)" << std::endl;
+
         // Local Mapping time stats
         std::cout << std::endl
                   << std::endl
@@ -589,6 +592,7 @@ namespace ORB_SLAM3
 
     Tracking::~Tracking()
     {
+        SetPipelineDepth(0);
         // f_track_stats.close();
     }
 
@@ -1511,162 +1515,382 @@ namespace ORB_SLAM3
         return bStepByStep;
     }
 
-    Sophus::SE3f Tracking::GrabImageStereo(const cv::Mat &imRectLeft, const cv::Mat &imRectRight, const double &timestamp, string filename)
+    int Tracking::GrayConversionCode(const cv::Mat &im)
     {
-        mImGray = imRectLeft;
-        cv::Mat imGrayRight = imRectRight;
-        mImRight = imRectRight;
+        if (im.channels() == 3)
+            return mbRGB ? cv::COLOR_RGB2GRAY : cv::COLOR_BGR2GRAY;
+        else if (im.channels() == 4)
+            return mbRGB ? cv::COLOR_RGBA2GRAY : cv::COLOR_BGRA2GRAY;
+        return -1;
+    }
 
-        if (mImGray.channels() == 3)
+    void Tracking::PrepareGrayImage(const cv::Mat &im, cv::Mat &imGray, cv::Mat &imBuffer)
+    {
+        const int code = GrayConversionCode(im);
+        if (code < 0)
         {
-            if (mbRGB)
-            {
-                cvtColor(mImGray, mImGray, cv::COLOR_RGB2GRAY);
-                cvtColor(imGrayRight, imGrayRight, cv::COLOR_RGB2GRAY);
-            }
-            else
-            {
-                cvtColor(mImGray, mImGray, cv::COLOR_BGR2GRAY);
-                cvtColor(imGrayRight, imGrayRight, cv::COLOR_BGR2GRAY);
-            }
+            imGray = im;
+            return;
         }
-        else if (mImGray.channels() == 4)
+
+        // No allocation once the buffer has the image size
+        imBuffer.create(im.size(), CV_8U);
+        cv::cvtColor(im, imBuffer, code);
+        imGray = imBuffer;
+    }
+
+    void Tracking::PrepareRGBDImages(const cv::Mat &imRGB, const cv::Mat &imD, cv::Mat &imGray, cv::Mat &imDepth,
+                                     cv::Mat &imGrayBuffer, cv::Mat &imDepthBuffer)
+    {
+        const int code = GrayConversionCode(imRGB);
+        const bool bScaleDepth = (fabs(mDepthMapFactor - 1.0f) > 1e-5) || imD.type() != CV_32F;
+
+        if (code < 0)
+            imGray = imRGB;
+        else
         {
-            if (mbRGB)
+            imGrayBuffer.create(imRGB.size(), CV_8U);
+            imGray = imGrayBuffer;
+        }
+
+        if (!bScaleDepth)
+            imDepth = imD;
+        else
+        {
+            imDepthBuffer.create(imD.size(), CV_32F);
+            imDepth = imDepthBuffer;
+        }
+
+        if (code < 0 && !bScaleDepth)
+            return;
+
+        // Color conversion and depth scaling in a single pass over row stripes, so both
+        // images are read while the stripes are in cache. Output rows are written in place.
+        const float depthFactor = mDepthMapFactor;
+        const int nRows = std::max(imRGB.rows, imD.rows);
+        cv::parallel_for_(cv::Range(0, nRows), [&](const cv::Range &range)
+                          {
+            if (code >= 0 && range.start < imRGB.rows)
             {
-                cvtColor(mImGray, mImGray, cv::COLOR_RGBA2GRAY);
-                cvtColor(imGrayRight, imGrayRight, cv::COLOR_RGBA2GRAY);
+                const int end = std::min(range.end, imRGB.rows);
+                cv::Mat grayRows = imGray.rowRange(range.start, end);
+                cv::cvtColor(imRGB.rowRange(range.start, end), grayRows, code);
             }
-            else
+            if (bScaleDepth && range.start < imD.rows)
             {
-                cvtColor(mImGray, mImGray, cv::COLOR_BGRA2GRAY);
-                cvtColor(imGrayRight, imGrayRight, cv::COLOR_BGRA2GRAY);
-            }
-        }
+                const int end = std::min(range.end, imD.rows);
+                cv::Mat depthRows = imDepth.rowRange(range.start, end);
+                imD.rowRange(range.start, end).convertTo(depthRows, CV_32F, depthFactor);
+            } });
+    }
 
-        if (mSensor == System::STEREO && !mpCamera2)
-            mCurrentFrame = Frame(mImGray, imGrayRight, timestamp, mpORBextractorLeft, mpORBextractorRight, mpORBVocabulary, mK, mDistCoef, mbf, mThDepth, mpCamera);
-        else if (mSensor == System::STEREO && mpCamera2)
-            mCurrentFrame = Frame(mImGray, imGrayRight, timestamp, mpORBextractorLeft, mpORBextractorRight, mpORBVocabulary, mK, mDistCoef, mbf, mThDepth, mpCamera, mpCamera2, mTlr);
-        else if (mSensor == System::IMU_STEREO && !mpCamera2)
-            mCurrentFrame = Frame(mImGray, imGrayRight, timestamp, mpORBextractorLeft, mpORBextractorRight, mpORBVocabulary, mK, mDistCoef, mbf, mThDepth, mpCamera, &mLastFrame, *mpImuCalib);
-        else if (mSensor == System::IMU_STEREO && mpCamera2)
-            mCurrentFrame = Frame(mImGray, imGrayRight, timestamp, mpORBextractorLeft, mpORBextractorRight, mpORBVocabulary, mK, mDistCoef, mbf, mThDepth, mpCamera, mpCamera2, mTlr, &mLastFrame, *mpImuCalib);
+    // Images wrapping external memory (e.g. shared ROS messages) are copied when the frame is built
+    // after the call returns, since the caller may release them
+    static void KeepImage(cv::Mat &im)
+    {
+        if (!im.empty() && !im.u)
+            im = im.clone();
+    }
 
-        mCurrentFrame.mNameFile = filename;
-        mCurrentFrame.mnDataset = mnNumDataset;
+    Sophus::SE3f Tracking::GrabImageStereo(const cv::Mat &imRectLeft, const cv::Mat &imRectRight, const double &timestamp, string filename)
+    {
+        const bool bPipelined = GetPipelineDepth() > 0;
+        std::shared_ptr<FrameRequest> pReq(new FrameRequest());
+        pReq->grabTime = std::chrono::steady_clock::now();
+        pReq->timestamp = timestamp;
+        pReq->filename = filename;
+        pReq->imRight = imRectRight;
 
-#ifdef REGISTER_TIMES
-        vdORBExtract_ms.push_back(mCurrentFrame.mTimeORB_Ext);
-        vdStereoMatch_ms.push_back(mCurrentFrame.mTimeStereoMatch);
-#endif
+        // Pipelined frames need their own buffers, the shared ones are reused by the next image
+        cv::Mat imGrayBuffer, imGrayRightBuffer;
+        PrepareGrayImage(imRectLeft, pReq->imGray, bPipelined ? imGrayBuffer : mImGrayBuffer);
+        PrepareGrayImage(imRectRight, pReq->imGrayRight, bPipelined ? imGrayRightBuffer : mImGrayRightBuffer);
 
-        Track();
+        if (bPipelined)
+        {
+            KeepImage(pReq->imGray);
+            KeepImage(pReq->imGrayRight);
+            KeepImage(pReq->imRight);
+            return SubmitRequest(pReq);
+        }
 
-        return mCurrentFrame.GetPose();
+        BuildFrame(*pReq);
+        return TrackRequest(*pReq);
     }
 
     Sophus::SE3f Tracking::GrabImageRGBD(const cv::Mat &imRGB, const cv::Mat &imD, const double &timestamp,
                                          string filename, const std::vector<Marker *> markers,
                                          const std::vector<Door *> doors, const std::vector<Room *> rooms)
     {
-        // Set arguments to local variables
-        env_doors = doors;
-        env_rooms = rooms;
-
-        mImGray = imRGB;
-        cv::Mat imDepth = imD;
+        const bool bPipelined = GetPipelineDepth() > 0;
+        std::shared_ptr<FrameRequest> pReq(new FrameRequest());
+        pReq->grabTime = std::chrono::steady_clock::now();
+        pReq->timestamp = timestamp;
+        pReq->filename = filename;
+        pReq->markers = markers;
+        pReq->doors = doors;
+        pReq->rooms = rooms;
 
         // [TODO] Use Depth information for better guess
+        cv::Mat imGrayBuffer, imDepthBuffer;
+        PrepareRGBDImages(imRGB, imD, pReq->imGray, pReq->imDepth, bPipelined ? imGrayBuffer : mImGrayBuffer,
+                          bPipelined ? imDepthBuffer : mImDepthBuffer);
 
-        if (mImGray.channels() == 3)
+        if (bPipelined)
         {
-            if (mbRGB)
-                cvtColor(mImGray, mImGray, cv::COLOR_RGB2GRAY);
-            else
-                cvtColor(mImGray, mImGray, cv::COLOR_BGR2GRAY);
+            KeepImage(pReq->imGray);
+            KeepImage(pReq->imDepth);
+
+            // The caller reuses its marker objects for the next images, the request keeps a copy
+            for (size_t i = 0; i < markers.size(); i++)
+            {
+                std::shared_ptr<Marker> pMarker(new Marker());
+                pMarker->setOpId(markers[i]->getOpId());
+                pMarker->setId(markers[i]->getId());
+                pMarker->setTime(markers[i]->getTime());
+                pMarker->setMarkerInGMap(markers[i]->isMarkerInGMap());
+                pMarker->setLocalPose(markers[i]->getLocalPose());
+                pMarker->setGlobalPose(markers[i]->getGlobalPose());
+                pReq->vpMarkerCopies.push_back(pMarker);
+                pReq->markers[i] = pMarker.get();
+            }
+
+            return SubmitRequest(pReq);
+        }
+
+        BuildFrame(*pReq);
+        return TrackRequest(*pReq);
+    }
+
+    Sophus::SE3f Tracking::GrabImageMonocular(const cv::Mat &im, const double &timestamp, string filename)
+    {
+        const bool bPipelined = GetPipelineDepth() > 0;
+        std::shared_ptr<FrameRequest> pReq(new FrameRequest());
+        pReq->grabTime = std::chrono::steady_clock::now();
+        pReq->timestamp = timestamp;
+        pReq->filename = filename;
+
+        cv::Mat imGrayBuffer;
+        PrepareGrayImage(im, pReq->imGray, bPipelined ? imGrayBuffer : mImGrayBuffer);
+
+        // When pipelined, the extractor is chosen from the state before the previous frames are tracked,
+        // so the first frame after the initialization may still use the initialization extractor
+        pReq->pExtractor = mpORBextractorLeft;
+        if (mSensor == System::MONOCULAR)
+        {
+            if (mState == NOT_INITIALIZED || mState == NO_IMAGES_YET || (lastID - initID) < mMaxFrames)
+                pReq->pExtractor = mpIniORBextractor;
         }
-        else if (mImGray.channels() == 4)
+        else if (mSensor == System::IMU_MONOCULAR)
         {
-            if (mbRGB)
-                cvtColor(mImGray, mImGray, cv::COLOR_RGBA2GRAY);
-            else
-                cvtColor(mImGray, mImGray, cv::COLOR_BGRA2GRAY);
+            if (mState == NOT_INITIALIZED || mState == NO_IMAGES_YET)
+                pReq->pExtractor = mpIniORBextractor;
         }
 
-        if ((fabs(mDepthMapFactor - 1.0f) > 1e-5) || imDepth.type() != CV_32F)
-            imDepth.convertTo(imDepth, CV_32F, mDepthMapFactor);
+        if (bPipelined)
+        {
+            KeepImage(pReq->imGray);
+            return SubmitRequest(pReq);
+        }
 
+        BuildFrame(*pReq);
+        return TrackRequest(*pReq);
+    }
+
+    void Tracking::BuildFrame(FrameRequest &req)
+    {
+        // The previous frame is linked in TrackRequest(), it may not be tracked yet
+        if (mSensor == System::STEREO && !mpCamera2)
+            req.frame = Frame(req.imGray, req.imGrayRight, req.timestamp, mpORBextractorLeft, mpORBextractorRight, mpORBVocabulary, mK, mDistCoef, mbf, mThDepth, mpCamera);
+        else if (mSensor == System::STEREO && mpCamera2)
+            req.frame = Frame(req.imGray, req.imGrayRight, req.timestamp, mpORBextractorLeft, mpORBextractorRight, mpORBVocabulary, mK, mDistCoef, mbf, mThDepth, mpCamera, mpCamera2, mTlr);
+        else if (mSensor == System::IMU_STEREO && !mpCamera2)
+            req.frame = Frame(req.imGray, req.imGrayRight, req.timestamp, mpORBextractorLeft, mpORBextractorRight, mpORBVocabulary, mK, mDistCoef, mbf, mThDepth, mpCamera, NULL, *mpImuCalib);
+        else if (mSensor == System::IMU_STEREO && mpCamera2)
+            req.frame = Frame(req.imGray, req.imGrayRight, req.timestamp, mpORBextractorLeft, mpORBextractorRight, mpORBVocabulary, mK, mDistCoef, mbf, mThDepth, mpCamera, mpCamera2, mTlr, NULL, *mpImuCalib);
         // RGB-D
-        if (mSensor == System::RGBD)
-            mCurrentFrame = Frame(mImGray, imDepth, timestamp, mpORBextractorLeft, mpORBVocabulary, mK,
-                                  mDistCoef, mbf, mThDepth, mpCamera, NULL, IMU::Calib(), markers);
+        else if (mSensor == System::RGBD)
+            req.frame = Frame(req.imGray, req.imDepth, req.timestamp, mpORBextractorLeft, mpORBVocabulary, mK,
+                              mDistCoef, mbf, mThDepth, mpCamera, NULL, IMU::Calib(), req.markers);
         // RGB-D Intertial
         else if (mSensor == System::IMU_RGBD)
-            mCurrentFrame = Frame(mImGray, imDepth, timestamp, mpORBextractorLeft, mpORBVocabulary, mK,
-                                  mDistCoef, mbf, mThDepth, mpCamera, &mLastFrame, *mpImuCalib, markers);
+            req.frame = Frame(req.imGray, req.imDepth, req.timestamp, mpORBextractorLeft, mpORBVocabulary, mK,
+                              mDistCoef, mbf, mThDepth, mpCamera, NULL, *mpImuCalib, req.markers);
+        else if (mSensor == System::MONOCULAR)
+            req.frame = Frame(req.imGray, req.timestamp, req.pExtractor, mpORBVocabulary, mpCamera, mDistCoef, mbf, mThDepth);
+        else if (mSensor == System::IMU_MONOCULAR)
+            req.frame = Frame(req.imGray, req.timestamp, req.pExtractor, mpORBVocabulary, mpCamera, mDistCoef, mbf, mThDepth, NULL, *mpImuCalib);
+
+        req.frame.mNameFile = req.filename;
+    }
+
+    Sophus::SE3f Tracking::TrackRequest(FrameRequest &req)
+    {
+        mCurrentFrame = std::move(req.frame);
+        if (mSensor == System::IMU_STEREO || mSensor == System::IMU_RGBD || mSensor == System::IMU_MONOCULAR)
+            mCurrentFrame.SetPrevFrame(&mLastFrame);
+
+        mImGray = req.imGray;
+        // Copied markers live as long as the frame is the current one
+        mvpCurrentMarkerCopies = req.vpMarkerCopies;
+        if (mSensor == System::STEREO || mSensor == System::IMU_STEREO)
+            mImRight = req.imRight;
+        if (mSensor == System::RGBD || mSensor == System::IMU_RGBD)
+        {
+            // Set arguments to local variables
+            env_doors = req.doors;
+            env_rooms = req.rooms;
+        }
+
+        if ((mSensor == System::MONOCULAR || mSensor == System::IMU_MONOCULAR) && mState == NO_IMAGES_YET)
+            t0 = req.timestamp;
 
-        mCurrentFrame.mNameFile = filename;
         mCurrentFrame.mnDataset = mnNumDataset;
 
 #ifdef REGISTER_TIMES
         vdORBExtract_ms.push_back(mCurrentFrame.mTimeORB_Ext);
+        if (mSensor == System::STEREO || mSensor == System::IMU_STEREO)
+            vdStereoMatch_ms.push_back(mCurrentFrame.mTimeStereoMatch);
 #endif
 
+        if (mSensor == System::MONOCULAR || mSensor == System::IMU_MONOCULAR)
+            lastID = mCurrentFrame.mnId;
         Track();
 
+        mTrackedTimestamp = req.timestamp;
+        mTrackedGrabTime = req.grabTime;
+
         return mCurrentFrame.GetPose();
     }
 
-    Sophus::SE3f Tracking::GrabImageMonocular(const cv::Mat &im, const double &timestamp, string filename)
+    void Tracking::SetPipelineDepth(int nDepth)
     {
-        mImGray = im;
-        if (mImGray.channels() == 3)
+        nDepth = std::max(nDepth, 0);
+
+        thread *ptFrameBuilder = nullptr;
         {
-            if (mbRGB)
-                cvtColor(mImGray, mImGray, cv::COLOR_RGB2GRAY);
-            else
-                cvtColor(mImGray, mImGray, cv::COLOR_BGR2GRAY);
+            unique_lock<mutex> lock(mMutexPipeline);
+            if (nDepth == mnPipelineDepth || (nDepth > 0 && mbPipelineClosed))
+                return;
+
+            // With a smaller depth the frames waiting in excess are tracked on the next image
+            mnPipelineDepth = nDepth;
+
+            if (nDepth == 0)
+                std::swap(ptFrameBuilder, mptFrameBuilder);
+            else if (!mptFrameBuilder)
+                mptFrameBuilder = new thread(&Tracking::RunFrameBuilder, this);
         }
-        else if (mImGray.channels() == 4)
+
+        if (ptFrameBuilder)
         {
-            if (mbRGB)
-                cvtColor(mImGray, mImGray, cv::COLOR_RGBA2GRAY);
-            else
-                cvtColor(mImGray, mImGray, cv::COLOR_BGRA2GRAY);
+            ClearPipeline();
+            {
+                unique_lock<mutex> lock(mMutexPipeline);
+                mbFinishFrameBuilder = true;
+            }
+            mcvPipeline.notify_all();
+            ptFrameBuilder->join();
+            delete ptFrameBuilder;
+
+            unique_lock<mutex> lock(mMutexPipeline);
+            mbFinishFrameBuilder = false;
         }
+    }
 
-        if (mSensor == System::MONOCULAR)
+    int Tracking::GetPipelineDepth()
+    {
+        unique_lock<mutex> lock(mMutexPipeline);
+        return mnPipelineDepth;
+    }
+
+    void Tracking::ClosePipeline()
+    {
         {
-            if (mState == NOT_INITIALIZED || mState == NO_IMAGES_YET || (lastID - initID) < mMaxFrames)
-                mCurrentFrame = Frame(mImGray, timestamp, mpIniORBextractor, mpORBVocabulary, mpCamera, mDistCoef, mbf, mThDepth);
-            else
-                mCurrentFrame = Frame(mImGray, timestamp, mpORBextractorLeft, mpORBVocabulary, mpCamera, mDistCoef, mbf, mThDepth);
+            unique_lock<mutex> lock(mMutexPipeline);
+            mbPipelineClosed = true;
         }
-        else if (mSensor == System::IMU_MONOCULAR)
+        // Wakes up a tracking thread waiting for a built frame, then stops the builder
+        mcvPipeline.notify_all();
+        SetPipelineDepth(0);
+    }
+
+    Sophus::SE3f Tracking::SubmitRequest(const std::shared_ptr<FrameRequest> &pReq)
+    {
+        Sophus::SE3f Tcw = mCurrentFrame.GetPose();
         {
-            if (mState == NOT_INITIALIZED || mState == NO_IMAGES_YET)
+            unique_lock<mutex> lock(mMutexPipeline);
+            if (mbPipelineClosed)
+                return Tcw;
+            mlPendingRequests.push_back(pReq);
+        }
+        mcvPipeline.notify_all();
+
+        while (true)
+        {
+            std::shared_ptr<FrameRequest> pBuilt;
             {
-                mCurrentFrame = Frame(mImGray, timestamp, mpIniORBextractor, mpORBVocabulary, mpCamera, mDistCoef, mbf, mThDepth, &mLastFrame, *mpImuCalib);
+                unique_lock<mutex> lock(mMutexPipeline);
+
+                // Frames waiting to be tracked, including the ones still queued or being built
+                const size_t nWaiting = mlPendingRequests.size() + mlBuiltRequests.size() + (mbBuildingFrame ? 1 : 0);
+                if (mbPipelineClosed || (int)nWaiting <= mnPipelineDepth)
+                    break;
+
+                // The pipeline may be closed (and cleared) by System::Shutdown meanwhile
+                mcvPipeline.wait(lock, [&]
+                                 { return mbPipelineClosed || !mlBuiltRequests.empty(); });
+                if (mlBuiltRequests.empty())
+                    break;
+                pBuilt = mlBuiltRequests.front();
+                mlBuiltRequests.pop_front();
             }
-            else
-                mCurrentFrame = Frame(mImGray, timestamp, mpORBextractorLeft, mpORBVocabulary, mpCamera, mDistCoef, mbf, mThDepth, &mLastFrame, *mpImuCalib);
+
+            // The next frames are built meanwhile
+            Tcw = TrackRequest(*pBuilt);
         }
 
-        if (mState == NO_IMAGES_YET)
-            t0 = timestamp;
+        return Tcw;
+    }
 
-        mCurrentFrame.mNameFile = filename;
-        mCurrentFrame.mnDataset = mnNumDataset;
+    void Tracking::RunFrameBuilder()
+    {
+        while (true)
+        {
+            std::shared_ptr<FrameRequest> pReq;
+            {
+                unique_lock<mutex> lock(mMutexPipeline);
+                mcvPipeline.wait(lock, [&]
+                                 { return mbFinishFrameBuilder || !mlPendingRequests.empty(); });
+                if (mbFinishFrameBuilder)
+                    return;
 
-#ifdef REGISTER_TIMES
-        vdORBExtract_ms.push_back(mCurrentFrame.mTimeORB_Ext);
-#endif
+                pReq = mlPendingRequests.front();
+                mlPendingRequests.pop_front();
+                mbBuildingFrame = true;
+            }
 
-        lastID = mCurrentFrame.mnId;
-        Track();
+            BuildFrame(*pReq);
 
-        return mCurrentFrame.GetPose();
+            {
+                unique_lock<mutex> lock(mMutexPipeline);
+                mlBuiltRequests.push_back(pReq);
+                mbBuildingFrame = false;
+            }
+            mcvPipeline.notify_all();
+        }
+    }
+
+    void Tracking::ClearPipeline()
+    {
+        unique_lock<mutex> lock(mMutexPipeline);
+        mlPendingRequests.clear();
+        mcvPipeline.wait(lock, [&]
+                         { return !mbBuildingFrame; });
+
+        if (!mlBuiltRequests.empty())
+            Verbose::PrintMess("Dropping " + to_string(mlBuiltRequests.size()) + " frames not tracked yet", Verbose::VERBOSITY_NORMAL);
+        mlBuiltRequests.clear();
     }
 
     void Tracking::GrabImuData(const IMU::Point &imuMeasurement)
@@ -1848,6 +2072,13 @@ namespace ORB_SLAM3
         // TODO To implement...
     }
 
+    void Tracking::HandOffLastFrame()
+    {
+        mnFrameHandOffs++;
+        if (mLastFrame.Recycle(mCurrentFrame))
+            mnFrameHandOffAllocs++;
+    }
+
     void Tracking::Track()
     {
 
@@ -1964,7 +2195,7 @@ namespace ORB_SLAM3
 
             if (mState != OK) // If rightly initialized, mState=OK
             {
-                mLastFrame = Frame(mCurrentFrame);
+                HandOffLastFrame();
                 return;
             }
 
@@ -2213,19 +2444,6 @@ namespace ORB_SLAM3
                 //}
             }
 
-            // Save frame if recent relocalization, since they are used for IMU reset (as we are making copy, it shluld be once mCurrFrame is completely modified)
-            if ((mCurrentFrame.mnId < (mnLastRelocFrameId + mnFramesToResetIMU)) && (mCurrentFrame.mnId > mnFramesToResetIMU) &&
-                (mSensor == System::IMU_MONOCULAR || mSensor == System::IMU_STEREO || mSensor == System::IMU_RGBD) && pCurrentMap->isImuInitialized())
-            {
-                // TODO check this situation
-                Verbose::PrintMess("Saving pointer to frame. imu needs reset...", Verbose::VERBOSITY_NORMAL);
-                Frame *pF = new Frame(mCurrentFrame);
-                pF->mpPrevFrame = new Frame(mLastFrame);
-
-                // Load preintegration
-                pF->mpImuPreintegratedFrame = new IMU::Preintegrated(mCurrentFrame.mpImuPreintegratedFrame);
-            }
-
             if (pCurrentMap->isImuInitialized())
             {
                 if (bOK)
@@ -2342,7 +2560,7 @@ namespace ORB_SLAM3
             if (!mCurrentFrame.mpReferenceKF)
                 mCurrentFrame.mpReferenceKF = mpReferenceKF;
 
-            mLastFrame = Frame(mCurrentFrame);
+            HandOffLastFrame();
         }
 
         if (mState == OK || mState == RECENTLY_LOST)
@@ -2515,14 +2733,14 @@ namespace ORB_SLAM3
                     else
                     {
                         // The wall already exists in the map, fetching that one
-                        updateMapWall(matchedWallId, mCurrentMarker, pKFini);
+                        updateMapWall(matchedWallId, currentMapMarker, pKFini);
                     }
                 }
                 else
                 {
                     // The current marker is placed on a door
                     std::string doorName = result.second;
-                    createMapDoor(mCurrentMarker, pKFini, doorName);
+                    createMapDoor(currentMapMarker, pKFini, doorName);
                 }
             }
 
@@ -2536,13 +2754,14 @@ namespace ORB_SLAM3
 
             mpLocalMapper->InsertKeyFrame(pKFini);
 
-            mLastFrame = Frame(mCurrentFrame);
+            HandOffLastFrame();
             mnLastKeyFrameId = mCurrentFrame.mnId;
             mpLastKeyFrame = pKFini;
             // mnLastRelocFrameId = mCurrentFrame.mnId;
 
             mvpLocalKeyFrames.push_back(pKFini);
             mvpLocalMapPoints = mpAtlas->GetAllMapPoints();
+            mLocalMapCache.Clear();
             mpReferenceKF = pKFini;
             mCurrentFrame.mpReferenceKF = pKFini;
 
@@ -2564,8 +2783,8 @@ namespace ORB_SLAM3
             // Set Reference Frame
             if (mCurrentFrame.mvKeys.size() > 100)
             {
-                mInitialFrame = Frame(mCurrentFrame);
-                mLastFrame = Frame(mCurrentFrame);
+                mInitialFrame = mCurrentFrame;
+                HandOffLastFrame();
                 mvbPrevMatched.resize(mCurrentFrame.mvKeysUn.size());
                 for (size_t i = 0; i < mCurrentFrame.mvKeysUn.size(); i++)
                     mvbPrevMatched[i] = mCurrentFrame.mvKeysUn[i].pt;
@@ -2740,6 +2959,7 @@ namespace ORB_SLAM3
         mvpLocalKeyFrames.push_back(pKFcur);
         mvpLocalKeyFrames.push_back(pKFini);
         mvpLocalMapPoints = mpAtlas->GetAllMapPoints();
+        mLocalMapCache.Clear();
         mpReferenceKF = pKFcur;
         mCurrentFrame.mpReferenceKF = pKFcur;
 
@@ -2753,7 +2973,7 @@ namespace ORB_SLAM3
         double aux = (mCurrentFrame.mTimeStamp - mLastFrame.mTimeStamp) / (mCurrentFrame.mTimeStamp - mInitialFrame.mTimeStamp);
         phi *= aux;
 
-        mLastFrame = Frame(mCurrentFrame);
+        HandOffLastFrame();
 
         mpAtlas->SetReferenceMapPoints(mvpLocalMapPoints);
 
@@ -3432,92 +3652,75 @@ namespace ORB_SLAM3
                         nPoints++;
                     }
 
-                    // check if the marker ids fromt he current frame exist in all the previous keyframes
-                    // first get the mapped marker from the keyframes
-                    for (const auto currentMapMarker : mpAtlas->GetAllMarkers())
+                    if (vDepthIdx[j].first > mThDepth && nPoints > maxPoint)
                     {
-                        // Check if the marker is already in the Global map
-                        for (auto currentFrameMaker : mCurrentFrame.mvpMapMarkers)
-                        {
-                            if (currentFrameMaker->getId() == currentMapMarker->getId())
-                                currentFrameMaker->setMarkerInGMap(true);
-                        }
+                        break;
                     }
+                }
 
-                    // Add Markers while progressing in KFs
-                    for (Marker *mCurrentMarker : mCurrentFrame.mvpMapMarkers)
+                // Add Markers while progressing in KFs (once per KF, after its map points are created)
+                for (Marker *mCurrentMarker : mCurrentFrame.mvpMapMarkers)
+                {
+                    // Check if the marker is already in the Global map
+                    ORB_SLAM3::Marker *currentMapMarker = mpAtlas->GetMarkerById(mCurrentMarker->getId());
+                    if (!currentMapMarker)
                     {
-                        ORB_SLAM3::Marker *currentMapMarker;
-                        if (!mCurrentMarker->isMarkerInGMap())
-                        {
-                            mCurrentMarker->SetMap(mpAtlas->GetCurrentMap());
-                            mCurrentMarker->setGlobalPose(pKF->GetPoseInverse() * mCurrentMarker->getLocalPose());
-                            mCurrentMarker->setMarkerInGMap(true);
+                        mCurrentMarker->SetMap(mpAtlas->GetCurrentMap());
+                        mCurrentMarker->setGlobalPose(pKF->GetPoseInverse() * mCurrentMarker->getLocalPose());
+                        mCurrentMarker->setMarkerInGMap(true);
 
-                            // Creating a new marker in the map
-                            currentMapMarker = createMapMarker(mCurrentMarker, pKF);
-                        }
-                        else
-                        {
-                            for (auto currentMapMarkerAtlas : mpAtlas->GetAllMarkers())
-                            {
-                                if (currentMapMarkerAtlas->getId() == mCurrentMarker->getId())
-                                {
-                                    currentMapMarker = currentMapMarkerAtlas;
-                                    currentMapMarker->addObservation(pKF, mCurrentMarker->getLocalPose());
-                                }
-                            }
-                        }
+                        // Creating a new marker in the map
+                        currentMapMarker = createMapMarker(mCurrentMarker, pKF);
+                    }
+                    else
+                    {
+                        mCurrentMarker->setMarkerInGMap(true);
+                        currentMapMarker->addObservation(pKF, mCurrentMarker->getLocalPose());
+                    }
 
-                        // ----------- Wall and Door Detection and Mapping --------
-                        // Check the current marker if it is attached to a door or a wall
-                        std::pair<bool, std::string> result = markerIsPlacedOnWall(currentMapMarker->getId());
-                        bool markerIsWall = result.first;
-                        if (markerIsWall)
+                    // ----------- Wall and Door Detection and Mapping --------
+                    // Check the current marker if it is attached to a door or a wall
+                    std::pair<bool, std::string> result = markerIsPlacedOnWall(currentMapMarker->getId());
+                    bool markerIsWall = result.first;
+                    if (markerIsWall)
+                    {
+                        // Calculate the plane (wall) equation on which the marker is attached
+                        Eigen::Vector4d planeEstimate =
+                            getPlaneEquationFromPose(currentMapMarker->getGlobalPose().rotationMatrix(),
+                                                     currentMapMarker->getGlobalPose().translation());
+
+                        // Calculate the wall equation from points lying close to the marker
+                        // Eigen::Vector4d planeEstimatefromPoint;
+                        // bool gotPlaneEstimate = getPlaneEquationFromPoints(mCurrentMarker, planeEstimatefromPoint);
+
+                        // Get the plane based on the equation
+                        g2o::Plane3D detectedPlane(planeEstimate);
+                        // The current marker is placed on a wall
+                        // Check if we need to add the wall to the map or not
+                        int matchedWallId = associateWalls(mpAtlas->GetAllWalls(), detectedPlane);
+                        if (matchedWallId == -1)
                         {
-                            // Calculate the plane (wall) equation on which the marker is attached
-                            Eigen::Vector4d planeEstimate =
-                                getPlaneEquationFromPose(currentMapMarker->getGlobalPose().rotationMatrix(),
-                                                         currentMapMarker->getGlobalPose().translation());
-
-                            // Calculate the wall equation from points lying close to the marker
-                            // Eigen::Vector4d planeEstimatefromPoint;
-                            // bool gotPlaneEstimate = getPlaneEquationFromPoints(mCurrentMarker, planeEstimatefromPoint);
-
-                            // Get the plane based on the equation
-                            g2o::Plane3D detectedPlane(planeEstimate);
-                            // The current marker is placed on a wall
-                            // Check if we need to add the wall to the map or not
-                            int matchedWallId = associateWalls(mpAtlas->GetAllWalls(), detectedPlane);
-                            if (matchedWallId == -1)
-                            {
-                                // A wall with the same equation was not found in the map, creating a new one
-                                createMapWall(currentMapMarker, detectedPlane, pKF);
-                            }
-                            else
-                            {
-                                // The wall already exists in the map, fetching that one
-                                updateMapWall(matchedWallId, currentMapMarker, pKF);
-                            }
+                            // A wall with the same equation was not found in the map, creating a new one
+                            createMapWall(currentMapMarker, detectedPlane, pKF);
                         }
                         else
                         {
-                            // The current marker is placed on a door
-                            std::string doorName = result.second;
-                            createMapDoor(mCurrentMarker, pKF, doorName);
+                            // The wall already exists in the map, fetching that one
+                            updateMapWall(matchedWallId, currentMapMarker, pKF);
                         }
                     }
-
-                    // ----------- Room Detection and Mapping --------
-                    // Early creation of a room as soon as all elements of at least one of its pairs has been seen
-                    currentFoundRooms = earlyRoomDetection(mCurrentFrame.mvpMapMarkers);
-
-                    if (vDepthIdx[j].first > mThDepth && nPoints > maxPoint)
+                    else
                     {
-                        break;
+                        // The current marker is placed on a door
+                        std::string doorName = result.second;
+                        createMapDoor(currentMapMarker, pKF, doorName);
                     }
                 }
 
+                // ----------- Room Detection and Mapping --------
+                // Early creation of a room as soon as all elements of at least one of its pairs has been seen
+                currentFoundRooms = earlyRoomDetection(mCurrentFrame.mvpMapMarkers);
+
                 // Verbose::PrintMess("new mps for stereo KF: " + to_string(nPoints), Verbose::VERBOSITY_NORMAL);
             }
         }
@@ -3558,23 +3761,65 @@ namespace ORB_SLAM3
         int nToMatch = 0;
 
         // Project points in frame and check its visibility
-        for (vector<MapPoint *>::iterator vit = mvpLocalMapPoints.begin(), vend = mvpLocalMapPoints.end(); vit != vend; vit++)
+        if (mCurrentFrame.Nleft == -1)
         {
-            MapPoint *pMP = *vit;
+            // All the local points are projected at once over a snapshot of their geometry
+            const MapPointGeometry &geometry = mLocalMapCache.UpdateGeometry(mvpLocalMapPoints);
+            mCurrentFrame.isInFrustum(geometry, 0.5, mLocalPointsFrustum);
+            const FrustumTest &test = mLocalPointsFrustum;
 
-            if (pMP->mnLastFrameSeen == mCurrentFrame.mnId)
-                continue;
-            if (pMP->isBad())
-                continue;
-            // Project (this fills MapPoint variables for matching)
-            if (mCurrentFrame.isInFrustum(pMP, 0.5))
+            for (size_t i = 0, iend = mvpLocalMapPoints.size(); i < iend; i++)
             {
+                MapPoint *pMP = mvpLocalMapPoints[i];
+
+                if (pMP->mnLastFrameSeen == mCurrentFrame.mnId)
+                    continue;
+                if (pMP->isBad())
+                    continue;
+
+                // Fill MapPoint variables for matching
+                if (!test.vbInView[i])
+                {
+                    pMP->mbTrackInView = false;
+                    pMP->mTrackProjX = test.vbInImage[i] ? test.vU[i] : -1;
+                    pMP->mTrackProjY = test.vbInImage[i] ? test.vV[i] : -1;
+                    continue;
+                }
+
+                pMP->mbTrackInView = true;
+                pMP->mTrackProjX = test.vU[i];
+                pMP->mTrackProjXR = test.vUr[i];
+                pMP->mTrackDepth = test.vDepth[i];
+                pMP->mTrackProjY = test.vV[i];
+                pMP->mnTrackScaleLevel = test.vLevel[i];
+                pMP->mTrackViewCos = test.vViewCos[i];
+
                 pMP->IncreaseVisible();
                 nToMatch++;
+
+                mCurrentFrame.mmProjectPoints[pMP->mnId] = cv::Point2f(pMP->mTrackProjX, pMP->mTrackProjY);
             }
-            if (pMP->mbTrackInView)
+        }
+        else
+        {
+            for (vector<MapPoint *>::iterator vit = mvpLocalMapPoints.begin(), vend = mvpLocalMapPoints.end(); vit != vend; vit++)
             {
-                mCurrentFrame.mmProjectPoints[pMP->mnId] = cv::Point2f(pMP->mTrackProjX, pMP->mTrackProjY);
+                MapPoint *pMP = *vit;
+
+                if (pMP->mnLastFrameSeen == mCurrentFrame.mnId)
+                    continue;
+                if (pMP->isBad())
+                    continue;
+                // Project (this fills MapPoint variables for matching)
+                if (mCurrentFrame.isInFrustum(pMP, 0.5))
+                {
+                    pMP->IncreaseVisible();
+                    nToMatch++;
+                }
+                if (pMP->mbTrackInView)
+                {
+                    mCurrentFrame.mmProjectPoints[pMP->mnId] = cv::Point2f(pMP->mTrackProjX, pMP->mTrackProjY);
+                }
             }
         }
 
@@ -3619,81 +3864,19 @@ namespace ORB_SLAM3
 
     void Tracking::UpdateLocalPoints()
     {
-        mvpLocalMapPoints.clear();
-
-        int count_pts = 0;
-
-        for (vector<KeyFrame *>::const_reverse_iterator itKF = mvpLocalKeyFrames.rbegin(), itEndKF = mvpLocalKeyFrames.rend(); itKF != itEndKF; ++itKF)
-        {
-            KeyFrame *pKF = *itKF;
-            const vector<MapPoint *> vpMPs = pKF->GetMapPointMatches();
-
-            for (vector<MapPoint *>::const_iterator itMP = vpMPs.begin(), itEndMP = vpMPs.end(); itMP != itEndMP; itMP++)
-            {
-
-                MapPoint *pMP = *itMP;
-                if (!pMP)
-                    continue;
-                if (pMP->mnTrackReferenceForFrame == mCurrentFrame.mnId)
-                    continue;
-                if (!pMP->isBad())
-                {
-                    count_pts++;
-                    mvpLocalMapPoints.push_back(pMP);
-                    pMP->mnTrackReferenceForFrame = mCurrentFrame.mnId;
-                }
-            }
-        }
+        mLocalMapCache.UpdateLocalPoints(mvpLocalKeyFrames, mCurrentFrame.mnId, mvpLocalMapPoints);
     }
 
     void Tracking::UpdateLocalKeyFrames()
     {
-        // Each map point vote for the keyframes in which it has been observed
-        map<KeyFrame *, int> keyframeCounter;
+        // Each map point vote for the keyframes in which it has been observed. The votes are kept between
+        // frames and only updated with the points that changed
+        const map<KeyFrame *, int> *pKeyframeCounter;
         if (!mpAtlas->isImuInitialized() || (mCurrentFrame.mnId < mnLastRelocFrameId + 2))
-        {
-            for (int i = 0; i < mCurrentFrame.N; i++)
-            {
-                MapPoint *pMP = mCurrentFrame.mvpMapPoints[i];
-                if (pMP)
-                {
-                    if (!pMP->isBad())
-                    {
-                        const map<KeyFrame *, tuple<int, int>> observations = pMP->GetObservations();
-                        for (map<KeyFrame *, tuple<int, int>>::const_iterator it = observations.begin(), itend = observations.end(); it != itend; it++)
-                            keyframeCounter[it->first]++;
-                    }
-                    else
-                    {
-                        mCurrentFrame.mvpMapPoints[i] = NULL;
-                    }
-                }
-            }
-        }
-        else
-        {
-            for (int i = 0; i < mLastFrame.N; i++)
-            {
-                // Using lastframe since current frame has not matches yet
-                if (mLastFrame.mvpMapPoints[i])
-                {
-                    MapPoint *pMP = mLastFrame.mvpMapPoints[i];
-                    if (!pMP)
-                        continue;
-                    if (!pMP->isBad())
-                    {
-                        const map<KeyFrame *, tuple<int, int>> observations = pMP->GetObservations();
-                        for (map<KeyFrame *, tuple<int, int>>::const_iterator it = observations.begin(), itend = observations.end(); it != itend; it++)
-                            keyframeCounter[it->first]++;
-                    }
-                    else
-                    {
-                        // MODIFICATION
-                        mLastFrame.mvpMapPoints[i] = NULL;
-                    }
-                }
-            }
-        }
+            pKeyframeCounter = &mLocalMapCache.UpdateKeyFrameVotes(mCurrentFrame.mvpMapPoints);
+        else // Using lastframe since current frame has not matches yet
+            pKeyframeCounter = &mLocalMapCache.UpdateKeyFrameVotes(mLastFrame.mvpMapPoints);
+        const map<KeyFrame *, int> &keyframeCounter = *pKeyframeCounter;
 
         int max = 0;
         KeyFrame *pKFmax = static_cast<KeyFrame *>(NULL);
@@ -3970,6 +4153,9 @@ namespace ORB_SLAM3
     {
         Verbose::PrintMess("System Reseting", Verbose::VERBOSITY_NORMAL);
 
+        // Frames built before the reset would keep their old ids
+        ClearPipeline();
+
         if (mpViewer)
         {
             mpViewer->RequestStop();
@@ -3997,6 +4183,7 @@ namespace ORB_SLAM3
 
         // Clear Map (this erase MapPoints and KeyFrames)
         mpAtlas->clearAtlas();
+        mLocalMapCache.Clear();
         mpAtlas->CreateNewMap();
         if (mSensor == System::IMU_STEREO || mSensor == System::IMU_MONOCULAR || mSensor == System::IMU_RGBD)
             mpAtlas->SetInertialSensor();
@@ -4029,6 +4216,9 @@ namespace ORB_SLAM3
     void Tracking::ResetActiveMap(bool bLocMap)
     {
         Verbose::PrintMess("Active map Reseting", Verbose::VERBOSITY_NORMAL);
+
+        // The last frame id is read below, no frame can be under construction
+        ClearPipeline();
         if (mpViewer)
         {
             mpViewer->RequestStop();
@@ -4057,6 +4247,7 @@ namespace ORB_SLAM3
 
         // Clear Map (this erase MapPoints and KeyFrames)
         mpAtlas->clearMap();
+        mLocalMapCache.Clear();
 
         // KeyFrame::nNextId = mpAtlas->GetLastInitKFid();
         // Frame::nNextId = mnLastInitFrameId;
@@ -4431,8 +4622,7 @@ namespace ORB_SLAM3
 
     bool Tracking::getPlaneEquationFromPoints(const Marker *currentMarker, Eigen::Vector4d &planeEstimate)
     {
-        std::vector<MapPoint *> allmapPoints = mpAtlas->GetAllMapPoints();
-        std::vector<MapPoint *> closePoints = findPointsCloseToLocation(allmapPoints, currentMarker->getGlobalPose().translation(), 0.1);
+        std::vector<MapPoint *> closePoints = mpAtlas->GetMapPointsInRadius(currentMarker->getGlobalPose().translation(), 0.1);
 
         if (closePoints.size() > 5)
         {
@@ -4486,32 +4676,6 @@ namespace ORB_SLAM3
         return plane_equation;
     }
 
-    std::vector<MapPoint *> Tracking::findPointsCloseToLocation(const std::vector<MapPoint *> &points,
-                                                                const Eigen::Vector3f &location,
-                                                                double distanceThreshold)
-    {
-        std::vector<MapPoint *> closePoints;
-        for (MapPoint *point : points)
-        {
-            double distance = calculateDistance(point->GetWorldPos(), location);
-            if (distance <= distanceThreshold)
-            {
-                closePoints.push_back(point);
-            }
-        }
-
-        return closePoints;
-    }
-
-    // Function to calculate Euclidean distance between two points
-    double Tracking::calculateDistance(const Eigen::Vector3f &p1, const Eigen::Vector3f &p2)
-    {
-        double dx = p1.x() - p2.x();
-        double dy = p1.y() - p2.y();
-        double dz = p1.z() - p2.z();
-        return std::sqrt(dx * dx + dy * dy + dz * dz);
-    }
-
     std::pair<bool, std::string> Tracking::markerIsPlacedOnWall(const int &markerId)
     {
         bool isWall = true;
@@ -4562,8 +4726,8 @@ namespace ORB_SLAM3
         std::cout << "Adding new wall: Wall#" << newMapWall->getId() << " with Equation " << newMapWall->getPlaneEquation().coeffs() << ", with Marker#"
                   << attachedMarker->getId() << " attached on it!" << std::endl;
 
-        // Loop to find the points lying on wall
-        for (const auto &mapPoint : mpAtlas->GetAllMapPoints())
+        // Find the points lying on wall, only the voxels crossing the plane are visited
+        for (const auto &mapPoint : mpAtlas->GetMapPointsNearPlane(estimatedPlane.coeffs(), 0.1))
         {
             if (pointOnPlane(estimatedPlane.coeffs(), mapPoint))
                 newMapWall->setMapPoints(mapPoint);
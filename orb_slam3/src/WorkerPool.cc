@@ -0,0 +1,129 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+namespace ORB_SLAM3
+{
+
+    WorkerPool &WorkerPool::Instance()
+    {
+        // The tracking thread takes part in its own loops, so one core is left to it
+        static WorkerPool pool(std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1));
+        return pool;
+    }
+
+    WorkerPool::WorkerPool(int nThreads) : mbFinish(false)
+    {
+        mvThreads.reserve(nThreads);
+        for (int i = 0; i < nThreads; i++)
+            mvThreads.emplace_back(&WorkerPool::Run, this);
+    }
+
+    WorkerPool::~WorkerPool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutexJobs);
+            mbFinish = true;
+        }
+        mcvJobs.notify_all();
+
+        for (std::thread &t : mvThreads)
+            t.join();
+    }
+
+    bool WorkerPool::Job::RunNext()
+    {
+        const int i = mnNext.fetch_add(1);
+        if (i >= mnSize)
+            return false;
+
+        mTask(i);
+
+        if (mnPending.fetch_sub(1) == 1)
+        {
+            std::unique_lock<std::mutex> lock(mMutexDone);
+            mcvDone.notify_all();
+        }
+        return true;
+    }
+
+    void WorkerPool::ParallelFor(int n, const std::function<void(int)> &task)
+    {
+        if (n <= 0)
+            return;
+
+        if (n == 1 || mvThreads.empty())
+        {
+            for (int i = 0; i < n; i++)
+                task(i);
+            return;
+        }
+
+        std::shared_ptr<Job> pJob = std::make_shared<Job>(n, task);
+        {
+            std::unique_lock<std::mutex> lock(mMutexJobs);
+            mlJobs.push_back(pJob);
+        }
+        if (n - 1 >= static_cast<int>(mvThreads.size()))
+            mcvJobs.notify_all();
+        else
+            for (int i = 0; i < n - 1; i++)
+                mcvJobs.notify_one();
+
+        while (pJob->RunNext())
+            ;
+
+        {
+            std::unique_lock<std::mutex> lock(mMutexJobs);
+            mlJobs.erase(std::remove(mlJobs.begin(), mlJobs.end(), pJob), mlJobs.end());
+        }
+
+        std::unique_lock<std::mutex> lock(pJob->mMutexDone);
+        pJob->mcvDone.wait(lock, [&]
+                           { return pJob->mnPending.load() == 0; });
+    }
+
+    void WorkerPool::Run()
+    {
+        while (true)
+        {
+            std::shared_ptr<Job> pJob;
+            {
+                std::unique_lock<std::mutex> lock(mMutexJobs);
+                mcvJobs.wait(lock, [&]
+                             { return mbFinish || !mlJobs.empty(); });
+                if (mbFinish)
+                    return;
+
+                // Oldest job with iterations left, finished ones are dropped on the way
+                while (!mlJobs.empty() && mlJobs.front()->mnNext.load() >= mlJobs.front()->mnSize)
+                    mlJobs.pop_front();
+                if (mlJobs.empty())
+                    continue;
+                pJob = mlJobs.front();
+            }
+
+            while (pJob->RunNext())
+                ;
+        }
+    }
+
+} // namespace ORB_SLAM3
@@ -0,0 +1,89 @@
+/**
+ * This file is part of ORB-SLAM3
+ *
+ * Copyright (C) 2017-2021 Carlos Campos, Richard Elvira, Juan J. Gómez Rodríguez, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ * Copyright (C) 2014-2016 Raúl Mur-Artal, José M.M. Montiel and Juan D. Tardós, University of Zaragoza.
+ *
+ * ORB-SLAM3 is free software: you can redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ORB-SLAM3 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even
+ * the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with ORB-SLAM3.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Offline check that the vector ORB descriptor kernels give the same descriptors as the scalar one. It is
+ * not part of the default build: `make orb_descriptor_check` in the build directory, then run it without
+ * arguments. Returns 1 if any descriptor differs.
+ *
+ * The rotated offsets of the pattern only disagree at a few angles (when a multiply-add is fused in one of
+ * the kernels, see ORBdescriptor.cc), so every kernel is compared over a fine sweep of angles and many
+ * random ones, with random patterns.
+ */
+
+#include <iostream>
+#include <cstring>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "ORBdescriptor.h"
+
+using namespace std;
+
+int main()
+{
+    const vector<ORB_SLAM3::OrbDescriptorKernel> vKernels = ORB_SLAM3::supportedOrbDescriptorKernels();
+    if (vKernels.empty())
+    {
+        cout << "No vector kernel is supported on this CPU" << endl;
+        return 0;
+    }
+
+    cv::RNG rng(0x4f5242);
+
+    cv::Mat img(64, 64, CV_8UC1);
+    rng.fill(img, cv::RNG::UNIFORM, 0, 256);
+
+    const int nPatterns = 8;
+    const int nSweep = 36000, nRandom = 100000;
+
+    int nMismatches = 0;
+    for (int p = 0; p < nPatterns; p++)
+    {
+        // Same range as bit_pattern_31_ in ORBextractor.cc
+        vector<cv::Point> vPattern(512);
+        for (cv::Point &pt : vPattern)
+            pt = cv::Point(rng.uniform(-13, 14), rng.uniform(-13, 14));
+        const ORB_SLAM3::OrbPatternSoA soa(&vPattern[0]);
+
+        for (int i = 0; i < nSweep + nRandom; i++)
+        {
+            const float angle = i < nSweep ? 0.01f * i : rng.uniform(0.f, 360.f);
+            const cv::KeyPoint kpt(cv::Point2f(32.f, 32.f), 31.f, angle);
+
+            uchar descRef[32];
+            ORB_SLAM3::computeOrbDescriptorScalar(kpt, img, &vPattern[0], soa, descRef);
+
+            for (size_t k = 0; k < vKernels.size(); k++)
+            {
+                uchar desc[32];
+                vKernels[k](kpt, img, &vPattern[0], soa, desc);
+                if (memcmp(desc, descRef, sizeof(desc)) != 0)
+                {
+                    if (nMismatches < 10)
+                        cout << "Kernel " << k << " differs at angle " << angle << " (pattern " << p << ")" << endl;
+                    nMismatches++;
+                }
+            }
+        }
+    }
+
+    cout << vKernels.size() << " kernels checked, " << nMismatches << " mismatching descriptors" << endl;
+    return nMismatches == 0 ? 0 : 1;
+}
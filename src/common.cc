@@ -17,14 +17,42 @@ image_transport::Publisher tracking_img_pub;
 rviz_visual_tools::RvizVisualToolsPtr wall_visual_tools;
 ros::Publisher pose_pub, odom_pub, kf_markers_pub;
 std::shared_ptr<tf::TransformListener> transform_listener;
-std::vector<std::vector<ORB_SLAM3::Marker *>> markers_buff;
+MarkerBuffer markers_buff;
 std::string world_frame_id, cam_frame_id, imu_frame_id, map_frame_id, wall_frame_id, room_frame_id;
 ros::Publisher tracked_mappoints_pub, all_mappoints_pub, fiducial_markers_pub, doors_pub, walls_pub, rooms_pub;
+ros::Publisher all_mappoints_delta_pub;
+
+// Variables for incremental map point publishing
+bool publish_all_points_delta = false;
+double all_points_snapshot_rate = 0.2;
 
 // List of semantic entities available in the real environment
 std::vector<ORB_SLAM3::Room *> env_rooms;
 std::vector<ORB_SLAM3::Door *> env_doors;
 
+// Variables for the publisher thread
+bool async_publishing = false;
+bool publish_only_subscribed = true;
+bool publisher_running = false;
+bool snapshot_pending = false;
+PublishSnapshot pending_snapshot;
+std::thread publisher_thread;
+std::mutex publisher_mutex;
+std::condition_variable publisher_cv;
+// Variables for the IMU/image synchronization
+SensorEvent sensor_event;
+LatencyHistogram sync_latency;
+int sync_latency_report_period = 0;
+// Variables for the pipelined tracking
+int tracking_pipeline_depth = 0;
+LatencyHistogram tracking_latency;
+int tracking_latency_report_period = 0;
+// Variables for the IMU-rate odometry
+bool imu_rate_odom = false;
+ImuPropagator imu_propagator;
+
+TopicRateLimiter tracking_img_limiter, tracked_points_limiter, all_points_limiter, kf_markers_limiter, semantics_limiter;
+
 //////////////////////////////////////////////////
 // Main functions
 //////////////////////////////////////////////////
@@ -83,6 +111,12 @@ void setup_publishers(ros::NodeHandle &node_handler, image_transport::ImageTrans
 
     all_mappoints_pub = node_handler.advertise<sensor_msgs::PointCloud2>(node_name + "/all_points", 1);
 
+    // In delta mode only the changed map points are published on every frame, the full map at a low rate
+    node_handler.param<bool>(node_name + "/publish_all_points_delta", publish_all_points_delta, false);
+    node_handler.param<double>(node_name + "/all_points_snapshot_rate", all_points_snapshot_rate, 0.2);
+    if (publish_all_points_delta)
+        all_mappoints_delta_pub = node_handler.advertise<sensor_msgs::PointCloud2>(node_name + "/all_points_delta", 10);
+
     tracking_img_pub = image_transport.advertise(node_name + "/tracking_image", 1);
 
     kf_markers_pub = node_handler.advertise<visualization_msgs::Marker>(node_name + "/kf_markers", 1000);
@@ -108,16 +142,110 @@ void setup_publishers(ros::NodeHandle &node_handler, image_transport::ImageTrans
     wall_visual_tools->setAlpha(0.5);
 
     transform_listener = std::make_shared<tf::TransformListener>();
+
+    // Heavy topics (images, clouds, MarkerArrays) are built on a separate thread at their own rate
+    node_handler.param<bool>(node_name + "/async_publishing", async_publishing, false);
+    node_handler.param<bool>(node_name + "/publish_only_subscribed", publish_only_subscribed, true);
+    node_handler.param<double>(node_name + "/tracking_image_rate", tracking_img_limiter.rate, 0.0);
+    node_handler.param<double>(node_name + "/tracked_points_rate", tracked_points_limiter.rate, 0.0);
+    node_handler.param<double>(node_name + "/all_points_rate", all_points_limiter.rate, 0.0);
+    node_handler.param<double>(node_name + "/kf_markers_rate", kf_markers_limiter.rate, 0.0);
+    node_handler.param<double>(node_name + "/semantics_rate", semantics_limiter.rate, 0.0);
+
+    if (async_publishing)
+    {
+        publisher_running = true;
+        publisher_thread = std::thread(publisher_thread_loop);
+    }
+}
+
+void setup_tracking_pipeline(ros::NodeHandle &node_handler, std::string node_name)
+{
+    // Frame construction of the next images overlaps the tracking of the current one (0 disables it)
+    node_handler.param<int>(node_name + "/tracking_pipeline_depth", tracking_pipeline_depth, 0);
+    // Number of frames between two reports of the image-to-pose latency (0 disables them)
+    node_handler.param<int>(node_name + "/tracking_latency_report_period", tracking_latency_report_period, 0);
+
+    if (tracking_pipeline_depth > 0)
+        pSLAM->SetTrackingPipelineDepth(tracking_pipeline_depth);
+}
+
+void setup_imu_propagation(ros::NodeHandle &node_handler, std::string node_name)
+{
+    // Publish body_odom for every IMU sample, propagated from the last tracked frame (false by default)
+    node_handler.param<bool>(node_name + "/imu_rate_odom", imu_rate_odom, false);
+    // IMU samples kept to propagate again from a newly tracked frame, in seconds
+    double retention;
+    node_handler.param<double>(node_name + "/imu_rate_odom_retention", retention, 1.0);
+    imu_propagator.setRetention(retention);
+}
+
+void setup_sensor_sync(ros::NodeHandle &node_handler, std::string node_name)
+{
+    // Number of frames between two reports of the arrival-to-tracking latency (0 disables them)
+    node_handler.param<int>(node_name + "/sync_latency_report_period", sync_latency_report_period, 0);
+}
+
+void shutdown_publishers()
+{
+    {
+        std::unique_lock<std::mutex> lock(publisher_mutex);
+        if (!publisher_running)
+            return;
+        publisher_running = false;
+    }
+    publisher_cv.notify_one();
+    publisher_thread.join();
+}
+
+/**
+ * Publishes the latest snapshot handed over by the tracking thread. Snapshots that arrive
+ * while the previous one is still being published replace the pending one.
+ */
+void publisher_thread_loop()
+{
+    while (true)
+    {
+        PublishSnapshot snapshot;
+        {
+            std::unique_lock<std::mutex> lock(publisher_mutex);
+            publisher_cv.wait(lock, []
+                              { return snapshot_pending || !publisher_running; });
+            if (!publisher_running)
+                return;
+
+            snapshot = std::move(pending_snapshot);
+            snapshot_pending = false;
+        }
+
+        publish_snapshot(snapshot);
+    }
 }
 
 void publish_topics(ros::Time msg_time, Eigen::Vector3f Wbb)
 {
+    // The tracked frame is an older image when the tracking is pipelined
+    static double last_tracked_stamp = -1.0;
+    double tracked_stamp;
+    std::chrono::steady_clock::time_point grab_time;
+    if (!pSLAM->GetTrackedFrameTime(tracked_stamp, grab_time))
+        return;
+
+    if (tracking_pipeline_depth > 0)
+    {
+        if (tracked_stamp == last_tracked_stamp)
+            return;
+        msg_time = ros::Time(tracked_stamp);
+    }
+    last_tracked_stamp = tracked_stamp;
+    add_tracking_latency(grab_time);
+
     Sophus::SE3f Twc = pSLAM->GetCamTwc();
 
     if (Twc.translation().array().isNaN()[0] || Twc.rotationMatrix().array().isNaN()(0, 0)) // avoid publishing NaN
         return;
 
-    // Common topics
+    // Common topics (cheap and latency critical, published from the tracking thread)
     publish_camera_pose(Twc, msg_time);
     publish_tf_transform(Twc, world_frame_id, cam_frame_id, msg_time);
 
@@ -125,14 +253,55 @@ void publish_topics(ros::Time msg_time, Eigen::Vector3f Wbb)
     if (publish_static_transform)
         publish_static_tf_transform(world_frame_id, map_frame_id, msg_time);
 
-    publish_doors(pSLAM->GetAllDoors(), msg_time);
-    publish_walls(pSLAM->GetAllWalls(), msg_time);
-    publish_rooms(pSLAM->GetAllRooms(), msg_time);
-    publish_all_points(pSLAM->GetAllMapPoints(), msg_time);
-    publish_tracking_img(pSLAM->GetCurrentFrame(), msg_time);
-    publish_kf_markers(pSLAM->GetAllKeyframePoses(), msg_time);
-    publish_fiducial_markers(pSLAM->GetAllMarkers(), msg_time);
-    publish_tracked_points(pSLAM->GetTrackedMapPoints(), msg_time);
+    // Everything else only needs a snapshot of the tracking state
+    PublishSnapshot snapshot;
+    snapshot.msg_time = msg_time;
+
+    if (tracked_points_limiter.ready(msg_time) && (!publish_only_subscribed || tracked_mappoints_pub.getNumSubscribers() > 0))
+    {
+        snapshot.tracked_points = mappoint_to_pointcloud(pSLAM->GetTrackedMapPoints(), msg_time);
+        snapshot.has_tracked_points = true;
+    }
+
+    // Wall centroids are computed in walls_to_marker_array and used by rooms_to_marker_array
+    if (semantics_limiter.ready(msg_time) &&
+        (!publish_only_subscribed || doors_pub.getNumSubscribers() > 0 || walls_pub.getNumSubscribers() > 0 ||
+         rooms_pub.getNumSubscribers() > 0 || fiducial_markers_pub.getNumSubscribers() > 0))
+    {
+        snapshot.doors = doors_to_marker_array(pSLAM->GetAllDoors(), msg_time);
+        snapshot.walls = walls_to_marker_array(pSLAM->GetAllWalls(), msg_time);
+        snapshot.rooms = rooms_to_marker_array(pSLAM->GetAllRooms(), msg_time);
+        snapshot.fiducial_markers = fiducial_markers_to_marker_array(pSLAM->GetAllMarkers(), msg_time);
+        snapshot.has_semantics = true;
+    }
+
+    if (async_publishing)
+    {
+        {
+            std::unique_lock<std::mutex> lock(publisher_mutex);
+
+            // The rate limiters already let these messages through, keep them if the new snapshot has none
+            if (snapshot_pending && !snapshot.has_tracked_points && pending_snapshot.has_tracked_points)
+            {
+                snapshot.tracked_points = std::move(pending_snapshot.tracked_points);
+                snapshot.has_tracked_points = true;
+            }
+            if (snapshot_pending && !snapshot.has_semantics && pending_snapshot.has_semantics)
+            {
+                snapshot.doors = std::move(pending_snapshot.doors);
+                snapshot.walls = std::move(pending_snapshot.walls);
+                snapshot.rooms = std::move(pending_snapshot.rooms);
+                snapshot.fiducial_markers = std::move(pending_snapshot.fiducial_markers);
+                snapshot.has_semantics = true;
+            }
+
+            pending_snapshot = std::move(snapshot);
+            snapshot_pending = true;
+        }
+        publisher_cv.notify_one();
+    }
+    else
+        publish_snapshot(snapshot);
 
     // IMU-specific topics
     if (sensor_type == ORB_SLAM3::System::IMU_MONOCULAR || sensor_type == ORB_SLAM3::System::IMU_STEREO || sensor_type == ORB_SLAM3::System::IMU_RGBD)
@@ -148,8 +317,86 @@ void publish_topics(ros::Time msg_time, Eigen::Vector3f Wbb)
         publish_tf_transform(Twb, world_frame_id, imu_frame_id, msg_time);
         if (publish_static_transform)
             publish_static_tf_transform(world_frame_id, map_frame_id, msg_time);
-        publish_body_odom(Twb, Vwb, Wwb, msg_time);
+
+        // At IMU rate the odometry is published ahead of the tracked frame
+        if (imu_rate_odom)
+            anchor_body_odom();
+        else
+            publish_body_odom(Twb, Vwb, Wwb, msg_time);
+    }
+}
+
+void publish_snapshot(const PublishSnapshot &snapshot)
+{
+    ros::Time msg_time = snapshot.msg_time;
+
+    if (snapshot.has_semantics)
+    {
+        if (!snapshot.doors.markers.empty())
+            doors_pub.publish(snapshot.doors);
+        if (!snapshot.walls.markers.empty())
+            walls_pub.publish(snapshot.walls);
+        if (!snapshot.rooms.markers.empty())
+            rooms_pub.publish(snapshot.rooms);
+        if (!snapshot.fiducial_markers.markers.empty())
+            fiducial_markers_pub.publish(snapshot.fiducial_markers);
+    }
+
+    if (all_points_limiter.ready(msg_time))
+    {
+        // The change feed keeps the delta until the next call, so skipping frames loses nothing
+        if (publish_all_points_delta)
+        {
+            if (!publish_only_subscribed || all_mappoints_pub.getNumSubscribers() > 0 || all_mappoints_delta_pub.getNumSubscribers() > 0)
+                publish_all_points_changes(msg_time);
+        }
+        else if (!publish_only_subscribed || all_mappoints_pub.getNumSubscribers() > 0)
+            publish_all_points(pSLAM->GetAllMapPoints(), msg_time);
     }
+
+    if (tracking_img_limiter.ready(msg_time) && (!publish_only_subscribed || tracking_img_pub.getNumSubscribers() > 0))
+        publish_tracking_img(pSLAM->GetCurrentFrame(), msg_time);
+
+    if (kf_markers_limiter.ready(msg_time) && (!publish_only_subscribed || kf_markers_pub.getNumSubscribers() > 0))
+        publish_kf_markers(pSLAM->GetAllKeyframePoses(), msg_time);
+
+    if (snapshot.has_tracked_points)
+        tracked_mappoints_pub.publish(snapshot.tracked_points);
+}
+
+/**
+ * Propagates the body state of the last tracked frame with a new IMU sample and publishes it.
+ * Called from the IMU callback, so the odometry follows the IMU rate.
+ */
+void propagate_body_odom(const ImuSample &sample)
+{
+    if (!imu_rate_odom)
+        return;
+
+    ImuPropagator::State state;
+    if (imu_propagator.addSample(sample.t, sample.acc, sample.gyr, state))
+        publish_body_odom(state.Twb, state.Vwb, state.Wwb, ros::Time(state.t));
+}
+
+/**
+ * Re-anchors the propagation to the frame just tracked and publishes the state propagated with the
+ * IMU samples received since its timestamp. The propagation stops while there is no valid IMU state.
+ */
+void anchor_body_odom()
+{
+    double t;
+    Sophus::SE3f Twb;
+    Eigen::Vector3f Vwb;
+    ORB_SLAM3::IMU::Bias bias;
+    if (!pSLAM->GetTrackedImuState(t, Twb, Vwb, bias))
+    {
+        imu_propagator.reset();
+        return;
+    }
+
+    ImuPropagator::State state;
+    if (imu_propagator.anchor(t, Twb, Vwb, bias, state))
+        publish_body_odom(state.Twb, state.Vwb, state.Wwb, ros::Time(state.t));
 }
 
 void publish_body_odom(Sophus::SE3f Twb_SE3f, Eigen::Vector3f Vwb_E3f, Eigen::Vector3f ang_vel_body, ros::Time msg_time)
@@ -253,18 +500,39 @@ void publish_tracking_img(cv::Mat image, ros::Time msg_time)
     tracking_img_pub.publish(rendered_image_msg);
 }
 
-void publish_tracked_points(std::vector<ORB_SLAM3::MapPoint *> tracked_points, ros::Time msg_time)
+void publish_all_points(std::vector<ORB_SLAM3::MapPoint *> map_points, ros::Time msg_time)
 {
-    sensor_msgs::PointCloud2 cloud = mappoint_to_pointcloud(tracked_points, msg_time);
+    sensor_msgs::PointCloud2 cloud = mappoint_to_pointcloud(map_points, msg_time);
 
-    tracked_mappoints_pub.publish(cloud);
+    all_mappoints_pub.publish(cloud);
 }
 
-void publish_all_points(std::vector<ORB_SLAM3::MapPoint *> map_points, ros::Time msg_time)
+/**
+ * Publishes only the map points changed since the last call, plus a full snapshot at a low rate
+ * (or whenever the change feed of the map cannot provide the delta)
+ */
+void publish_all_points_changes(ros::Time msg_time)
 {
-    sensor_msgs::PointCloud2 cloud = mappoint_to_pointcloud(map_points, msg_time);
+    static long unsigned int map_id = std::numeric_limits<long unsigned int>::max();
+    static long unsigned int map_point_seq = 0;
+    static ros::Time last_snapshot_time;
 
-    all_mappoints_pub.publish(cloud);
+    std::vector<ORB_SLAM3::MapPoint *> changed_points;
+    std::vector<long unsigned int> erased_point_ids;
+    bool has_delta = pSLAM->GetMapPointChanges(map_id, map_point_seq, changed_points, erased_point_ids);
+
+    bool snapshot_due = msg_time < last_snapshot_time ||
+                        (all_points_snapshot_rate > 0 && (msg_time - last_snapshot_time).toSec() >= 1.0 / all_points_snapshot_rate);
+
+    // The sequence number is taken before the snapshot, so no change can be missed in between
+    if (!has_delta || snapshot_due)
+    {
+        publish_all_points(pSLAM->GetAllMapPoints(), msg_time);
+        last_snapshot_time = msg_time;
+    }
+
+    if (has_delta && (!changed_points.empty() || !erased_point_ids.empty()))
+        all_mappoints_delta_pub.publish(mappoint_delta_to_pointcloud(changed_points, erased_point_ids, msg_time));
 }
 
 // More details: http://docs.ros.org/en/api/visualization_msgs/html/msg/Marker.html
@@ -301,15 +569,19 @@ void publish_kf_markers(std::vector<Sophus::SE3f> vKFposes, ros::Time msg_time)
     kf_markers_pub.publish(kf_markers);
 }
 
-void publish_fiducial_markers(std::vector<ORB_SLAM3::Marker *> markers, ros::Time msg_time)
+visualization_msgs::MarkerArray fiducial_markers_to_marker_array(std::vector<ORB_SLAM3::Marker *> markers, ros::Time msg_time)
 {
+    visualization_msgs::MarkerArray markerArray;
     int numMarkers = markers.size();
     if (numMarkers == 0)
-        return;
+        return markerArray;
 
-    visualization_msgs::MarkerArray markerArray;
     markerArray.markers.resize(numMarkers);
 
+    // Resolved once for all markers of this cycle
+    tf::StampedTransform world_from_wall;
+    bool has_world_from_wall = lookup_world_transform(wall_frame_id, world_from_wall);
+
     for (int idx = 0; idx < numMarkers; idx++)
     {
         visualization_msgs::Marker fiducial_marker;
@@ -356,50 +628,43 @@ void publish_fiducial_markers(std::vector<ORB_SLAM3::Marker *> markers, ros::Tim
         fiducial_marker_lines.header.frame_id = world_frame_id;
         fiducial_marker_lines.type = visualization_msgs::Marker::LINE_LIST;
 
-        const map<ORB_SLAM3::KeyFrame *, Sophus::SE3f> observations = markers[idx]->getObservations();
-        for (map<ORB_SLAM3::KeyFrame *, Sophus::SE3f>::const_iterator obsId = observations.begin(), obLast = observations.end(); obsId != obLast; obsId++)
+        if (has_world_from_wall)
         {
-            tf::Stamped<tf::Point> marker_point;
-            marker_point.frame_id_ = wall_frame_id;
-            marker_point.setX(markerPose.translation().x());
-            marker_point.setY(markerPose.translation().y());
-            marker_point.setZ(markerPose.translation().z());
-
-            tf::Stamped<tf::Point> marker_point_transformed;
-            transform_listener->transformPoint(world_frame_id, ros::Time(0), marker_point, wall_frame_id, marker_point_transformed);
-
+            tf::Point marker_point_transformed = world_from_wall * tf::Point(markerPose.translation().x(),
+                                                                             markerPose.translation().y(),
+                                                                             markerPose.translation().z());
             geometry_msgs::Point point1;
             point1.x = marker_point_transformed.x();
             point1.y = marker_point_transformed.y();
             point1.z = marker_point_transformed.z();
-            fiducial_marker_lines.points.push_back(point1);
-
-            ORB_SLAM3::KeyFrame *pKFi = obsId->first;
-            tf::Stamped<tf::Point> keyframe_point;
-            keyframe_point.setX(pKFi->GetPoseInverse().translation().x());
-            keyframe_point.setY(pKFi->GetPoseInverse().translation().y());
-            keyframe_point.setZ(pKFi->GetPoseInverse().translation().z());
 
-            tf::Stamped<tf::Point> keyframe_point_transformed;
-            geometry_msgs::Point point2;
-            point2.x = pKFi->GetPoseInverse().translation().x();
-            point2.y = pKFi->GetPoseInverse().translation().y();
-            point2.z = pKFi->GetPoseInverse().translation().z();
-            fiducial_marker_lines.points.push_back(point2);
+            const map<ORB_SLAM3::KeyFrame *, Sophus::SE3f> observations = markers[idx]->getObservations();
+            for (map<ORB_SLAM3::KeyFrame *, Sophus::SE3f>::const_iterator obsId = observations.begin(), obLast = observations.end(); obsId != obLast; obsId++)
+            {
+                fiducial_marker_lines.points.push_back(point1);
+
+                ORB_SLAM3::KeyFrame *pKFi = obsId->first;
+                Eigen::Vector3f keyframe_position = pKFi->GetPoseInverse().translation();
+                geometry_msgs::Point point2;
+                point2.x = keyframe_position.x();
+                point2.y = keyframe_position.y();
+                point2.z = keyframe_position.z();
+                fiducial_marker_lines.points.push_back(point2);
+            }
         }
         markerArray.markers.push_back(fiducial_marker_lines);
     }
 
-    fiducial_markers_pub.publish(markerArray);
+    return markerArray;
 }
 
-void publish_doors(std::vector<ORB_SLAM3::Door *> doors, ros::Time msg_time)
+visualization_msgs::MarkerArray doors_to_marker_array(std::vector<ORB_SLAM3::Door *> doors, ros::Time msg_time)
 {
+    visualization_msgs::MarkerArray doorArray;
     int numDoors = doors.size();
     if (numDoors == 0)
-        return;
+        return doorArray;
 
-    visualization_msgs::MarkerArray doorArray;
     doorArray.markers.resize(numDoors);
 
     for (int idx = 0; idx < numDoors; idx++)
@@ -465,16 +730,16 @@ void publish_doors(std::vector<ORB_SLAM3::Door *> doors, ros::Time msg_time)
           
     }
 
-    doors_pub.publish(doorArray);
+    return doorArray;
 }
 
-void publish_walls(std::vector<ORB_SLAM3::Wall *> walls, ros::Time msg_time)
+visualization_msgs::MarkerArray walls_to_marker_array(std::vector<ORB_SLAM3::Wall *> walls, ros::Time msg_time)
 {
+    visualization_msgs::MarkerArray wallArray;
     int numWalls = walls.size();
     if (numWalls == 0)
-        return;
+        return wallArray;
 
-    visualization_msgs::MarkerArray wallArray;
     wallArray.markers.resize(numWalls);
 
     for (int idx = 0; idx < numWalls; idx++)
@@ -585,18 +850,28 @@ void publish_walls(std::vector<ORB_SLAM3::Wall *> walls, ros::Time msg_time)
         wallArray.markers.push_back(wallLines);
     }
 
-    walls_pub.publish(wallArray);
+    return wallArray;
 }
 
-void publish_rooms(std::vector<ORB_SLAM3::Room *> rooms, ros::Time msg_time)
+visualization_msgs::MarkerArray rooms_to_marker_array(std::vector<ORB_SLAM3::Room *> rooms, ros::Time msg_time)
 {
+    visualization_msgs::MarkerArray roomArray;
     int numRooms = rooms.size();
     if (numRooms == 0)
-        return;
+        return roomArray;
 
-    visualization_msgs::MarkerArray roomArray;
     roomArray.markers.resize(numRooms);
 
+    // Resolved once for all rooms, walls and doors of this cycle. The wall frame is only needed
+    // to draw the lines to the walls and doors of the rooms
+    bool rooms_have_links = false;
+    for (const auto room : rooms)
+        rooms_have_links |= !room->getWalls().empty() || !room->getDoors().empty();
+
+    tf::StampedTransform world_from_room, world_from_wall;
+    bool has_transforms = rooms_have_links && lookup_world_transform(room_frame_id, world_from_room) &&
+                          lookup_world_transform(wall_frame_id, world_from_wall);
+
     for (int idx = 0; idx < numRooms; idx++)
     {
         // Create color for room (magenta or violet based on room type)
@@ -684,73 +959,93 @@ void publish_rooms(std::vector<ORB_SLAM3::Room *> rooms, ros::Time msg_time)
         roomDoorLine.header.frame_id = world_frame_id;
         roomDoorLine.type = visualization_msgs::Marker::LINE_LIST;
 
-        tf::Stamped<tf::Point> room_point;
-        room_point.frame_id_ = room_frame_id;
-        room_point.setX(roomCenter.x());
-        room_point.setY(roomCenter.y());
-        room_point.setZ(roomCenter.z());
-
-        tf::Stamped<tf::Point> room_point_transformed;
-        transform_listener->transformPoint(world_frame_id, ros::Time(0), room_point, room_frame_id, room_point_transformed);
-        for(const auto wall : rooms[idx]->getWalls())
+        if (has_transforms)
         {
+            tf::Point room_point_transformed = world_from_room * tf::Point(roomCenter.x(), roomCenter.y(), roomCenter.z());
             geometry_msgs::Point point1;
             point1.x = room_point_transformed.x();
             point1.y = room_point_transformed.y();
             point1.z = room_point_transformed.z();
-            roomWallLine.points.push_back(point1);
-            
-            tf::Stamped<tf::Point> wall_point;
-            wall_point.frame_id_ = wall_frame_id;
-            wall_point.setX(wall->getCentroid().x());
-            wall_point.setY(wall->getCentroid().y());
-            wall_point.setZ(wall->getCentroid().z());
-            tf::Stamped<tf::Point> wall_point_transformed;
-            transform_listener->transformPoint(world_frame_id, ros::Time(0), wall_point, wall_frame_id, wall_point_transformed);
 
-            geometry_msgs::Point point2;
-            point2.x = wall_point_transformed.x();
-            point2.y = wall_point_transformed.y();
-            point2.z = wall_point_transformed.z();
-
-            roomWallLine.points.push_back(point2);
+            for (const auto wall : rooms[idx]->getWalls())
+            {
+                roomWallLine.points.push_back(point1);
+
+                Eigen::Vector3f wallCentroid = wall->getCentroid();
+                tf::Point wall_point_transformed = world_from_wall * tf::Point(wallCentroid.x(), wallCentroid.y(), wallCentroid.z());
+
+                geometry_msgs::Point point2;
+                point2.x = wall_point_transformed.x();
+                point2.y = wall_point_transformed.y();
+                point2.z = wall_point_transformed.z();
+                roomWallLine.points.push_back(point2);
+            }
+
+            for (const auto door : rooms[idx]->getDoors())
+            {
+                roomDoorLine.points.push_back(point1);
+
+                Eigen::Vector3f doorPosition = door->getGlobalPose().translation();
+                tf::Point door_point_transformed = world_from_wall * tf::Point(doorPosition.x(), doorPosition.y(), doorPosition.z());
+
+                geometry_msgs::Point point2;
+                point2.x = door_point_transformed.x();
+                point2.y = door_point_transformed.y() - 2.0;
+                point2.z = door_point_transformed.z();
+                roomDoorLine.points.push_back(point2);
+            }
         }
 
-        for(const auto door : rooms[idx]->getDoors()) 
-        {
-            geometry_msgs::Point point1;
-            point1.x = room_point_transformed.x();
-            point1.y = room_point_transformed.y();
-            point1.z = room_point_transformed.z();
-            roomDoorLine.points.push_back(point1);
-
-            tf::Stamped<tf::Point> door_point;
-            door_point.frame_id_ = wall_frame_id;
-            door_point.setX(door->getGlobalPose().translation()(0));
-            door_point.setY(door->getGlobalPose().translation()(1));
-            door_point.setZ(door->getGlobalPose().translation()(2));
-            tf::Stamped<tf::Point> door_point_transformed;
-            transform_listener->transformPoint(world_frame_id, ros::Time(0), door_point, wall_frame_id, door_point_transformed);
-
-            geometry_msgs::Point point2;
-            point2.x = door_point_transformed.x();
-            point2.y = door_point_transformed.y() - 2.0;
-            point2.z = door_point_transformed.z();
-
-            roomDoorLine.points.push_back(point2);
-        }   
-
         roomArray.markers.push_back(roomWallLine);
         roomArray.markers.push_back(roomDoorLine);
     }
 
-    rooms_pub.publish(roomArray);
+    return roomArray;
 }
 
 //////////////////////////////////////////////////
 // Miscellaneous functions
 //////////////////////////////////////////////////
 
+/**
+ * Looks up the latest transform from the given frame to the world frame, so that it can be
+ * applied to all entities of a publish cycle. Returns false if it is not available yet.
+ * The transform is cached per frame and only looked up again when tf holds a newer one.
+ * Called from the publishing thread only.
+ */
+bool lookup_world_transform(const std::string &frame_id, tf::StampedTransform &transform)
+{
+    static std::map<std::string, tf::StampedTransform> cached_transforms;
+
+    ros::Time latest_time;
+    std::string error;
+    if (transform_listener->getLatestCommonTime(world_frame_id, frame_id, latest_time, &error) != tf::NO_ERROR)
+    {
+        ROS_WARN_THROTTLE(10.0, "%s", error.c_str());
+        return false;
+    }
+
+    auto cached = cached_transforms.find(frame_id);
+    if (cached != cached_transforms.end() && cached->second.stamp_ == latest_time)
+    {
+        transform = cached->second;
+        return true;
+    }
+
+    try
+    {
+        transform_listener->lookupTransform(world_frame_id, frame_id, latest_time, transform);
+    }
+    catch (tf::TransformException &e)
+    {
+        ROS_WARN_THROTTLE(10.0, "%s", e.what());
+        return false;
+    }
+
+    cached_transforms[frame_id] = transform;
+    return true;
+}
+
 sensor_msgs::PointCloud2 mappoint_to_pointcloud(std::vector<ORB_SLAM3::MapPoint *> map_points, ros::Time msg_time)
 {
     const int num_channels = 3; // x y z
@@ -800,6 +1095,68 @@ sensor_msgs::PointCloud2 mappoint_to_pointcloud(std::vector<ORB_SLAM3::MapPoint
     return cloud;
 }
 
+/**
+ * Converts a map point delta into a cloud with (x, y, z, id) fields. Erased points
+ * are sent with their id and NaN coordinates.
+ */
+sensor_msgs::PointCloud2 mappoint_delta_to_pointcloud(std::vector<ORB_SLAM3::MapPoint *> changed_points,
+                                                      std::vector<long unsigned int> erased_point_ids, ros::Time msg_time)
+{
+    const int num_channels = 4; // x y z id
+
+    sensor_msgs::PointCloud2 cloud;
+
+    cloud.header.stamp = msg_time;
+    cloud.header.frame_id = world_frame_id;
+    cloud.height = 1;
+    cloud.width = changed_points.size() + erased_point_ids.size();
+    cloud.is_bigendian = false;
+    cloud.is_dense = erased_point_ids.empty();
+    cloud.point_step = num_channels * sizeof(float);
+    cloud.row_step = cloud.point_step * cloud.width;
+    cloud.fields.resize(num_channels);
+
+    std::string channel_id[] = {"x", "y", "z", "id"};
+
+    for (int i = 0; i < num_channels; i++)
+    {
+        cloud.fields[i].name = channel_id[i];
+        cloud.fields[i].offset = i * sizeof(float);
+        cloud.fields[i].count = 1;
+        cloud.fields[i].datatype = sensor_msgs::PointField::FLOAT32;
+    }
+    cloud.fields[3].datatype = sensor_msgs::PointField::UINT32;
+
+    cloud.data.resize(cloud.row_step * cloud.height);
+
+    unsigned char *cloud_data_ptr = &(cloud.data[0]);
+
+    unsigned int i = 0;
+    for (ORB_SLAM3::MapPoint *pMP : changed_points)
+    {
+        Eigen::Vector3f P3Dw = pMP->GetWorldPos();
+        float data_array[3] = {P3Dw.x(), P3Dw.y(), P3Dw.z()};
+        uint32_t point_id = pMP->mnId;
+
+        memcpy(cloud_data_ptr + (i * cloud.point_step), data_array, 3 * sizeof(float));
+        memcpy(cloud_data_ptr + (i * cloud.point_step) + 3 * sizeof(float), &point_id, sizeof(uint32_t));
+        i++;
+    }
+
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    for (long unsigned int erased_id : erased_point_ids)
+    {
+        float data_array[3] = {nan, nan, nan};
+        uint32_t point_id = erased_id;
+
+        memcpy(cloud_data_ptr + (i * cloud.point_step), data_array, 3 * sizeof(float));
+        memcpy(cloud_data_ptr + (i * cloud.point_step) + 3 * sizeof(float), &point_id, sizeof(uint32_t));
+        i++;
+    }
+
+    return cloud;
+}
+
 cv::Mat SE3f_to_cvMat(Sophus::SE3f T_SE3f)
 {
     cv::Mat T_cvmat;
@@ -828,24 +1185,101 @@ tf::Transform SE3f_to_tfTransform(Sophus::SE3f T_SE3f)
     return tf::Transform(R_tf, t_tf);
 }
 
+//////////////////////////////////////////////////
+// IMU/image synchronization
+//////////////////////////////////////////////////
+
+/**
+ * Moves all IMU samples up to the image timestamp out of the buffer. Wbb is set to the
+ * angular velocity of the last sample (zero if there is none).
+ */
+void pop_imu_measurements(GrowingSPSCQueue<ImuSample> &imu_buf, double t_image, std::vector<ORB_SLAM3::IMU::Point> &imu_meas, Eigen::Vector3f &Wbb)
+{
+    imu_meas.clear();
+    Wbb.setZero();
+
+    ImuSample *sample;
+    while ((sample = imu_buf.front()) && sample->t <= t_image)
+    {
+        imu_meas.push_back(ORB_SLAM3::IMU::Point(sample->acc.x(), sample->acc.y(), sample->acc.z(),
+                                                 sample->gyr.x(), sample->gyr.y(), sample->gyr.z(), sample->t));
+        Wbb = sample->gyr;
+        imu_buf.pop();
+    }
+}
+
+/**
+ * Drops the oldest IMU samples until at most max_size are left (called by the consumer only). Only
+ * used before the first image is tracked, when no frame can use them (the first one is not preintegrated)
+ */
+void trim_imu_buffer(GrowingSPSCQueue<ImuSample> &imu_buf, size_t max_size)
+{
+    while (imu_buf.size() > max_size)
+        imu_buf.pop();
+}
+
+/**
+ * Records the latency between the arrival of an image and the start of its tracking
+ */
+void add_sync_latency(std::chrono::steady_clock::time_point arrival)
+{
+    sync_latency.add(arrival);
+
+    if (sync_latency_report_period > 0 && sync_latency.size() >= (unsigned long)sync_latency_report_period)
+    {
+        sync_latency.print("Image arrival to tracking");
+        sync_latency.clear();
+    }
+}
+
+void add_tracking_latency(std::chrono::steady_clock::time_point grab_time)
+{
+    tracking_latency.add(grab_time);
+
+    if (tracking_latency_report_period > 0 && tracking_latency.size() >= (unsigned long)tracking_latency_report_period)
+    {
+        tracking_latency.print("Image to tracked pose");
+        tracking_latency.clear();
+    }
+}
+
 //////////////////////////////////////////////////
 // Fiducial Marker-related Modules
 //////////////////////////////////////////////////
 
+void setup_marker_buffer(ros::NodeHandle &node_handler, std::string node_name)
+{
+    int markers_buffer_size;
+    double markers_buffer_retention;
+    node_handler.param<int>(node_name + "/markers_buffer_size", markers_buffer_size, 64);
+    node_handler.param<double>(node_name + "/markers_buffer_retention", markers_buffer_retention, 2.0);
+
+    markers_buff.configure(std::max(markers_buffer_size, 1), markers_buffer_retention);
+}
+
 /**
  * Adds one/list of markers into a common buffer
  */
 void add_markers_to_buffer(const aruco_msgs::MarkerArray &marker_array)
 {
-    // The list of markers observed in the current frame
-    std::vector<ORB_SLAM3::Marker *> current_markers;
+    if (marker_array.markers.empty())
+        return;
+
+    // The list of markers observed in the current frame, stored in the buffer
+    double visit_time = marker_array.markers[0].header.stamp.toSec();
+    std::vector<ORB_SLAM3::Marker *> *current_markers = markers_buff.push(visit_time, marker_array.markers.size());
+    if (!current_markers)
+    {
+        ROS_WARN_THROTTLE(1.0, "Dropping ArUco markers older than the ones in the buffer");
+        return;
+    }
 
     // Process the received marker array
-    for (const auto &marker : marker_array.markers)
+    for (size_t i = 0; i < marker_array.markers.size(); i++)
     {
         // Access information of each passed ArUco marker
+        const aruco_msgs::Marker &marker = marker_array.markers[i];
         int marker_id = marker.id;
-        double visit_time = marker.header.stamp.toSec();
         geometry_msgs::Pose marker_pose = marker.pose.pose;
         geometry_msgs::Point marker_position = marker_pose.position;            // (x,y,z)
         geometry_msgs::Quaternion marker_orientation = marker_pose.orientation; // (x,y,z,w)
@@ -855,41 +1289,28 @@ void add_markers_to_buffer(const aruco_msgs::MarkerArray &marker_array)
                                              marker_orientation.y, marker_orientation.z);
         Sophus::SE3f normalized_pose(marker_quaternion, marker_translation);
 
-        // Create a marker object of the currently visited marker
-        ORB_SLAM3::Marker *current_marker = new ORB_SLAM3::Marker();
+        // Fill the (reused) marker object of the currently visited marker
+        ORB_SLAM3::Marker *current_marker = (*current_markers)[i];
         current_marker->setOpId(-1);
         current_marker->setId(marker_id);
         current_marker->setTime(visit_time);
         current_marker->setMarkerInGMap(false);
         current_marker->setLocalPose(normalized_pose);
-
-        // Add it to the list of observed markers
-        current_markers.push_back(current_marker);
+        current_marker->setGlobalPose(Sophus::SE3f());
+        current_marker->SetMap(nullptr);
     }
-
-    // Add the new markers to the list of markers in buffer
-    if (current_markers.size() > 0)
-        markers_buff.push_back(current_markers);
 }
 
 /**
- * Processes the common marker buffer to get the one closest to the current marker
+ * Processes the common marker buffer to get the markers closest in time to the current frame
  */
 std::pair<double, std::vector<ORB_SLAM3::Marker *>> find_nearest_marker(double frame_timestamp)
 {
     double min_time_diff = 100;
     std::vector<ORB_SLAM3::Marker *> matched_markers;
 
-    // Loop through the markers_buff
-    for (const auto &markers : markers_buff)
-    {
-        double time_diff = markers[0]->getTime() - frame_timestamp;
-        if (time_diff < min_time_diff)
-        {
-            min_time_diff = time_diff;
-            matched_markers = markers;
-        }
-    }
+    if (!markers_buff.nearest(frame_timestamp, min_time_diff, matched_markers))
+        min_time_diff = 100;
 
     return std::make_pair(min_time_diff, matched_markers);
 }
@@ -65,11 +65,13 @@ int main(int argc, char **argv)
     ros::Subscriber sub_aruco = node_handler.subscribe("/aruco_marker_publisher/markers", 1, &ImageGrabber::GrabArUcoMarker, &igb);
 
     setup_publishers(node_handler, image_transport, node_name);
+    setup_tracking_pipeline(node_handler, node_name);
     setup_services(node_handler, node_name);
 
     ros::spin();
 
     // Stop all threads
+    shutdown_publishers();
     pSLAM->Shutdown();
     ros::shutdown();
 
@@ -11,26 +11,35 @@ using namespace std;
 class ImuGrabber
 {
 public:
-    ImuGrabber(){};
+    ImuGrabber() : imuBuf(IMU_BUFFER_SIZE), mLastImuTime(-1.0){};
 
     void GrabImu(const sensor_msgs::ImuConstPtr &imu_msg);
 
-    queue<sensor_msgs::ImuConstPtr> imuBuf;
-    std::mutex mBufMutex;
+    // Filled by the ROS callback thread, consumed by the synchronization thread. It grows beyond
+    // IMU_BUFFER_SIZE if needed, every sample is handed to the tracking
+    GrowingSPSCQueue<ImuSample> imuBuf;
+    // Timestamp of the newest IMU sample received
+    std::atomic<double> mLastImuTime;
+
+    // Lock-free capacity, 5 seconds * 400Hz = 2000 samples
+    static const size_t IMU_BUFFER_SIZE = 2000;
 };
 
 class ImageGrabber
 {
 public:
-    ImageGrabber(ImuGrabber *pImuGb) : mpImuGb(pImuGb) {}
+    ImageGrabber(ImuGrabber *pImuGb) : img0Buf(IMAGE_BUFFER_SIZE), mpImuGb(pImuGb), mbImageTracked(false) {}
 
     void GrabImage(const sensor_msgs::ImageConstPtr &msg);
-    cv::Mat GetImage(const sensor_msgs::ImageConstPtr &img_msg);
+    cv_bridge::CvImageConstPtr GetImage(const sensor_msgs::ImageConstPtr &img_msg);
     void SyncWithImu();
 
-    queue<sensor_msgs::ImageConstPtr> img0Buf;
-    std::mutex mBufMutex;
+    SPSCQueue<ImageSample> img0Buf;
     ImuGrabber *mpImuGb;
+    // Set once the first image is tracked, the IMU samples are kept from then on
+    bool mbImageTracked;
+
+    static const size_t IMAGE_BUFFER_SIZE = 8;
 };
 
 int main(int argc, char **argv)
@@ -76,13 +85,17 @@ int main(int argc, char **argv)
     ros::Subscriber sub_img = node_handler.subscribe("/camera/image_raw", 100, &ImageGrabber::GrabImage, &igb);
 
     setup_publishers(node_handler, image_transport, node_name);
+    setup_tracking_pipeline(node_handler, node_name);
     setup_services(node_handler, node_name);
+    setup_sensor_sync(node_handler, node_name);
+    setup_imu_propagation(node_handler, node_name);
 
     std::thread sync_thread(&ImageGrabber::SyncWithImu, &igb);
 
     ros::spin();
 
     // Stop all threads
+    shutdown_publishers();
     pSLAM->Shutdown();
     ros::shutdown();
 
@@ -95,16 +108,19 @@ int main(int argc, char **argv)
 
 void ImageGrabber::GrabImage(const sensor_msgs::ImageConstPtr &img_msg)
 {
-    mBufMutex.lock();
-    if (!img0Buf.empty())
-        img0Buf.pop();
-    img0Buf.push(img_msg);
-    mBufMutex.unlock();
+    ImageSample sample;
+    sample.msg = img_msg;
+    sample.arrival = std::chrono::steady_clock::now();
+
+    if (!img0Buf.push(sample))
+        ROS_WARN_THROTTLE(1.0, "Image buffer is full, dropping frame");
+
+    sensor_event.notify();
 }
 
-cv::Mat ImageGrabber::GetImage(const sensor_msgs::ImageConstPtr &img_msg)
+cv_bridge::CvImageConstPtr ImageGrabber::GetImage(const sensor_msgs::ImageConstPtr &img_msg)
 {
-    // Copy the ros image message to cv::Mat.
+    // Share the ros image message data with cv::Mat, the returned pointer keeps the message alive
     cv_bridge::CvImageConstPtr cv_ptr;
     try
     {
@@ -113,78 +129,70 @@ cv::Mat ImageGrabber::GetImage(const sensor_msgs::ImageConstPtr &img_msg)
     catch (cv_bridge::Exception &e)
     {
         ROS_ERROR("cv_bridge exception: %s", e.what());
+        return nullptr;
     }
 
-    if (cv_ptr->image.type() == 0)
-    {
-        return cv_ptr->image.clone();
-    }
-    else
-    {
-        std::cout << "Error type" << std::endl;
-        return cv_ptr->image.clone();
-    }
+    return cv_ptr;
 }
 
 void ImageGrabber::SyncWithImu()
 {
     while (1)
     {
-        if (!img0Buf.empty() && !mpImuGb->imuBuf.empty())
-        {
-            cv::Mat im;
-            double tIm = 0;
+        // Read before checking the buffers, so no notification between the check and the wait is lost
+        unsigned long seen = sensor_event.getSequence();
 
-            tIm = img0Buf.front()->header.stamp.toSec();
-            if (tIm > mpImuGb->imuBuf.back()->header.stamp.toSec())
-                continue;
-
-            this->mBufMutex.lock();
-            im = GetImage(img0Buf.front());
-            ros::Time msg_time = img0Buf.front()->header.stamp;
+        // Only the most recent image is tracked
+        while (img0Buf.size() > 1)
             img0Buf.pop();
-            this->mBufMutex.unlock();
 
-            vector<ORB_SLAM3::IMU::Point> vImuMeas;
-            Eigen::Vector3f Wbb;
-            mpImuGb->mBufMutex.lock();
-            if (!mpImuGb->imuBuf.empty())
-            {
-                // Load imu measurements from buffer
-                vImuMeas.clear();
-                while (!mpImuGb->imuBuf.empty() && mpImuGb->imuBuf.front()->header.stamp.toSec() <= tIm)
-                {
-                    double t = mpImuGb->imuBuf.front()->header.stamp.toSec();
+        // Wait until there is an image and the IMU samples up to its timestamp are received
+        ImageSample *pImg = img0Buf.front();
+        if (!pImg || pImg->msg->header.stamp.toSec() > mpImuGb->mLastImuTime.load())
+        {
+            // Before the first image, old IMU samples are never used
+            if (!pImg && !mbImageTracked)
+                trim_imu_buffer(mpImuGb->imuBuf, ImuGrabber::IMU_BUFFER_SIZE / 2);
 
-                    cv::Point3f acc(mpImuGb->imuBuf.front()->linear_acceleration.x, mpImuGb->imuBuf.front()->linear_acceleration.y, mpImuGb->imuBuf.front()->linear_acceleration.z);
+            sensor_event.wait(seen);
+            continue;
+        }
 
-                    cv::Point3f gyr(mpImuGb->imuBuf.front()->angular_velocity.x, mpImuGb->imuBuf.front()->angular_velocity.y, mpImuGb->imuBuf.front()->angular_velocity.z);
+        ros::Time msg_time = pImg->msg->header.stamp;
+        double tIm = msg_time.toSec();
+        std::chrono::steady_clock::time_point arrival = pImg->arrival;
+        cv_bridge::CvImageConstPtr cv_ptr = GetImage(pImg->msg);
+        img0Buf.pop();
 
-                    vImuMeas.push_back(ORB_SLAM3::IMU::Point(acc, gyr, t));
+        // Load imu measurements from buffer
+        vector<ORB_SLAM3::IMU::Point> vImuMeas;
+        Eigen::Vector3f Wbb;
+        pop_imu_measurements(mpImuGb->imuBuf, tIm, vImuMeas, Wbb);
+        mbImageTracked = true;
 
-                    Wbb << mpImuGb->imuBuf.front()->angular_velocity.x, mpImuGb->imuBuf.front()->angular_velocity.y, mpImuGb->imuBuf.front()->angular_velocity.z;
+        if (!cv_ptr)
+            continue;
 
-                    mpImuGb->imuBuf.pop();
-                }
-            }
-            mpImuGb->mBufMutex.unlock();
+        add_sync_latency(arrival);
 
-            // ORB-SLAM3 runs in TrackMonocular()
-            Sophus::SE3f Tcw = pSLAM->TrackMonocular(im, tIm, vImuMeas);
+        // ORB-SLAM3 runs in TrackMonocular()
+        Sophus::SE3f Tcw = pSLAM->TrackMonocular(cv_ptr->image, tIm, vImuMeas);
 
-            publish_topics(msg_time, Wbb);
-        }
-
-        std::chrono::milliseconds tSleep(1);
-        std::this_thread::sleep_for(tSleep);
+        publish_topics(msg_time, Wbb);
     }
 }
 
 void ImuGrabber::GrabImu(const sensor_msgs::ImuConstPtr &imu_msg)
 {
-    mBufMutex.lock();
-    imuBuf.push(imu_msg);
-    mBufMutex.unlock();
+    ImuSample sample;
+    sample.t = imu_msg->header.stamp.toSec();
+    sample.acc << imu_msg->linear_acceleration.x, imu_msg->linear_acceleration.y, imu_msg->linear_acceleration.z;
+    sample.gyr << imu_msg->angular_velocity.x, imu_msg->angular_velocity.y, imu_msg->angular_velocity.z;
+
+    imuBuf.push(sample);
+    mLastImuTime.store(sample.t);
 
-    return;
-}
\ No newline at end of file
+    sensor_event.notify();
+
+    propagate_body_odom(sample);
+}
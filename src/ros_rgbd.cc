@@ -80,11 +80,14 @@ int main(int argc, char **argv)
                                                        &ImageGrabber::GrabArUcoMarker, &igb);
 
     setup_publishers(node_handler, image_transport, node_name);
+    setup_tracking_pipeline(node_handler, node_name);
     setup_services(node_handler, node_name);
+    setup_marker_buffer(node_handler, node_name);
 
     ros::spin();
 
     // Stop all threads
+    shutdown_publishers();
     pSLAM->Shutdown();
     ros::shutdown();
 
@@ -11,25 +11,41 @@ using namespace std;
 class ImuGrabber
 {
 public:
-    ImuGrabber(){};
+    ImuGrabber() : imuBuf(IMU_BUFFER_SIZE), mLastImuTime(-1.0){};
     void GrabImu(const sensor_msgs::ImuConstPtr &imu_msg);
 
-    queue<sensor_msgs::ImuConstPtr> imuBuf;
-    std::mutex mBufMutex;
+    // Filled by the ROS callback thread, consumed by the synchronization thread. It grows beyond
+    // IMU_BUFFER_SIZE if needed, every sample is handed to the tracking
+    GrowingSPSCQueue<ImuSample> imuBuf;
+    // Timestamp of the newest IMU sample received
+    std::atomic<double> mLastImuTime;
+
+    // Lock-free capacity, 5 seconds * 400Hz = 2000 samples
+    static const size_t IMU_BUFFER_SIZE = 2000;
+};
+
+// Synchronized color and depth messages
+struct RGBDSample
+{
+    sensor_msgs::ImageConstPtr msgRGB, msgD;
+    std::chrono::steady_clock::time_point arrival;
 };
 
 class ImageGrabber
 {
 public:
-    ImageGrabber(ImuGrabber *pImuGb) : mpImuGb(pImuGb) {}
+    ImageGrabber(ImuGrabber *pImuGb) : imgRGBDBuf(IMAGE_BUFFER_SIZE), mpImuGb(pImuGb), mbImageTracked(false) {}
 
     void GrabRGBD(const sensor_msgs::ImageConstPtr &msgRGB, const sensor_msgs::ImageConstPtr &msgD);
-    cv::Mat GetImage(const sensor_msgs::ImageConstPtr &img_msg);
+    cv_bridge::CvImageConstPtr GetImage(const sensor_msgs::ImageConstPtr &img_msg);
     void SyncWithImu();
 
-    queue<sensor_msgs::ImageConstPtr> imgRGBBuf, imgDBuf;
-    std::mutex mBufMutex;
+    SPSCQueue<RGBDSample> imgRGBDBuf;
     ImuGrabber *mpImuGb;
+    // Set once the first image is tracked, the IMU samples are kept from then on
+    bool mbImageTracked;
+
+    static const size_t IMAGE_BUFFER_SIZE = 8;
 };
 
 int main(int argc, char **argv)
@@ -86,13 +102,17 @@ int main(int argc, char **argv)
     sync.registerCallback(boost::bind(&ImageGrabber::GrabRGBD, &igb, _1, _2));
 
     setup_publishers(node_handler, image_transport, node_name);
+    setup_tracking_pipeline(node_handler, node_name);
     setup_services(node_handler, node_name);
+    setup_sensor_sync(node_handler, node_name);
+    setup_imu_propagation(node_handler, node_name);
 
     std::thread sync_thread(&ImageGrabber::SyncWithImu, &igb);
 
     ros::spin();
 
     // Stop all threads
+    shutdown_publishers();
     pSLAM->Shutdown();
     ros::shutdown();
 
@@ -105,22 +125,20 @@ int main(int argc, char **argv)
 
 void ImageGrabber::GrabRGBD(const sensor_msgs::ImageConstPtr &msgRGB, const sensor_msgs::ImageConstPtr &msgD)
 {
-    mBufMutex.lock();
-
-    if (!imgRGBBuf.empty())
-        imgRGBBuf.pop();
-    imgRGBBuf.push(msgRGB);
+    RGBDSample sample;
+    sample.msgRGB = msgRGB;
+    sample.msgD = msgD;
+    sample.arrival = std::chrono::steady_clock::now();
 
-    if (!imgDBuf.empty())
-        imgDBuf.pop();
-    imgDBuf.push(msgD);
+    if (!imgRGBDBuf.push(sample))
+        ROS_WARN_THROTTLE(1.0, "Image buffer is full, dropping frame");
 
-    mBufMutex.unlock();
+    sensor_event.notify();
 }
 
-cv::Mat ImageGrabber::GetImage(const sensor_msgs::ImageConstPtr &img_msg)
+cv_bridge::CvImageConstPtr ImageGrabber::GetImage(const sensor_msgs::ImageConstPtr &img_msg)
 {
-    // Copy the ros image message to cv::Mat.
+    // Share the ros image message data with cv::Mat, the returned pointer keeps the message alive
     cv_bridge::CvImageConstPtr cv_ptr;
     try
     {
@@ -129,72 +147,71 @@ cv::Mat ImageGrabber::GetImage(const sensor_msgs::ImageConstPtr &img_msg)
     catch (cv_bridge::Exception &e)
     {
         ROS_ERROR("cv_bridge exception: %s", e.what());
+        return nullptr;
     }
 
-    return cv_ptr->image.clone();
+    return cv_ptr;
 }
 
 void ImageGrabber::SyncWithImu()
 {
     while (1)
     {
-        if (!imgRGBBuf.empty() && !mpImuGb->imuBuf.empty())
-        {
-            cv::Mat im, depth;
-            double tIm = 0;
-
-            tIm = imgRGBBuf.front()->header.stamp.toSec();
-            if (tIm > mpImuGb->imuBuf.back()->header.stamp.toSec())
-                continue;
+        // Read before checking the buffers, so no notification between the check and the wait is lost
+        unsigned long seen = sensor_event.getSequence();
 
-            this->mBufMutex.lock();
-            ros::Time msg_time = imgRGBBuf.front()->header.stamp;
-            im = GetImage(imgRGBBuf.front());
-            imgRGBBuf.pop();
-            depth = GetImage(imgDBuf.front());
-            imgDBuf.pop();
-            this->mBufMutex.unlock();
+        // Only the most recent frame is tracked
+        while (imgRGBDBuf.size() > 1)
+            imgRGBDBuf.pop();
 
-            vector<ORB_SLAM3::IMU::Point> vImuMeas;
-            vImuMeas.clear();
-            Eigen::Vector3f Wbb;
-            mpImuGb->mBufMutex.lock();
-            if (!mpImuGb->imuBuf.empty())
-            {
-                // Load imu measurements from buffer
-                while (!mpImuGb->imuBuf.empty() && mpImuGb->imuBuf.front()->header.stamp.toSec() <= tIm)
-                {
-                    double t = mpImuGb->imuBuf.front()->header.stamp.toSec();
-
-                    cv::Point3f acc(mpImuGb->imuBuf.front()->linear_acceleration.x, mpImuGb->imuBuf.front()->linear_acceleration.y, mpImuGb->imuBuf.front()->linear_acceleration.z);
+        // Wait until there is a frame and the IMU samples up to its timestamp are received
+        RGBDSample *pImg = imgRGBDBuf.front();
+        if (!pImg || pImg->msgRGB->header.stamp.toSec() > mpImuGb->mLastImuTime.load())
+        {
+            // Before the first image, old IMU samples are never used
+            if (!pImg && !mbImageTracked)
+                trim_imu_buffer(mpImuGb->imuBuf, ImuGrabber::IMU_BUFFER_SIZE / 2);
 
-                    cv::Point3f gyr(mpImuGb->imuBuf.front()->angular_velocity.x, mpImuGb->imuBuf.front()->angular_velocity.y, mpImuGb->imuBuf.front()->angular_velocity.z);
+            sensor_event.wait(seen);
+            continue;
+        }
 
-                    vImuMeas.push_back(ORB_SLAM3::IMU::Point(acc, gyr, t));
+        ros::Time msg_time = pImg->msgRGB->header.stamp;
+        double tIm = msg_time.toSec();
+        std::chrono::steady_clock::time_point arrival = pImg->arrival;
+        cv_bridge::CvImageConstPtr cv_ptrRGB = GetImage(pImg->msgRGB);
+        cv_bridge::CvImageConstPtr cv_ptrD = GetImage(pImg->msgD);
+        imgRGBDBuf.pop();
 
-                    Wbb << mpImuGb->imuBuf.front()->angular_velocity.x, mpImuGb->imuBuf.front()->angular_velocity.y, mpImuGb->imuBuf.front()->angular_velocity.z;
+        // Load imu measurements from buffer
+        vector<ORB_SLAM3::IMU::Point> vImuMeas;
+        Eigen::Vector3f Wbb;
+        pop_imu_measurements(mpImuGb->imuBuf, tIm, vImuMeas, Wbb);
+        mbImageTracked = true;
 
-                    mpImuGb->imuBuf.pop();
-                }
-            }
-            mpImuGb->mBufMutex.unlock();
+        if (!cv_ptrRGB || !cv_ptrD)
+            continue;
 
-            // ORB-SLAM3 runs in TrackRGBD()
-            Sophus::SE3f Tcw = pSLAM->TrackRGBD(im, depth, tIm, vImuMeas);
+        add_sync_latency(arrival);
 
-            publish_topics(msg_time, Wbb);
-        }
+        // ORB-SLAM3 runs in TrackRGBD()
+        Sophus::SE3f Tcw = pSLAM->TrackRGBD(cv_ptrRGB->image, cv_ptrD->image, tIm, vImuMeas);
 
-        std::chrono::milliseconds tSleep(1);
-        std::this_thread::sleep_for(tSleep);
+        publish_topics(msg_time, Wbb);
     }
 }
 
 void ImuGrabber::GrabImu(const sensor_msgs::ImuConstPtr &imu_msg)
 {
-    mBufMutex.lock();
-    imuBuf.push(imu_msg);
-    mBufMutex.unlock();
+    ImuSample sample;
+    sample.t = imu_msg->header.stamp.toSec();
+    sample.acc << imu_msg->linear_acceleration.x, imu_msg->linear_acceleration.y, imu_msg->linear_acceleration.z;
+    sample.gyr << imu_msg->angular_velocity.x, imu_msg->angular_velocity.y, imu_msg->angular_velocity.z;
 
-    return;
-}
\ No newline at end of file
+    imuBuf.push(sample);
+    mLastImuTime.store(sample.t);
+
+    sensor_event.notify();
+
+    propagate_body_odom(sample);
+}
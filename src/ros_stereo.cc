@@ -60,11 +60,13 @@ int main(int argc, char **argv)
     sync.registerCallback(boost::bind(&ImageGrabber::GrabStereo, &igb, _1, _2));
 
     setup_publishers(node_handler, image_transport, node_name);
+    setup_tracking_pipeline(node_handler, node_name);
     setup_services(node_handler, node_name);
 
     ros::spin();
 
     // Stop all threads
+    shutdown_publishers();
     pSLAM->Shutdown();
     ros::shutdown();
 
@@ -11,27 +11,36 @@ using namespace std;
 class ImuGrabber
 {
 public:
-    ImuGrabber(){};
+    ImuGrabber() : imuBuf(IMU_BUFFER_SIZE), mLastImuTime(-1.0){};
 
     void GrabImu(const sensor_msgs::ImuConstPtr &imu_msg);
 
-    queue<sensor_msgs::ImuConstPtr> imuBuf;
-    std::mutex mBufMutex;
+    // Filled by the ROS callback thread, consumed by the synchronization thread. It grows beyond
+    // IMU_BUFFER_SIZE if needed, every sample is handed to the tracking
+    GrowingSPSCQueue<ImuSample> imuBuf;
+    // Timestamp of the newest IMU sample received
+    std::atomic<double> mLastImuTime;
+
+    // Lock-free capacity, 5 seconds * 400Hz = 2000 samples
+    static const size_t IMU_BUFFER_SIZE = 2000;
 };
 
 class ImageGrabber
 {
 public:
-    ImageGrabber(ImuGrabber *pImuGb): mpImuGb(pImuGb){}
+    ImageGrabber(ImuGrabber *pImuGb): imgLeftBuf(IMAGE_BUFFER_SIZE), imgRightBuf(IMAGE_BUFFER_SIZE), mpImuGb(pImuGb), mbImageTracked(false){}
 
     void GrabImageLeft(const sensor_msgs::ImageConstPtr& msg);
     void GrabImageRight(const sensor_msgs::ImageConstPtr& msg);
-    cv::Mat GetImage(const sensor_msgs::ImageConstPtr &img_msg);
+    cv_bridge::CvImageConstPtr GetImage(const sensor_msgs::ImageConstPtr &img_msg);
     void SyncWithImu();
 
-    queue<sensor_msgs::ImageConstPtr> imgLeftBuf, imgRightBuf;
-    std::mutex mBufMutexLeft,mBufMutexRight;
+    SPSCQueue<ImageSample> imgLeftBuf, imgRightBuf;
     ImuGrabber *mpImuGb;
+    // Set once the first image is tracked, the IMU samples are kept from then on
+    bool mbImageTracked;
+
+    static const size_t IMAGE_BUFFER_SIZE = 8;
 };
 
 int main(int argc, char **argv)
@@ -73,19 +82,22 @@ int main(int argc, char **argv)
     ImuGrabber imugb;
     ImageGrabber igb(&imugb);
 
-    // Maximum delay, 5 seconds * 200Hz = 1000 samples
     ros::Subscriber sub_imu = node_handler.subscribe("/imu", 1000, &ImuGrabber::GrabImu, &imugb); 
     ros::Subscriber sub_img_left = node_handler.subscribe("/camera/left/image_raw", 100, &ImageGrabber::GrabImageLeft, &igb);
     ros::Subscriber sub_img_right = node_handler.subscribe("/camera/right/image_raw", 100, &ImageGrabber::GrabImageRight, &igb);
 
     setup_publishers(node_handler, image_transport, node_name);
+    setup_tracking_pipeline(node_handler, node_name);
     setup_services(node_handler, node_name);
+    setup_sensor_sync(node_handler, node_name);
+    setup_imu_propagation(node_handler, node_name);
 
     std::thread sync_thread(&ImageGrabber::SyncWithImu, &igb);
 
     ros::spin();
     
     // Stop all threads
+    shutdown_publishers();
     pSLAM->Shutdown();
     ros::shutdown();
 
@@ -98,44 +110,43 @@ int main(int argc, char **argv)
 
 void ImageGrabber::GrabImageLeft(const sensor_msgs::ImageConstPtr &img_msg)
 {
-    mBufMutexLeft.lock();
-    if (!imgLeftBuf.empty())
-        imgLeftBuf.pop();
-    imgLeftBuf.push(img_msg);
-    mBufMutexLeft.unlock();
+    ImageSample sample;
+    sample.msg = img_msg;
+    sample.arrival = std::chrono::steady_clock::now();
+
+    if (!imgLeftBuf.push(sample))
+        ROS_WARN_THROTTLE(1.0, "Left image buffer is full, dropping frame");
+
+    sensor_event.notify();
 }
 
 void ImageGrabber::GrabImageRight(const sensor_msgs::ImageConstPtr &img_msg)
 {
-    mBufMutexRight.lock();
-    if (!imgRightBuf.empty())
-        imgRightBuf.pop();
-    imgRightBuf.push(img_msg);
-    mBufMutexRight.unlock();
+    ImageSample sample;
+    sample.msg = img_msg;
+    sample.arrival = std::chrono::steady_clock::now();
+
+    if (!imgRightBuf.push(sample))
+        ROS_WARN_THROTTLE(1.0, "Right image buffer is full, dropping frame");
+
+    sensor_event.notify();
 }
 
-cv::Mat ImageGrabber::GetImage(const sensor_msgs::ImageConstPtr &img_msg)
+cv_bridge::CvImageConstPtr ImageGrabber::GetImage(const sensor_msgs::ImageConstPtr &img_msg)
 {
-    // Copy the ros image message to cv::Mat.
+    // Share the ros image message data with cv::Mat, the returned pointer keeps the message alive
     cv_bridge::CvImageConstPtr cv_ptr;
     try
     {
         cv_ptr = cv_bridge::toCvShare(img_msg, sensor_msgs::image_encodings::MONO8);
     }
-    catch (cv_bridge::Exception& e)
+    catch (cv_bridge::Exception &e)
     {
         ROS_ERROR("cv_bridge exception: %s", e.what());
+        return nullptr;
     }
-    
-    if(cv_ptr->image.type()==0)
-    {
-        return cv_ptr->image.clone();
-    }
-    else
-    {
-        std::cout << "Error type" << std::endl;
-        return cv_ptr->image.clone();
-    }
+
+    return cv_ptr;
 }
 
 void ImageGrabber::SyncWithImu()
@@ -143,88 +154,74 @@ void ImageGrabber::SyncWithImu()
     const double maxTimeDiff = 0.01;
     while(1)
     {
-        cv::Mat imLeft, imRight;
-        double tImLeft = 0, tImRight = 0;
-        if (!imgLeftBuf.empty()&&!imgRightBuf.empty()&&!mpImuGb->imuBuf.empty())
-        {
-            tImLeft = imgLeftBuf.front()->header.stamp.toSec();
-            tImRight = imgRightBuf.front()->header.stamp.toSec();
-
-            this->mBufMutexRight.lock();
-            while((tImLeft-tImRight)>maxTimeDiff && imgRightBuf.size()>1)
-            {
-                imgRightBuf.pop();
-                tImRight = imgRightBuf.front()->header.stamp.toSec();
-            }
-            this->mBufMutexRight.unlock();
-
-            this->mBufMutexLeft.lock();
-            while((tImRight-tImLeft)>maxTimeDiff && imgLeftBuf.size()>1)
-            {
-                imgLeftBuf.pop();
-                tImLeft = imgLeftBuf.front()->header.stamp.toSec();
-            }
-            this->mBufMutexLeft.unlock();
-
-            if((tImLeft-tImRight)>maxTimeDiff || (tImRight-tImLeft)>maxTimeDiff)
-            {
-                // std::cout << "big time difference" << std::endl;
-                continue;
-            }
-            if(tImLeft>mpImuGb->imuBuf.back()->header.stamp.toSec())
-                continue;
-
-            this->mBufMutexLeft.lock();
-            imLeft = GetImage(imgLeftBuf.front());
-            ros::Time msg_time = imgLeftBuf.front()->header.stamp;
-            imgLeftBuf.pop();
-            this->mBufMutexLeft.unlock();
+        // Read before checking the buffers, so no notification between the check and the wait is lost
+        unsigned long seen = sensor_event.getSequence();
 
-            this->mBufMutexRight.lock();
-            imRight = GetImage(imgRightBuf.front());
+        // Only the most recent images are tracked
+        while (imgLeftBuf.size() > 1)
+            imgLeftBuf.pop();
+        while (imgRightBuf.size() > 1)
             imgRightBuf.pop();
-            this->mBufMutexRight.unlock();
-
-            vector<ORB_SLAM3::IMU::Point> vImuMeas;
-            Eigen::Vector3f Wbb;
-            mpImuGb->mBufMutex.lock();
-            if(!mpImuGb->imuBuf.empty())
-            {
-                // Load imu measurements from buffer
-                vImuMeas.clear();
-                while(!mpImuGb->imuBuf.empty() && mpImuGb->imuBuf.front()->header.stamp.toSec()<=tImLeft)
-                {
-                    double t = mpImuGb->imuBuf.front()->header.stamp.toSec();
-
-                    cv::Point3f acc(mpImuGb->imuBuf.front()->linear_acceleration.x, mpImuGb->imuBuf.front()->linear_acceleration.y, mpImuGb->imuBuf.front()->linear_acceleration.z);
-
-                    cv::Point3f gyr(mpImuGb->imuBuf.front()->angular_velocity.x, mpImuGb->imuBuf.front()->angular_velocity.y, mpImuGb->imuBuf.front()->angular_velocity.z);
-                    
-                    vImuMeas.push_back(ORB_SLAM3::IMU::Point(acc,gyr,t));
-
-                    Wbb << mpImuGb->imuBuf.front()->angular_velocity.x, mpImuGb->imuBuf.front()->angular_velocity.y, mpImuGb->imuBuf.front()->angular_velocity.z;
-
-                    mpImuGb->imuBuf.pop();
-                }
-            }
-            mpImuGb->mBufMutex.unlock();
-            
-            // ORB-SLAM3 runs in TrackStereo()
-            Sophus::SE3f Tcw = pSLAM->TrackStereo(imLeft,imRight,tImLeft,vImuMeas);
-
-            publish_topics(msg_time, Wbb);
-            
-            std::chrono::milliseconds tSleep(1);
-            std::this_thread::sleep_for(tSleep);
+
+        ImageSample *pLeft = imgLeftBuf.front();
+        ImageSample *pRight = imgRightBuf.front();
+        if (!pLeft || !pRight)
+        {
+            // Before the first image, old IMU samples are never used
+            if (!pLeft && !pRight && !mbImageTracked)
+                trim_imu_buffer(mpImuGb->imuBuf, ImuGrabber::IMU_BUFFER_SIZE / 2);
+
+            sensor_event.wait(seen);
+            continue;
+        }
+
+        double tImLeft = pLeft->msg->header.stamp.toSec();
+        double tImRight = pRight->msg->header.stamp.toSec();
+
+        // Wait for the counterpart image and the IMU samples up to the image timestamp
+        if ((tImLeft - tImRight) > maxTimeDiff || (tImRight - tImLeft) > maxTimeDiff ||
+            tImLeft > mpImuGb->mLastImuTime.load())
+        {
+            sensor_event.wait(seen);
+            continue;
         }
+
+        ros::Time msg_time = pLeft->msg->header.stamp;
+        std::chrono::steady_clock::time_point arrival = std::max(pLeft->arrival, pRight->arrival);
+        cv_bridge::CvImageConstPtr cv_ptrLeft = GetImage(pLeft->msg);
+        cv_bridge::CvImageConstPtr cv_ptrRight = GetImage(pRight->msg);
+        imgLeftBuf.pop();
+        imgRightBuf.pop();
+
+        // Load imu measurements from buffer
+        vector<ORB_SLAM3::IMU::Point> vImuMeas;
+        Eigen::Vector3f Wbb;
+        pop_imu_measurements(mpImuGb->imuBuf, tImLeft, vImuMeas, Wbb);
+        mbImageTracked = true;
+
+        if (!cv_ptrLeft || !cv_ptrRight)
+            continue;
+
+        add_sync_latency(arrival);
+
+        // ORB-SLAM3 runs in TrackStereo()
+        Sophus::SE3f Tcw = pSLAM->TrackStereo(cv_ptrLeft->image, cv_ptrRight->image, tImLeft, vImuMeas);
+
+        publish_topics(msg_time, Wbb);
     }
 }
 
 void ImuGrabber::GrabImu(const sensor_msgs::ImuConstPtr &imu_msg)
 {
-    mBufMutex.lock();
-    imuBuf.push(imu_msg);
-    mBufMutex.unlock();
-    
-    return;
-}
\ No newline at end of file
+    ImuSample sample;
+    sample.t = imu_msg->header.stamp.toSec();
+    sample.acc << imu_msg->linear_acceleration.x, imu_msg->linear_acceleration.y, imu_msg->linear_acceleration.z;
+    sample.gyr << imu_msg->angular_velocity.x, imu_msg->angular_velocity.y, imu_msg->angular_velocity.z;
+
+    imuBuf.push(sample);
+    mLastImuTime.store(sample.t);
+
+    sensor_event.notify();
+
+    propagate_body_odom(sample);
+}